@@ -31,7 +31,7 @@
 
 //==============================================================================
 NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), telemetryComponent (p.getTelemetryCollector())
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -68,6 +68,10 @@ NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioP
     quantumComponent.getComponent("phi").setValue(p.paramPhi->get());
     quantumComponent.getComponent("theta").setValue(p.paramTheta->get());
 
+    // Processing time statistics
+    telemetryComponent.setName("Telemetry");
+    this->addAndMakeVisible(telemetryComponent);
+
     getLookAndFeel().setColour(juce::Slider::thumbColourId, juce::Colours::aqua);
     getLookAndFeel().setColour(juce::Slider::backgroundColourId, juce::Colours::black);
     getLookAndFeel().setColour(juce::Label::textColourId, juce::Colours::darkblue);
@@ -91,8 +95,9 @@ void NewProjectAudioProcessorEditor::resized()
     auto area = this->getLocalBounds();
     area.reduce(AREAMARGIN, AREAMARGIN);
 
+    telemetryComponent.setBounds(area.removeFromBottom(TELEMETRYHEIGHT));
     addSynthComponent.setBounds(area.removeFromLeft(EDITORWIDTH/2.- AREAMARGIN));
-    adsrComponent.setBounds(area.removeFromTop(EDITORHEIGHT / 2. - AREAMARGIN));
+    adsrComponent.setBounds(area.removeFromTop((EDITORHEIGHT - TELEMETRYHEIGHT) / 2. - AREAMARGIN));
     quantumComponent.setBounds(area);
 }
 
@@ -31,6 +31,7 @@
 #include "components/QuantumComponent.h"
 #include "components/AddSynthComponent.h"
 #include "components/ADSRComponent.h"
+#include "components/TelemetryComponent.h"
 
 //==============================================================================
 /**
@@ -53,6 +54,7 @@ private:
     cw::synth::QuantumComponent quantumComponent;
     cw::synth::ADSRComponent adsrComponent;
     cw::synth::AddSynthComponent addSynthComponent;
+    cw::synth::TelemetryComponent telemetryComponent;
 
     std::vector<std::unique_ptr<juce::Slider>> harmGains;
     juce::Slider aVal;
@@ -62,8 +64,9 @@ private:
 
     // sizes
     const int EDITORWIDTH{ 500 };
-    const int EDITORHEIGHT{ 550 };
+    const int EDITORHEIGHT{ 700 };
     const int AREAMARGIN{ 20 };
+    const int TELEMETRYHEIGHT{ 150 };
 
     // add listener
     void sliderValueChanged(juce::Slider* slider) override;
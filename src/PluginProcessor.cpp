@@ -26,6 +26,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "util/RealtimeSafety.h"
 #include <string>
 
 //==============================================================================
@@ -42,6 +43,7 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
 #endif
 {
     additiveSynth = std::make_unique<cw::synth::AdditiveSynth>();
+    telemetryCollector = std::make_unique<cw::synth::TelemetryCollector>(additiveSynth->getTelemetry());
     for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
         if (i == 0) {
             paramHarmGains.push_back(new juce::AudioParameterFloat("harmonic" + std::to_string(i), "Harmonic " + std::to_string(i), 0.0, 1.0, 1.0));
@@ -67,6 +69,48 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
     addParameter(paramPhi = new juce::AudioParameterFloat("phi", "Phi", 0.0, 2 * juce::MathConstants<float>::pi, 0.0));
     addParameter(paramTheta = new juce::AudioParameterFloat("theta", "Theta", 0.0, 2 * juce::MathConstants<float>::pi, 0.0));
 
+    // rotation: combination of the spin matrices or unitary rotation
+    addParameter(paramUnitary = new juce::AudioParameterBool("unitary", "Unitary Rotation", false));
+    // the classic spin 3/2 rotation, or the rotation of spin 1/2 to 7/2, i.e. of dimension 2 to 8
+    addParameter(paramSpin = new juce::AudioParameterChoice("spin", "Spin",
+        juce::StringArray{ "3/2 (classic)", "1/2", "1", "3/2", "2", "5/2", "3", "7/2" }, 0));
+
+    // oscillators: harmonics or baked waveform
+    addParameter(paramBaked = new juce::AudioParameterBool("baked", "Baked Waveform", false));
+
+    // the sines of the partials read from the sound table, computed by polynomials of the given degree or by phasors
+    addParameter(paramEngine = new juce::AudioParameterChoice("engine", "Oscillator Engine",
+        juce::StringArray{ "Table", "Polynomial 5th", "Polynomial 7th", "Polynomial 9th", "Phasor" }, 0));
+
+    // interpolation of the sound table while playing live, and while the host renders offline
+    const juce::StringArray interpolations{ "Linear", "Hermite", "Lagrange" };
+    addParameter(paramInterpolation = new juce::AudioParameterChoice("interpolation", "Interpolation", 
+        interpolations, 0));
+    addParameter(paramOfflineInterpolation = new juce::AudioParameterChoice("offlineInterpolation", 
+        "Offline Interpolation", interpolations, 0));
+
+    // tuning of the partials: harmonic, or one of the inharmonic series; the custom ratios come with the preset
+    addParameter(paramTuning = new juce::AudioParameterChoice("tuning", "Tuning",
+        juce::StringArray{ "Harmonic", "Stretched", "Bell", "Bar", "Custom" }, 0));
+    addParameter(paramStretch = new juce::AudioParameterFloat("stretch", "Stretch", 0.0, 0.01, 0.0004));
+
+    // unison: number of detuned copies of each note, their detune in cents and their stereo spread
+    addParameter(paramUnison = new juce::AudioParameterInt("unison", "Unison", 1, 
+        cw::synth::HarmonicSoundProcessor::maxUnisonVoices, 1));
+    addParameter(paramDetune = new juce::AudioParameterFloat("detune", "Detune", 0.0, 100.0, 15.0));
+    addParameter(paramSpread = new juce::AudioParameterFloat("spread", "Spread", 0.0, 1.0, 0.5));
+
+    // rendering in fixed chunks instead of the blocks of the host, optionally buffered at the latency of one chunk
+    addParameter(paramQuantum = new juce::AudioParameterChoice("quantum", "Processing Quantum",
+        juce::StringArray{ "Host Blocks", "16", "32", "64", "128", "256" }, 0));
+    addParameter(paramQuantumBuffered = new juce::AudioParameterBool("quantumBuffered", "Quantum Buffering", false));
+    paramQuantum->addListener(this);
+    paramQuantumBuffered->addListener(this);
+
+    // held notes rendered ahead on a worker thread
+    addParameter(paramRenderAhead = new juce::AudioParameterBool("renderAhead", "Render Ahead", false));
+    paramRenderAhead->addListener(this);
+
     // set initial target values
     paramATarget = paramA->get();
     paramDTarget = paramD->get();
@@ -80,10 +124,15 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
         *itTarget = (*it)->get();
     }
 
+    startTimer(settingsPollMs);
 }
 
 NewProjectAudioProcessor::~NewProjectAudioProcessor()
 {
+    paramQuantum->removeListener(this);
+    paramQuantumBuffered->removeListener(this);
+    paramRenderAhead->removeListener(this);
+    stopTimer();
 }
 
 //==============================================================================
@@ -151,7 +200,10 @@ void NewProjectAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void NewProjectAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    additiveSynth->prepareToPlay(samplesPerBlock, sampleRate);
+    updateLatency();
+    additiveSynth->prepareToPlay(samplesPerBlock, sampleRate, isUsingDoublePrecision());
+    partMidi.ensureSize(partMidiBytes);
+    telemetryCollector->start();
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
 }
@@ -188,13 +240,8 @@ bool NewProjectAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 }
 #endif
 
-void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+void NewProjectAudioProcessor::updateParameters()
 {
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    // +++++++++++++++++++++ setting parameters ++++++++++++++++++++
     // Parameter smoothing is applied. The target values are denoted by ending with *Target, the current values are 
     // given by the param values themselves. The current values are iteratively updated with a ratio given by the 
     // variables smRat*. 
@@ -225,7 +272,12 @@ void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
             2 * juce::MathConstants<float>::pi);
     }
 
-    auto voices = additiveSynth->getVoices();
+    additiveSynth->setBakedWaveformEnabled(paramBaked->get());
+    updateProcessingQuantum();
+    partialRatios.tuning = (cw::synth::PartialTuning)paramTuning->getIndex();
+    partialRatios.stretch = paramStretch->get();
+
+    const auto& voices = additiveSynth->getVoices();
     for (auto voice : voices) {
         for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
             if ((std::abs(paramHarmGainsTarget.at(i) - paramHarmGains.at(i)->get())) > smRatEpsilon) {
@@ -237,8 +289,50 @@ void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
         voice->setAdsrParameters(paramA->get(), paramD->get(), paramS->get(), paramR->get());
         voice->setPhi(paramPhi->get());
         voice->setTheta(paramTheta->get());
+        voice->setRotationMode(paramUnitary->get() ? cw::synth::RotationMode::unitary
+            : cw::synth::RotationMode::generators);
+        voice->setSpinDimension(getSpinDimension());
+        voice->setUnison(paramUnison->get(), paramDetune->get(), paramSpread->get());
+        voice->setPartialRatios(partialRatios);
+        voice->setOscillatorEngine((cw::synth::OscillatorEngine)paramEngine->getIndex());
+        voice->setInterpolation((cw::synth::TableInterpolation)(isNonRealtime() ? paramOfflineInterpolation->getIndex()
+            : paramInterpolation->getIndex()));
     }
+}
 
+void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer, midiMessages);
+}
+
+void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer, midiMessages);
+}
+
+template <typename SampleType>
+void NewProjectAudioProcessor::processSamples (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
+{
+    ADDSYNTH_REALTIME_SECTION;
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    auto& telemetry = additiveSynth->getTelemetry();
+    telemetry.beginBlock();
+
+    // +++++++++++++++++++++ setting parameters ++++++++++++++++++++
+    {
+        cw::synth::TelemetryRecorder::ScopedStage stage(&telemetry, cw::synth::stageParameters);
+        // a preset loaded by the host is applied while the output is faded out, see renderSynth; the parameters
+        // would turn the voices back until the message thread has taken it over
+        if (!presetHeld.load(std::memory_order_acquire)) {
+            if (presetLoader.fetchPreset(pendingPreset)) {
+                presetPending = true;
+            }
+            updateParameters();
+        }
+    }
 
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
@@ -261,8 +355,63 @@ void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
     //}
 
     // +++++++++++++++++++++ do processing ++++++++++++++++++++
-    additiveSynth->setMidiBuffer(midiMessages);
-    additiveSynth->getNextAudioBlock(AudioSourceChannelInfo(&buffer, 0, buffer.getNumSamples()));
+    renderSynth(buffer, midiMessages);
+
+    telemetry.endBlock(buffer.getNumSamples());
+}
+
+template <typename SampleType>
+void NewProjectAudioProcessor::renderSynth (juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages)
+{
+    const int numSamples = buffer.getNumSamples();
+    if (!presetPending && presetGain == 1.f && presetSilentSamples == 0) {
+        additiveSynth->setMidiBuffer(midiMessages);
+        additiveSynth->renderNextBlock(buffer, 0, numSamples);
+        return;
+    }
+
+    // The block is rendered in parts, each with a linear ramp of the gain: fading out while a preset is pending, 
+    // silent until the latency of the synth has passed after applying it, and fading in after that.
+    const float step = 1.f / (float)juce::jmax(1., presetFadeSeconds * getSampleRate());
+    for (int startSample = 0; startSample < numSamples;) {
+        if (presetPending && presetGain <= 0.f) {
+            applyPreset(pendingPreset);
+            presetLoader.markApplied();
+            presetPending = false;
+            presetHeld.store(true, std::memory_order_release);
+            presetSilentSamples = additiveSynth->getLatencySamples();
+        }
+
+        const int remaining = numSamples - startSample;
+        int length = remaining;
+        float endGain = 1.f;
+        if (presetPending) {
+            length = juce::jmin(remaining, (int)std::ceil(presetGain / step));
+            endGain = juce::jmax(0.f, presetGain - length * step);
+        }
+        else if (presetSilentSamples > 0) {
+            length = juce::jmin(remaining, presetSilentSamples);
+            endGain = 0.f;
+            presetSilentSamples -= length;
+        }
+        else if (presetGain < 1.f) {
+            length = juce::jmin(remaining, (int)std::ceil((1.f - presetGain) / step));
+            endGain = juce::jmin(1.f, presetGain + length * step);
+        }
+
+        // only the events of the part, as the synth would play later ones at the end of the part
+        partMidi.clear();
+        partMidi.addEvents(midiMessages, startSample, length, 0);
+        additiveSynth->setMidiBuffer(partMidi);
+        additiveSynth->renderNextBlock(buffer, startSample, length);
+        if (presetGain != 1.f || endGain != 1.f) {
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+                buffer.applyGainRamp(channel, startSample, length, (SampleType)presetGain, (SampleType)endGain);
+            }
+        }
+        presetGain = endGain;
+        startSample += length;
+    }
 }
 
 //==============================================================================
@@ -279,15 +428,178 @@ juce::AudioProcessorEditor* NewProjectAudioProcessor::createEditor()
 //==============================================================================
 void NewProjectAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // A state which has been loaded but not yet been taken over into the parameters is returned as it was loaded.
+    cw::synth::SynthPreset preset;
+    if (presetHeld.load(std::memory_order_acquire)) {
+        preset = pendingPreset;
+    }
+    else if (!presetLoader.getPendingPreset(preset)) {
+        preset = getTargetPreset();
+    }
+    juce::MemoryOutputStream stream(destData, false);
+    preset.writeBinary(stream);
 }
 
 void NewProjectAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    presetLoader.loadState(data, sizeInBytes);
+}
+
+int NewProjectAudioProcessor::getSpinDimension() const
+{
+    // choice 0 is the classic rotation, choice i the dimension i + 1
+    const int choice = paramSpin->getIndex();
+    return choice == 0 ? cw::synth::SelectableSpinRotation::classic : choice + 1;
+}
+
+void NewProjectAudioProcessor::updateProcessingQuantum()
+{
+    // choice 0 renders the blocks of the host, choice i chunks of 8 << i samples
+    const int index = paramQuantum->getIndex();
+    additiveSynth->setProcessingQuantum(index == 0 ? 0 : 8 << index, paramQuantumBuffered->get());
+}
+
+void NewProjectAudioProcessor::updateLatency()
+{
+    updateProcessingQuantum();
+    if (additiveSynth->getLatencySamples() != getLatencySamples()) {
+        setLatencySamples(additiveSynth->getLatencySamples());
+    }
+}
+
+void NewProjectAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    // automation may come from the audio thread, which only raises the flag for the timer
+    if (juce::MessageManager::existsAndIsCurrentThread()) {
+        updateSettings();
+    }
+    else {
+        settingsChanged.store(true, std::memory_order_release);
+    }
+}
+
+void NewProjectAudioProcessor::timerCallback()
+{
+    handlePendingChanges();
+}
+
+void NewProjectAudioProcessor::handlePendingChanges()
+{
+    if (settingsChanged.exchange(false, std::memory_order_acquire)) {
+        updateSettings();
+    }
+    if (presetHeld.load(std::memory_order_acquire)) {
+        takeOverPreset(pendingPreset);
+        presetHeld.store(false, std::memory_order_release);
+    }
+}
+
+void NewProjectAudioProcessor::updateSettings()
+{
+    updateLatency();
+    additiveSynth->setRenderAhead(paramRenderAhead->get());
+}
+
+cw::synth::SynthPreset NewProjectAudioProcessor::getTargetPreset() const
+{
+    cw::synth::SynthPreset preset;
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        preset.harmonicGains[i] = paramHarmGainsTarget.at(i);
+    }
+    preset.attack = paramATarget;
+    preset.decay = paramDTarget;
+    preset.sustain = paramSTarget;
+    preset.release = paramRTarget;
+    preset.phi = paramPhiTarget;
+    preset.theta = paramThetaTarget;
+    preset.rotationMode = paramUnitary->get() ? cw::synth::RotationMode::unitary
+        : cw::synth::RotationMode::generators;
+    preset.spinDimension = getSpinDimension();
+    preset.bakedWaveform = paramBaked->get();
+    preset.oscillatorEngine = (cw::synth::OscillatorEngine)paramEngine->getIndex();
+    preset.interpolation = (cw::synth::TableInterpolation)paramInterpolation->getIndex();
+    preset.offlineInterpolation = (cw::synth::TableInterpolation)paramOfflineInterpolation->getIndex();
+    preset.partials = partialRatios;
+    preset.partials.tuning = (cw::synth::PartialTuning)paramTuning->getIndex();
+    preset.partials.stretch = paramStretch->get();
+    preset.unisonVoices = paramUnison->get();
+    preset.unisonDetune = paramDetune->get();
+    preset.unisonSpread = paramSpread->get();
+    preset.modulation = additiveSynth->getModulation();
+    return preset;
+}
+
+void NewProjectAudioProcessor::setTargetPreset(const cw::synth::SynthPreset& preset)
+{
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        paramHarmGainsTarget.at(i) = preset.harmonicGains[i];
+    }
+    paramATarget = preset.attack;
+    paramDTarget = preset.decay;
+    paramSTarget = preset.sustain;
+    paramRTarget = preset.release;
+    paramPhiTarget = preset.phi;
+    paramThetaTarget = preset.theta;
+    *paramUnitary = preset.rotationMode == cw::synth::RotationMode::unitary;
+    const auto dimension = preset.spinDimension;
+    *paramSpin = dimension >= cw::synth::SelectableSpinRotation::minDimension
+        && dimension <= cw::synth::SelectableSpinRotation::maxDimension ? dimension - 1 : 0;
+    *paramBaked = preset.bakedWaveform;
+    *paramEngine = (int)preset.oscillatorEngine;
+    *paramInterpolation = (int)preset.interpolation;
+    *paramOfflineInterpolation = (int)preset.offlineInterpolation;
+    *paramTuning = (int)preset.partials.tuning;
+    *paramStretch = preset.partials.stretch;
+    partialRatios.custom = preset.partials.custom;
+    *paramUnison = preset.unisonVoices;
+    *paramDetune = preset.unisonDetune;
+    *paramSpread = preset.unisonSpread;
+}
+
+void NewProjectAudioProcessor::applyPreset(const cw::synth::SynthPreset& preset)
+{
+    // the values as the parameters take them over later, see takeOverPreset
+    const auto limit = [](const juce::AudioParameterFloat* param, float value) {
+        return juce::jlimit(param->range.start, param->range.end, value);
+    };
+    const auto dimension = preset.spinDimension >= cw::synth::SelectableSpinRotation::minDimension
+        && preset.spinDimension <= cw::synth::SelectableSpinRotation::maxDimension ? preset.spinDimension
+        : cw::synth::SelectableSpinRotation::classic;
+    const auto unisonVoices = juce::jlimit(1, cw::synth::HarmonicSoundProcessor::maxUnisonVoices, preset.unisonVoices);
+
+    // the modulation has no parameters, it is taken over at once and glides at control rate
+    additiveSynth->setModulation(preset.modulation);
+    additiveSynth->setBakedWaveformEnabled(preset.bakedWaveform);
+    for (auto voice : additiveSynth->getVoices()) {
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            voice->getHarmProcessor()->setHarmGain(i, limit(paramHarmGains.at(i), preset.harmonicGains[i]));
+        }
+        voice->setAdsrParameters(limit(paramA, preset.attack), limit(paramD, preset.decay), 
+            limit(paramS, preset.sustain), limit(paramR, preset.release));
+        voice->setPhi(limit(paramPhi, preset.phi));
+        voice->setTheta(limit(paramTheta, preset.theta));
+        voice->setRotationMode(preset.rotationMode);
+        voice->setSpinDimension(dimension);
+        voice->setUnison(unisonVoices, limit(paramDetune, preset.unisonDetune), 
+            limit(paramSpread, preset.unisonSpread));
+        voice->setPartialRatios(preset.partials);
+        voice->setOscillatorEngine(preset.oscillatorEngine);
+        voice->setInterpolation(isNonRealtime() ? preset.offlineInterpolation : preset.interpolation);
+    }
+}
+
+void NewProjectAudioProcessor::takeOverPreset(const cw::synth::SynthPreset& preset)
+{
+    setTargetPreset(preset);
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        *paramHarmGains.at(i) = paramHarmGainsTarget.at(i);
+    }
+    *paramA = paramATarget;
+    *paramD = paramDTarget;
+    *paramS = paramSTarget;
+    *paramR = paramRTarget;
+    *paramPhi = paramPhiTarget;
+    *paramTheta = paramThetaTarget;
 }
 
 //==============================================================================
@@ -28,6 +28,8 @@
 
 #include <JuceHeader.h>
 #include "synth/AdditiveSynth.h"
+#include "synth/PresetLoader.h"
+#include <atomic>
 #include <vector>
 
 //==============================================================================
@@ -37,6 +39,8 @@ class NewProjectAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                             , private juce::AudioProcessorParameter::Listener
+                             , private juce::Timer
 {
 public:
     //==============================================================================
@@ -52,6 +56,22 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    // The synth has its own kernels for double precision, used when the host mixes in double.
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    // Applies one step of the parameter smoothing and passes the current values on to the voices. Called at the 
+    // beginning of each processBlock.
+    void updateParameters();
+
+    /*
+    * Takes over what the audio thread leaves to the message thread: settings changed by automation, and the preset it 
+    * has applied, into the parameters. Called by a timer; tools which run no message loop call it between blocks.
+    */
+    void handlePendingChanges();
+
+    // Timing statistics of processBlock, collected on a background thread.
+    cw::synth::TelemetryCollector& getTelemetryCollector() { return *telemetryCollector; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -84,6 +104,20 @@ public:
     juce::AudioParameterFloat* paramR;
     juce::AudioParameterFloat* paramPhi;
     juce::AudioParameterFloat* paramTheta;
+    juce::AudioParameterBool* paramUnitary;
+    juce::AudioParameterChoice* paramSpin;
+    juce::AudioParameterBool* paramBaked;
+    juce::AudioParameterChoice* paramEngine;
+    juce::AudioParameterChoice* paramInterpolation;
+    juce::AudioParameterChoice* paramOfflineInterpolation;
+    juce::AudioParameterChoice* paramTuning;
+    juce::AudioParameterFloat* paramStretch;
+    juce::AudioParameterInt* paramUnison;
+    juce::AudioParameterFloat* paramDetune;
+    juce::AudioParameterFloat* paramSpread;
+    juce::AudioParameterChoice* paramQuantum;
+    juce::AudioParameterBool* paramQuantumBuffered;
+    juce::AudioParameterBool* paramRenderAhead;
 
     std::vector<float> paramHarmGainsTarget;
     float paramATarget;
@@ -95,12 +129,82 @@ public:
 
 private:
     std::unique_ptr<cw::synth::AdditiveSynth> additiveSynth;
+    // declared after the synth, as it reads from the telemetry recorder of the synth
+    std::unique_ptr<cw::synth::TelemetryCollector> telemetryCollector;
+    // decodes states loaded by the host in the background, they are picked up at the start of the next block
+    cw::synth::PresetLoader presetLoader;
+    // the tuning of the partials as selected by the parameters, with the custom ratios of the last preset
+    cw::synth::PartialRatios partialRatios;
 
     const float smRatADSR = 0.2;
     const float smRatHarm = 0.2;
     const float smRatQuantum = 0.2;
     const float smRatEpsilon = 1e-4;
 
+    /*
+    * A loaded preset is not glided to, which would take longer the larger the blocks are, and which would switch the
+    * discrete parameters at once while notes are playing. Instead, the output fades out over a fixed time, the preset
+    * is applied while the synth is silent, and the output fades in again.
+    */
+    static constexpr double presetFadeSeconds = 0.01;
+    cw::synth::SynthPreset pendingPreset;
+    bool presetPending{ false };
+    /*
+    * Set by the audio thread once it has applied the pending preset to the voices, cleared by the message thread once
+    * it has taken the preset over into the parameters and targets. Meanwhile, the audio thread neither fetches another
+    * preset nor passes the parameters on to the voices.
+    */
+    std::atomic<bool> presetHeld{ false };
+    // the gain of the fade, and the samples to stay silent after applying, until the latency has passed
+    float presetGain{ 1.f };
+    int presetSilentSamples{ 0 };
+    // the MIDI events of one part of the fade, with the space allocated up front
+    static constexpr size_t partMidiBytes = 4096;
+    juce::MidiBuffer partMidi;
+
+    // The processing of both precisions.
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
+
+    // The preset the parameter smoothing is heading to, i.e. the targets of all parameters.
+    cw::synth::SynthPreset getTargetPreset() const;
+    // Sets the targets of all parameters, so that the sound glides to the preset. For the message thread.
+    void setTargetPreset(const cw::synth::SynthPreset& preset);
+    /*
+    * Sets the voices and the modulation of the synth to the preset at once, without touching the parameters. For the
+    * audio thread, only while the output is faded out.
+    */
+    void applyPreset(const cw::synth::SynthPreset& preset);
+    // Sets all parameters and their targets to the preset which the audio thread has applied. For the message thread.
+    void takeOverPreset(const cw::synth::SynthPreset& preset);
+    // Renders the synth into the buffer, fading the output out and in around the swap of a pending preset.
+    template <typename SampleType>
+    void renderSynth(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages);
+    // The spin dimension selected by the spin parameter, see SelectableSpinRotation::setDimension.
+    int getSpinDimension() const;
+    // Passes the processing quantum on to the synth, which switches to it at the start of the next block.
+    void updateProcessingQuantum();
+    /*
+    * Passes the processing quantum on to the synth and reports the latency it adds to the host. Not for the audio 
+    * thread, as hosts may lock or restart the processing when the latency changes.
+    */
+    void updateLatency();
+
+    /*
+    * The quantum or render ahead parameters changed. The latency is reported and the lanes of rendering ahead are 
+    * handed to the workers from the message thread. Changes from automation on the audio thread only raise a flag,
+    * as posting a message takes a lock; the timer picks them up.
+    */
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override {}
+    void timerCallback() override;
+    // Takes over the quantum and render ahead parameters. For the message thread.
+    void updateSettings();
+
+    // the interval at which the message thread looks for changes raised by the audio thread
+    static constexpr int settingsPollMs = 50;
+    std::atomic<bool> settingsChanged{ false };
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NewProjectAudioProcessor)
 };
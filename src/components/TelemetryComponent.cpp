@@ -0,0 +1,118 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "TelemetryComponent.h"
+
+#include <JuceHeader.h>
+
+namespace cw::synth {
+
+TelemetryComponent::TelemetryComponent(TelemetryCollector& collector) : collector(collector) {
+    saveJsonButton.onClick = [this] { save(true); };
+    addAndMakeVisible(saveJsonButton);
+
+    saveCsvButton.onClick = [this] { save(false); };
+    addAndMakeVisible(saveCsvButton);
+
+    resetButton.onClick = [this] {
+        this->collector.reset();
+        statusLabel.setText({}, juce::dontSendNotification);
+    };
+    addAndMakeVisible(resetButton);
+
+    statusLabel.setFont(juce::Font(10.0f));
+    statusLabel.setJustificationType(juce::Justification::left);
+    addAndMakeVisible(statusLabel);
+
+    startTimerHz(4);
+}
+
+void TelemetryComponent::timerCallback() {
+    summary = collector.getSummary();
+    repaint();
+}
+
+juce::File TelemetryComponent::getOutputDirectory() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("Additive Synth");
+}
+
+void TelemetryComponent::save(bool asJson) {
+    auto directory = getOutputDirectory();
+    directory.createDirectory();
+    auto file = directory.getChildFile(asJson ? "telemetry.json" : "telemetry.csv");
+
+    const bool written = asJson ? collector.writeJson(file) : collector.writeCsv(file);
+    statusLabel.setText(written ? "Saved to " + file.getFullPathName() : "Could not write " + file.getFullPathName(),
+        juce::dontSendNotification);
+}
+
+void TelemetryComponent::paint(juce::Graphics& g) {
+    auto area = this->getLocalBounds();
+
+    g.setFont(20);
+    g.drawText("Processing Time", area.removeFromTop(TEXTMARGIN), juce::Justification::centredTop);
+    area.removeFromBottom(2 * LINEHEIGHT);
+
+    auto textArea = area.removeFromLeft(area.getWidth() * 2 / 3);
+    g.setFont(12);
+
+    g.drawText("Blocks: " + juce::String(summary.numBlocks) + ", over budget: " 
+        + juce::String(summary.blocksOverBudget) + ", dropped records: " + juce::String(summary.droppedRecords),
+        textArea.removeFromTop(LINEHEIGHT), juce::Justification::left);
+
+    const auto& worst = summary.worstBlock;
+    g.drawText("Worst block: " + juce::String(worst.getTotalSeconds() * 1e6, 1) + " us of "
+        + juce::String(worst.getBudgetSeconds() * 1e6, 1) + " us (" + juce::String(worst.getLoad() * 100., 1) + " %)",
+        textArea.removeFromTop(LINEHEIGHT), juce::Justification::left);
+
+    juce::String worstStages{ "  " };
+    juce::String meanStages{ "  " };
+    for (int stage = 0; stage < numTelemetryStages; ++stage) {
+        worstStages << getTelemetryStageName(stage) << " " << juce::String(worst.getStageSeconds(stage) * 1e6, 1) << "  ";
+        const double mean = summary.numBlocks > 0 ? summary.stageSeconds[(size_t)stage] / summary.numBlocks : 0.;
+        meanStages << getTelemetryStageName(stage) << " " << juce::String(mean * 1e6, 1) << "  ";
+    }
+    g.drawText(worstStages, textArea.removeFromTop(LINEHEIGHT), juce::Justification::left);
+    g.drawText("Mean per block (us):", textArea.removeFromTop(LINEHEIGHT), juce::Justification::left);
+    g.drawText(meanStages, textArea.removeFromTop(LINEHEIGHT), juce::Justification::left);
+
+    // histogram of the processing time per block, logarithmic in time
+    auto histogramArea = area.reduced(4);
+    juce::int64 maxCount = 1;
+    for (auto count : summary.histogram) {
+        maxCount = juce::jmax(maxCount, count);
+    }
+    const float barWidth = histogramArea.getWidth() / (float)TelemetrySummary::numHistogramBuckets;
+    for (int bucket = 0; bucket < TelemetrySummary::numHistogramBuckets; ++bucket) {
+        const float barHeight = histogramArea.getHeight() * summary.histogram[(size_t)bucket] / (float)maxCount;
+        g.fillRect(histogramArea.getX() + bucket * barWidth, histogramArea.getBottom() - barHeight, 
+            barWidth * 0.8f, barHeight);
+    }
+}
+
+void TelemetryComponent::resized() {
+    auto area = this->getLocalBounds();
+    auto bottom = area.removeFromBottom(2 * LINEHEIGHT);
+
+    saveJsonButton.setBounds(bottom.removeFromLeft(BUTTONWIDTH));
+    saveCsvButton.setBounds(bottom.removeFromLeft(BUTTONWIDTH));
+    resetButton.setBounds(bottom.removeFromLeft(BUTTONWIDTH));
+    statusLabel.setBounds(bottom);
+}
+
+} // namespace cw::synth
@@ -0,0 +1,60 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../util/Telemetry.h"
+
+namespace cw::synth {
+
+/**
+ * Shows the timing statistics of the audio processing: the number of blocks over budget, the worst block with its
+ * stages, the mean time per stage and a histogram of the processing time per block. The statistics can be saved as 
+ * JSON and CSV files in the application data directory.
+ */
+class TelemetryComponent : public juce::Component, private juce::Timer {
+
+	public:
+		TelemetryComponent(TelemetryCollector& collector);
+		void paint(juce::Graphics& g) override;
+		void resized() override;
+
+	private:
+		TelemetryCollector& collector;
+		TelemetrySummary summary;
+
+		juce::TextButton saveJsonButton{ "Save JSON" };
+		juce::TextButton saveCsvButton{ "Save CSV" };
+		juce::TextButton resetButton{ "Reset" };
+		juce::Label statusLabel;
+
+		const int TEXTMARGIN{ 30 };
+		const int BUTTONWIDTH{ 80 };
+		const int LINEHEIGHT{ 14 };
+
+		void timerCallback() override;
+		// The directory the statistics are saved to.
+		static juce::File getOutputDirectory();
+		void save(bool asJson);
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TelemetryComponent)
+
+	};
+
+} // namespace cw::synth
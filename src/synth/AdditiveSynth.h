@@ -22,8 +22,15 @@
 #include "../util/SoundProcessor.h"
 #include "SineGenerator.h"
 #include "QuantumEffects.h"
+#include "BakedWaveform.h"
+#include "Modulation.h"
+#include "../util/Telemetry.h"
+#include "../util/Arena.h"
+#include "RenderAhead.h"
+#include "../util/RealtimeSafety.h"
 
 #define ADDSYNTH_MAXPOLYPHONY 8
+#define ADDSYNTH_DEFAULTBLOCKSIZE 512
 
 namespace cw::synth {
 
@@ -39,11 +46,38 @@ struct AddSynthSound : public juce::SynthesiserSound
 
 struct AddSynthVoice : public juce::SynthesiserVoice
 {
-    AddSynthVoice() {
-        SineGenerator generator{ 44100, 1.0, 1.0 };
-        harmProcessor = std::make_shared<HarmonicSoundProcessor>(generator.generate(), 44100);
+    AddSynthVoice() : harmProcessor(getDefaultSound(), 44100) {
         adsrCurve = juce::ADSR();
-        rotator.clearBuffer();
+        clearRotationBuffers();
+        prepare(ADDSYNTH_DEFAULTBLOCKSIZE);
+    }
+
+    /*
+    * Allocates the buffers for blocks of up to the given size, for both precisions, in an arena of the voice. Larger
+    * blocks are rendered in several parts, so that rendering never allocates. The precision which the host uses is 
+    * the one whose rotation follows the modulation.
+    */
+    void prepare(int maxBlockSize, bool useDoublePrecision = false) {
+        ownArena.allocate(getArenaSize(maxBlockSize));
+        prepare(maxBlockSize, useDoublePrecision, ownArena);
+    }
+
+    /*
+    * The same, with the buffers taken from the given arena, which must have room for getArenaSize(maxBlockSize) bytes
+    * and outlive the buffers, i.e. until the next call of prepare.
+    */
+    void prepare(int maxBlockSize, bool useDoublePrecision, Arena& arena) {
+        if (&arena != &ownArena) {
+            ownArena = Arena();
+        }
+        floatBuffers.take(arena, maxBlockSize);
+        doubleBuffers.take(arena, maxBlockSize);
+        doublePrecision = useDoublePrecision;
+    }
+
+    // The size of the arena which the buffers for blocks of up to the given size take, for both precisions.
+    static size_t getArenaSize(int maxBlockSize) {
+        return Buffers<float>::getArenaSize(maxBlockSize) + Buffers<double>::getArenaSize(maxBlockSize);
     }
 
     bool canPlaySound(juce::SynthesiserSound* sound) override
@@ -54,20 +88,27 @@ struct AddSynthVoice : public juce::SynthesiserVoice
     void startNote(int midiNoteNumber, float velocity,
         juce::SynthesiserSound*, int /*currentPitchWheelPosition*/) override
     {
-
-        rotator.clearBuffer();
+        syncRenderAhead();
+        clearRotationBuffers();
         this->midiNoteNumber = midiNoteNumber;
-        harmProcessor->resetPos();
-        harmProcessor->setSampleRate(getSampleRate());
+        harmProcessor.resetPos();
+        harmProcessor.setSampleRate(getSampleRate());
+
+        // A4: midi no. 69, pitch 440 Hz; the sound table plays one period per second at a playing factor of one
+        const double frequency = 440. * std::pow(2., (midiNoteNumber - 69.) / 12.);
+        bakedPhase = 0.;
+        bakedIncrement = BakedWaveform::tableSize * frequency / getSampleRate();
+        bakedLevel = BakedWaveform::getLevelForFrequency(frequency, getSampleRate());
 
         tailOff = 0.0;
 
         adsrCurve.noteOn();
-
+        modulationEnvelopes.noteOn();
     }
 
     void stopNote(float /*velocity*/, bool allowTailOff) override
     {
+        syncRenderAhead();
         if (allowTailOff)
         {
             if (tailOff == 0.0) {
@@ -77,72 +118,622 @@ struct AddSynthVoice : public juce::SynthesiserVoice
         else
         {
             clearCurrentNote();
-            rotator.clearBuffer();
+            clearRotationBuffers();
             angleDelta = 0.0;
         }
 
         adsrCurve.noteOff();
+        modulationEnvelopes.noteOff();
     }
 
     void pitchWheelMoved(int) override {}
     void controllerMoved(int, int) override {}
 
-    void renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    void renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
     {
-        auto synthesizedOutput = harmProcessor->process(numSamples, 1., this->midiNoteNumber);
-        auto outBuf = rotator.spinRotate(std::array<std::vector<float>, 2>{synthesizedOutput,
-            synthesizedOutput});
-        if (tailOff > 0.0) {
-            for (int sampleNo = 0; sampleNo < outBuf[0].size(); ++sampleNo) {
-                for (auto i = outputBuffer.getNumChannels(); --i >= 0;) {
-                    auto currentSample = outBuf[i][sampleNo] * 0.1 * adsrCurve.getNextSample();
-                    outputBuffer.addSample(i, startSample, currentSample);
-                }
-                tailOff = adsrCurve.getNextSample();
-                ++startSample;
-                if (tailOff <= 0.005)
-                {
-                    clearCurrentNote();
-                    rotator.clearBuffer();      
-                    break;
-                }
-            }
-        }
-        else {
-            for (int sampleNo = 0; sampleNo < outBuf[0].size(); ++sampleNo) {
-                for (auto i = outputBuffer.getNumChannels(); --i >= 0;) {
-                    auto currentSample = outBuf[i][sampleNo] * 0.1 * adsrCurve.getNextSample();
-                    outputBuffer.addSample(i, startSample, currentSample);
-                }
-                ++startSample;
-            }
+        renderBlock(outputBuffer, startSample, numSamples);
+    }
+
+    // The same processing in double precision throughout, for hosts which mix in double.
+    void renderNextBlock(juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+    {
+        renderBlock(outputBuffer, startSample, numSamples);
+    }
+
+    // Stops the voice immediately and brings it back to the state of a newly created voice, apart from its parameters.
+    void reset() {
+        if (ahead != nullptr) {
+            ahead->lane.cancel();
         }
+        clearCurrentNote();
+        adsrCurve.reset();
+        modulationEnvelopes.reset();
+        clearRotationBuffers();
+        harmProcessor.resetPos();
+        tailOff = 0.0;
+    }
+
+    /*
+    * The sine table which all voices play, generated once and shared by all voices of all synth instances of the
+    * process.
+    */
+    static std::shared_ptr<const SoundTable> getDefaultSound() {
+        static const auto sound = std::make_shared<const SoundTable>(SineGenerator{ 44100, 1.0, 1.0 }.generate());
+        return sound;
     }
 
-    std::shared_ptr<HarmonicSoundProcessor> getHarmProcessor() {
-        return harmProcessor;
+    HarmonicSoundProcessor* getHarmProcessor() {
+        return &harmProcessor;
     }
 
     void setAdsrParameters(float a, float d, float s, float r) {
         // a in seconds, d in seconds, s level, r in seconds
-        adsrCurve.setParameters(juce::ADSR::Parameters(a*2, d, s, r*3));
+        const juce::ADSR::Parameters parameters(a*2, d, s, r*3);
+        const auto& current = adsrCurve.getParameters();
+        if (parameters.attack != current.attack || parameters.decay != current.decay 
+            || parameters.sustain != current.sustain || parameters.release != current.release) {
+            syncRenderAhead();
+        }
+        adsrCurve.setParameters(parameters);
     }
 
+    // While the voice is modulated, the angles are the base values to which the modulation is added.
     void setPhi(float phi) {
-        rotator.setPhi(phi);
+        if (phi != basePhi) {
+            syncRenderAhead();
+        }
+        basePhi = phi;
+        if (!modulated) {
+            rotator.setPhi(phi);
+            doubleRotator.setPhi(phi);
+        }
     }
 
     void setTheta(float theta) {
-        rotator.setTheta(theta);
+        if (theta != baseTheta) {
+            syncRenderAhead();
+        }
+        baseTheta = theta;
+        if (!modulated) {
+            rotator.setTheta(theta);
+            doubleRotator.setTheta(theta);
+        }
+    }
+
+    // Sets the envelopes of the modulation, which are advanced at the given control rate.
+    void setModulationEnvelopes(
+        const std::array<ModulationEnvelopeSettings, ModulationSettings::maxEnvelopes>& settings, double controlRate) {
+        modulationEnvelopes.setParameters(settings, controlRate);
+    }
+
+    /*
+    * Called once per control interval while the modulation is active: advances the envelopes of the voice, evaluates
+    * the routes and lets the angles and the harmonic gains glide to the new values within the given number of
+    * samples.
+    */
+    void tickModulation(const ModulationMatrix& matrix, int numSamples) {
+        syncRenderAhead();
+        matrix.evaluate(modulationEnvelopes.tick(), modulationOffsets);
+        modulated = true;
+        // only the rotation in use glides, the other one takes over the angles
+        const auto phi = basePhi + modulationOffsets.phi;
+        const auto theta = baseTheta + modulationOffsets.theta;
+        if (doublePrecision) {
+            doubleRotator.glideTo(phi, theta, numSamples);
+            rotator.setPhi(phi);
+            rotator.setTheta(theta);
+        }
+        else {
+            rotator.glideTo(phi, theta, numSamples);
+            doubleRotator.setPhi(phi);
+            doubleRotator.setTheta(theta);
+        }
+        harmProcessor.setGainModulation(modulationOffsets.harmonicGains, numSamples);
+    }
+
+    // Goes back to the unmodulated parameters at once.
+    void clearModulation() {
+        modulated = false;
+        rotator.setPhi(basePhi);
+        rotator.setTheta(baseTheta);
+        doubleRotator.setPhi(basePhi);
+        doubleRotator.setTheta(baseTheta);
+        harmProcessor.clearGainModulation();
+    }
+
+    void setRotationMode(RotationMode mode) {
+        if (mode != rotationMode) {
+            syncRenderAhead();
+            rotationMode = mode;
+        }
+        rotator.setMode(mode);
+        doubleRotator.setMode(mode);
+    }
+
+    // Selects how the partials are computed, see HarmonicSoundProcessor::setOscillatorEngine.
+    void setOscillatorEngine(OscillatorEngine engine) {
+        harmProcessor.setOscillatorEngine(engine);
+    }
+
+    // Selects the interpolation of the sound, see HarmonicSoundProcessor::setInterpolation.
+    void setInterpolation(TableInterpolation interpolation) {
+        harmProcessor.setInterpolation(interpolation);
+    }
+
+    // Sets the tuning of the partials, see HarmonicSoundProcessor::setPartialRatios.
+    void setPartialRatios(const PartialRatios& ratios) {
+        harmProcessor.setPartialRatios(ratios);
+    }
+
+    /*
+    * Plays each note as a stack of detuned copies of the harmonics, see HarmonicSoundProcessor::setUnison. The copies
+    * are spread over both inputs of the rotation. Baked waveforms play without unison.
+    */
+    void setUnison(int voices, float detuneCents, float spread) {
+        harmProcessor.setUnison(voices, detuneCents, spread);
+    }
+
+    // Selects the spin rotation, see SelectableSpinRotation::setDimension.
+    void setSpinDimension(int dimension) {
+        if (dimension != rotator.getDimension()) {
+            syncRenderAhead();
+        }
+        rotator.setDimension(dimension);
+        doubleRotator.setDimension(dimension);
+    }
+
+    /*
+    * Sets the baked waveform to play instead of the harmonics, or null to play the harmonics. If a previous waveform
+    * is given, the voice fades from it to the new one over fadeLength samples, of which fadePosition have passed at
+    * the sample fadeStart of the output buffer. Set for each block by the synth.
+    */
+    void setBakedWaveform(const BakedWaveform* waveform, const BakedWaveform* previous = nullptr, int fadeStart = 0,
+        int fadePosition = 0, int fadeLength = 0) {
+        if (waveform != nullptr) {
+            syncRenderAhead();
+        }
+        bakedWaveform = waveform;
+        fadingWaveform = previous;
+        bakedFadeStart = fadeStart;
+        bakedFadePosition = fadePosition;
+        bakedFadeLength = fadeLength;
+    }
+
+    // Sets the recorder to which the time spent in each stage is added. The recorder must outlive the voice.
+    void setTelemetry(TelemetryRecorder* recorder) {
+        telemetry = recorder;
+    }
+
+    /*
+    * Allocates a copy of the voice, which a worker renders ahead while the voice holds its note, unless it exists 
+    * already, and returns the lane into which it renders. The copy is kept until the voice goes. Not real-time safe.
+    */
+    RenderAheadLane& prepareRenderAhead() {
+        if (aheadRenderer == nullptr) {
+            aheadRenderer = std::make_unique<AheadRenderer>();
+        }
+        return aheadRenderer->lane;
+    }
+
+    /*
+    * While enabled, the voice plays the samples rendered ahead instead of rendering them, as long as it holds its note
+    * in single precision, without modulation and baked waveform, and nothing but time changes; see RenderAheadLane.
+    * Any change brings it back to rendering directly, at once. Requires prepareRenderAhead before enabling.
+    */
+    void setRenderAhead(bool enabled) {
+        if (enabled) {
+            ahead = aheadRenderer.get();
+        }
+        else {
+            syncRenderAhead();
+        }
+        renderAheadEnabled = enabled && ahead != nullptr;
     }
 
     private:
-        std::shared_ptr<HarmonicSoundProcessor> harmProcessor;
-        int midiNoteNumber;
+        /*
+        * working buffers for the oscillator output, the rotated output and the envelope values of the current block; 
+        * the oscillator output has a right channel of its own with unison only. The buffers are slices of one arena.
+        */
+        template <typename SampleType>
+        struct Buffers {
+            static constexpr int numBuffers = 6;
+
+            SampleType* oscillator{ nullptr };
+            SampleType* oscillatorRight{ nullptr };
+            std::array<SampleType*, 2> rotated{};
+            std::array<SampleType*, 2> envelope{};
+            int size{ 0 };
+
+            static size_t getArenaSize(int size) {
+                return numBuffers * Arena::getSliceSize<SampleType>(size);
+            }
+
+            void take(Arena& arena, int newSize) {
+                size = newSize;
+                oscillator = arena.take<SampleType>(size);
+                oscillatorRight = arena.take<SampleType>(size);
+                for (auto& channel : rotated) {
+                    channel = arena.take<SampleType>(size);
+                }
+                for (auto& channel : envelope) {
+                    channel = arena.take<SampleType>(size);
+                }
+                jassert(envelope[1] != nullptr);
+            }
+        };
+
+        template <typename SampleType>
+        Buffers<SampleType>& getBuffers() {
+            if constexpr (std::is_same_v<SampleType, double>) {
+                return doubleBuffers;
+            }
+            else {
+                return floatBuffers;
+            }
+        }
+
+        template <typename SampleType>
+        BasicSelectableSpinRotation<SampleType>& getRotator() {
+            if constexpr (std::is_same_v<SampleType, double>) {
+                return doubleRotator;
+            }
+            else {
+                return rotator;
+            }
+        }
+
+        void clearRotationBuffers() {
+            rotator.clearBuffer();
+            doubleRotator.clearBuffer();
+        }
+
+        template <typename SampleType>
+        void renderBlock(juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+        {
+            if constexpr (std::is_same_v<SampleType, float>) {
+                if (readRenderAhead(outputBuffer, startSample, numSamples)) {
+                    return;
+                }
+            }
+
+            renderParts(outputBuffer, startSample, numSamples);
+
+            if constexpr (std::is_same_v<SampleType, float>) {
+                startRenderAhead();
+            }
+        }
+
+        // Renders the block directly, in parts which fit into the buffers.
+        template <typename SampleType>
+        void renderParts(juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+        {
+            const int maxBlockSize = getBuffers<SampleType>().size;
+            while (numSamples > 0) {
+                const int partSize = juce::jmin(numSamples, maxBlockSize);
+                if (!renderPart(outputBuffer, startSample, partSize)) {
+                    break;
+                }
+                startSample += partSize;
+                numSamples -= partSize;
+            }
+        }
+
+        // What the voice needs to return to the state at the start of a slot of the lane.
+        struct RenderCheckpoint {
+            HarmonicSoundProcessor::PlaybackState playback;
+            SelectableSpinRotation rotator;
+            juce::ADSR adsr;
+        };
+
+        // The copy of the voice which the worker renders ahead, with the checkpoints of the slots.
+        class AheadRenderer : public RenderAheadSource {
+            public:
+                AheadRenderer() : shadow(std::make_unique<AddSynthVoice>()), scratch(2, RenderAheadLane::slotSize) {
+                    shadow->prepare(RenderAheadLane::slotSize);
+                }
+
+                void saveCheckpoint(int slot) override {
+                    auto& checkpoint = checkpoints[slot];
+                    checkpoint.playback = shadow->harmProcessor.getPlaybackState();
+                    checkpoint.rotator = shadow->rotator;
+                    checkpoint.adsr = shadow->adsrCurve;
+                }
+
+                void renderAhead(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override {
+                    shadow->renderBlock(buffer, startSample, numSamples);
+                }
+
+                std::unique_ptr<AddSynthVoice> shadow;
+                std::array<RenderCheckpoint, RenderAheadLane::numSlots> checkpoints;
+                // the version of the parameters of the processor and the note which the copy plays
+                juce::uint32 parameterVersion{ 0 };
+                int midiNoteNumber{ -1 };
+                // for rendering the samples from a checkpoint to the position once more
+                juce::AudioBuffer<float> scratch;
+                RenderAheadLane lane{ *this };
+        };
+
+        /*
+        * Plays the samples rendered ahead, if they are ready and still valid: for the same note, before its release
+        * and with the same parameters. Returns false if the voice has to render.
+        */
+        bool readRenderAhead(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) {
+            if (ahead == nullptr || !ahead->lane.isActive()) {
+                return false;
+            }
+            auto& lane = ahead->lane;
+            if (harmProcessor.getParameterVersion() == ahead->parameterVersion && tailOff == 0.0 
+                && midiNoteNumber == ahead->midiNoteNumber) {
+                if (lane.read(outputBuffer, startSample, numSamples)) {
+                    return true;
+                }
+                // the voice goes on by itself until the worker has caught up
+                if (!lane.hasRead()) {
+                    lane.skip(numSamples);
+                    return false;
+                }
+            }
+            syncRenderAhead();
+            return false;
+        }
+
+        /*
+        * Goes back to rendering directly: returns to the checkpoint before the position up to which the voice has 
+        * played from the lane, renders the samples from there once more and stops the lane. The samples are rendered
+        * without starting the lane again, as startNote and stopNote sync before they change the note.
+        */
+        void syncRenderAhead() {
+            if (ahead == nullptr || !ahead->lane.isActive()) {
+                return;
+            }
+            auto& lane = ahead->lane;
+            lane.cancel();
+            if (!lane.hasRead()) {
+                return;
+            }
+
+            int samplesSinceCheckpoint = 0;
+            const auto& checkpoint = ahead->checkpoints[lane.getCheckpoint(samplesSinceCheckpoint)];
+            harmProcessor.setPlaybackState(checkpoint.playback);
+            rotator = checkpoint.rotator;
+            adsrCurve = checkpoint.adsr;
+            ahead->scratch.clear();
+            renderParts(ahead->scratch, 0, samplesSinceCheckpoint);
+        }
+
+        // Lets the worker render ahead from the current state, if the voice holds its note and the lane is free.
+        void startRenderAhead() {
+            if (!renderAheadEnabled || !ahead->lane.isIdle() || !isVoiceActive() || tailOff > 0.0 || modulated 
+                || bakedWaveform != nullptr || doublePrecision) {
+                return;
+            }
+            auto& shadow = *ahead->shadow;
+            shadow.harmProcessor = harmProcessor;
+            shadow.rotator = rotator;
+            shadow.adsrCurve = adsrCurve;
+            shadow.midiNoteNumber = midiNoteNumber;
+            ahead->parameterVersion = harmProcessor.getParameterVersion();
+            ahead->midiNoteNumber = midiNoteNumber;
+            ahead->lane.start();
+        }
+
+        /*
+        * Renders a part of a block which fits into the buffers. Returns false if the note has finished within this 
+        * part.
+        */
+        template <typename SampleType>
+        bool renderPart(juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+        {
+            auto& buffers = getBuffers<SampleType>();
+            const SampleType* oscillatorRight = buffers.oscillator;
+            {
+                TelemetryRecorder::ScopedStage stage(telemetry, stageOscillators);
+                // inharmonic partials do not fit into a single cycle, they are played as they are
+                if (bakedWaveform != nullptr && harmProcessor.hasHarmonicPartials()) {
+                    renderBakedWaveform(buffers.oscillator, startSample, numSamples);
+                }
+                else if (harmProcessor.getUnisonVoices() > 1) {
+                    harmProcessor.process(buffers.oscillator, buffers.oscillatorRight, numSamples, (SampleType)1., 
+                        this->midiNoteNumber);
+                    oscillatorRight = buffers.oscillatorRight;
+                }
+                else {
+                    harmProcessor.process(buffers.oscillator, numSamples, (SampleType)1., this->midiNoteNumber);
+                }
+            }
+
+            {
+                TelemetryRecorder::ScopedStage stage(telemetry, stageRotation);
+                getRotator<SampleType>().spinRotate(buffers.oscillator, oscillatorRight, buffers.rotated[0], 
+                    buffers.rotated[1], numSamples);
+            }
+            auto& envelope = buffers.envelope;
+
+            // The envelope is evaluated once per output channel and sample, and once more per sample for the tail off 
+            // while the note is released. 
+            const int numChannels = juce::jmin(outputBuffer.getNumChannels(), 2);
+            int numOutSamples = numSamples;
+            bool noteFinished = false;
+            {
+                TelemetryRecorder::ScopedStage stage(telemetry, stageEnvelope);
+                const bool releasing = tailOff > 0.0;
+                for (int sampleNo = 0; sampleNo < numOutSamples; ++sampleNo) {
+                    for (auto i = numChannels; --i >= 0;) {
+                        envelope[i][sampleNo] = adsrCurve.getNextSample();
+                    }
+                    if (releasing) {
+                        tailOff = adsrCurve.getNextSample();
+                        if (tailOff <= 0.005) {
+                            numOutSamples = sampleNo + 1;
+                            noteFinished = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            {
+                TelemetryRecorder::ScopedStage stage(telemetry, stageMix);
+                for (int sampleNo = 0; sampleNo < numOutSamples; ++sampleNo) {
+                    for (auto i = numChannels; --i >= 0;) {
+                        auto currentSample = buffers.rotated[i][sampleNo] * 0.1 * envelope[i][sampleNo];
+                        outputBuffer.addSample(i, startSample, currentSample);
+                    }
+                    ++startSample;
+                }
+            }
+
+            if (noteFinished) {
+                clearCurrentNote();
+                clearRotationBuffers();
+            }
+            return !noteFinished;
+        }
+
+        // Plays the baked waveform into the oscillator buffer, one interpolated lookup per sample.
+        template <typename SampleType>
+        void renderBakedWaveform(SampleType* output, int startSample, int numSamples)
+        {
+            const float* table = bakedWaveform->getLevel(bakedLevel);
+            const float* fadingTable = fadingWaveform != nullptr ? fadingWaveform->getLevel(bakedLevel) : nullptr;
+            constexpr auto tableSize = (double)BakedWaveform::tableSize;
+
+            for (int i = 0; i < numSamples; ++i) {
+                const int pos = (int)bakedPhase;
+                const auto frac = (SampleType)(bakedPhase - pos);
+                auto value = table[pos] + frac * (table[pos + 1] - table[pos]);
+                if (fadingTable != nullptr) {
+                    const auto fading = fadingTable[pos] + frac * (fadingTable[pos + 1] - fadingTable[pos]);
+                    const auto fadeIn = juce::jlimit(SampleType(0), SampleType(1),
+                        (SampleType)(bakedFadePosition + startSample + i - bakedFadeStart + 1) / (SampleType)bakedFadeLength);
+                    value = fading + fadeIn * (value - fading);
+                }
+                output[i] = value;
+
+                bakedPhase += bakedIncrement;
+                if (bakedPhase >= tableSize) {
+                    bakedPhase -= tableSize;
+                }
+            }
+        }
+
+        /*
+        * The state which rendering reads for each sample comes first, within the voice object itself, next to the 
+        * buffers in the arena; the parameters, the modulation and the telemetry, which are read once per block, follow.
+        */
+        HarmonicSoundProcessor harmProcessor;
+        // the rotations for float and double samples, see prepare
+        SelectableSpinRotation rotator{};
+        BasicSelectableSpinRotation<double> doubleRotator{};
+        juce::ADSR adsrCurve;
+        Buffers<float> floatBuffers;
+        Buffers<double> doubleBuffers;
         // for testing...
         double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
-        juce::ADSR adsrCurve;
-        Spin3Rotation rotator{};
+        // playing a baked waveform: the waveforms of the current block, the position in the table and the 
+        // band-limited level for the note
+        const BakedWaveform* bakedWaveform{ nullptr };
+        const BakedWaveform* fadingWaveform{ nullptr };
+        int bakedFadeStart{ 0 };
+        int bakedFadePosition{ 0 };
+        int bakedFadeLength{ 0 };
+        double bakedPhase{ 0. };
+        double bakedIncrement{ 0. };
+        int bakedLevel{ 0 };
+
+        int midiNoteNumber;
+        bool doublePrecision{ false };
+        // the angles without modulation, and the modulation of the voice
+        float basePhi{ 0.f };
+        float baseTheta{ 0.f };
+        bool modulated{ false };
+        ModulationEnvelopes modulationEnvelopes;
+        ModulationOffsets modulationOffsets;
+        TelemetryRecorder* telemetry{ nullptr };
+        // the arena of the buffers, unless they are taken from the arena of the synth
+        Arena ownArena;
+        RotationMode rotationMode{ RotationMode::generators };
+        // rendering ahead, see setRenderAhead: the copy of the voice, and the copy as taken over by the audio thread,
+        // which only looks at it once it has been enabled
+        std::unique_ptr<AheadRenderer> aheadRenderer;
+        AheadRenderer* ahead{ nullptr };
+        bool renderAheadEnabled{ false };
+};
+
+//===================================================================================
+
+/**
+ * The JUCE synthesiser, with a voice stealing which does not allocate. juce::Synthesiser collects the candidates for
+ * stealing in a temporary array; here, the array is allocated once, up front. The stealing policy is the same.
+ */
+class AddSynthesiser : public juce::Synthesiser {
+    public:
+        AddSynthesiser() {
+            stealCandidates.reserve(ADDSYNTH_MAXPOLYPHONY);
+        }
+
+    protected:
+        juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int /*midiChannel*/,
+            int midiNoteNumber) const override {
+            // the lowest and the highest sounding notes which are not released are protected
+            juce::SynthesiserVoice* low = nullptr;
+            juce::SynthesiserVoice* top = nullptr;
+
+            stealCandidates.clear();
+            for (auto* voice : voices) {
+                if (voice->canPlaySound(soundToPlay)) {
+                    stealCandidates.push_back(voice);
+
+                    if (!voice->isPlayingButReleased()) {
+                        auto note = voice->getCurrentlyPlayingNote();
+                        if (low == nullptr || note < low->getCurrentlyPlayingNote()) {
+                            low = voice;
+                        }
+                        if (top == nullptr || note > top->getCurrentlyPlayingNote()) {
+                            top = voice;
+                        }
+                    }
+                }
+            }
+            // oldest voices first
+            std::sort(stealCandidates.begin(), stealCandidates.end(),
+                [](const juce::SynthesiserVoice* a, const juce::SynthesiserVoice* b) { return a->wasStartedBefore(*b); });
+
+            // with only one note playing, the lowest note takes precedence
+            if (top == low) {
+                top = nullptr;
+            }
+
+            // the oldest voice playing the same note
+            for (auto* voice : stealCandidates) {
+                if (voice->getCurrentlyPlayingNote() == midiNoteNumber) {
+                    return voice;
+                }
+            }
+            // the oldest released voice
+            for (auto* voice : stealCandidates) {
+                if (voice != low && voice != top && voice->isPlayingButReleased()) {
+                    return voice;
+                }
+            }
+            // the oldest voice without a key held down
+            for (auto* voice : stealCandidates) {
+                if (voice != low && voice != top && !voice->isKeyDown()) {
+                    return voice;
+                }
+            }
+            // the oldest unprotected voice
+            for (auto* voice : stealCandidates) {
+                if (voice != low && voice != top) {
+                    return voice;
+                }
+            }
+            return top != nullptr ? top : low;
+        }
+
+    private:
+        mutable std::vector<juce::SynthesiserVoice*> stealCandidates;
 };
 
 //===================================================================================
@@ -151,10 +742,190 @@ class AdditiveSynth : public juce::AudioSource {
     public:
         AdditiveSynth()
         {
-            for (auto i = 0; i < ADDSYNTH_MAXPOLYPHONY; ++i)
-                synth.addVoice(new AddSynthVoice());
+            for (auto i = 0; i < ADDSYNTH_MAXPOLYPHONY; ++i) {
+                auto voice = new AddSynthVoice();
+                voice->setTelemetry(&telemetry);
+                synth.addVoice(voice);
+                voices.push_back(voice);
+            }
 
             synth.addSound(new AddSynthSound());
+            baker = std::make_unique<WaveformBaker>(voices.front()->getHarmProcessor()->getSound());
+#if ADDSYNTH_RT_SAFETY_CHECKS
+            // taken by juce::Synthesiser around each block and event, but only the thread which renders takes it
+            rtsafety::ignoreLock(&synth.getLock());
+#endif
+        }
+#if ADDSYNTH_RT_SAFETY_CHECKS
+        ~AdditiveSynth() override {
+            rtsafety::stopIgnoringLock(&synth.getLock());
+        }
+#endif
+
+        /*
+        * With baked waveforms, the weighted sum of the harmonics is baked into a single-cycle table, which the voices
+        * play with one lookup per sample instead of one per harmonic. The table is baked again in the background
+        * whenever the gains change, and the voices fade over to the new table. Meant for sounds whose gains do not
+        * change much; all voices play the gains of the first voice. Can be switched from any thread.
+        */
+        void setBakedWaveformEnabled(bool shouldBeEnabled) {
+            bakedWaveformEnabled = shouldBeEnabled;
+        }
+        bool isBakedWaveformEnabled() const {
+            return bakedWaveformEnabled;
+        }
+
+        /*
+        * For offline rendering: waits until the waveform for the current gains is baked and in use, so that the 
+        * rendering does not depend on the timing of the baking thread. Call after prepareToPlay, from the thread which
+        * renders. Returns false on timeout.
+        */
+        bool waitForBakedWaveform(int timeoutMs) {
+            // nothing to wait for, the wavetable is played instead
+            if (wavetable != nullptr) {
+                return true;
+            }
+            const auto endTime = juce::Time::getMillisecondCounter() + (juce::uint32)timeoutMs;
+            updateBakedWaveform(0, 0);
+            while (!baker->isUpToDate() && juce::Time::getMillisecondCounter() < endTime) {
+                juce::Thread::sleep(1);
+                updateBakedWaveform(0, 0);
+            }
+            // no fade into the waveform at the start of the next block
+            if (fadingWaveform != nullptr) {
+                baker->release(fadingWaveform);
+                fadingWaveform = nullptr;
+            }
+            return baker->isUpToDate();
+        }
+
+        /*
+        * Lets all voices play the given sound for each harmonic, e.g. a large recorded source mapped with 
+        * SoundTable::loadCached. The sound is shared, not copied. Not real-time safe: call while the synth is not
+        * rendering, e.g. before prepareToPlay.
+        */
+        void setSound(std::shared_ptr<const SoundTable> sound) {
+            // the copies of the voices which render ahead take the sound over on the audio thread, which must not drop
+            // the last reference to the previous one, see SoundTable; it is kept until nothing else holds it
+            if (!voices.empty()) {
+                retiredSounds.push_back(voices.front()->getHarmProcessor()->getSound());
+            }
+            retiredSounds.erase(std::remove_if(retiredSounds.begin(), retiredSounds.end(), 
+                [](const auto& retired) { return retired.use_count() == 1; }), retiredSounds.end());
+            for (auto voice : voices) {
+                voice->getHarmProcessor()->setSound(sound);
+            }
+            baker->setSound(std::move(sound));
+            bakedWaveform = nullptr;
+            fadingWaveform = nullptr;
+        }
+
+        /*
+        * Lets all voices play the given wavetable instead of the sound, or the sound again if null. The wavetable is
+        * band-limited per octave, so that any material can be played without aliasing. Baked waveforms are not used
+        * while a wavetable is set. Not real-time safe: call while the synth is not rendering, e.g. before 
+        * prepareToPlay.
+        */
+        void setWavetable(std::shared_ptr<const Wavetable> table) {
+            for (auto voice : voices) {
+                voice->getHarmProcessor()->setWavetable(table);
+            }
+            wavetable = std::move(table);
+        }
+        const std::shared_ptr<const Wavetable>& getWavetable() const {
+            return wavetable;
+        }
+
+        // The position between the first (0) and the last frame (1) of the wavetable. Can be set from any thread.
+        void setWavetableMorph(float position) {
+            wavetableMorph = position;
+        }
+
+        /*
+        * Sets the LFOs, envelopes and routes of the modulation. The routes are evaluated once per control interval,
+        * and the angles and gains glide to the new values in between. Can be called from any thread; the settings are
+        * taken over at the start of the next block. Without routes, the synth renders exactly as without modulation.
+        */
+        void setModulation(const ModulationSettings& settings) {
+            const juce::SpinLock::ScopedLockType lock(modulationLock);
+            pendingModulation = settings;
+            modulationChanged = true;
+        }
+        // The settings given last to setModulation.
+        ModulationSettings getModulation() const {
+            const juce::SpinLock::ScopedLockType lock(modulationLock);
+            return pendingModulation;
+        }
+        /*
+        * Advances the LFOs and the ticks of the control rate as if the given number of samples had been rendered while
+        * no voice sounds, tick by tick, so that a synth starting in the middle of a timeline modulates exactly like one
+        * which rendered everything before. For rendering parts of a timeline offline; call on the audio thread.
+        */
+        void advanceModulation(juce::int64 numSamples) {
+            updateModulation();
+            if (!modulationMatrix.getSettings().isActive()) {
+                return;
+            }
+            while (numSamples > 0) {
+                if (samplesToNextTick == 0) {
+                    modulationMatrix.tick();
+                    samplesToNextTick = modulationMatrix.getControlInterval();
+                }
+                const int length = (int)juce::jmin(numSamples, (juce::int64)samplesToNextTick);
+                numSamples -= length;
+                samplesToNextTick -= length;
+            }
+        }
+
+        /*
+        * Renders in chunks of a fixed number of samples (a power of two from 16 to 256), whatever the size of the 
+        * blocks of the host, so that the kernels always see the same sizes and the cost per sample does not depend on 
+        * the buffering of the host. Without buffering, the chunks lie on a fixed grid across blocks and the blocks are
+        * split at its lines, without latency; only at the edges of a block, a chunk is rendered in parts. With 
+        * buffering, only whole chunks are rendered, one ahead of the output, which adds the latency of one chunk, see
+        * getLatencySamples. 0 renders each block as it comes. Can be called from any thread; the setting is taken 
+        * over at the start of the next block.
+        */
+        void setProcessingQuantum(int samples, bool buffered = false) {
+            pendingQuantum = samples <= 0 ? 0 : juce::jlimit(minQuantum, maxQuantum, juce::nextPowerOfTwo(samples));
+            pendingQuantumBuffered = buffered;
+        }
+        int getProcessingQuantum() const {
+            return pendingQuantum;
+        }
+        bool isQuantumBuffered() const {
+            return pendingQuantumBuffered;
+        }
+        // The latency added by the processing quantum, in samples, which the host has to compensate.
+        int getLatencySamples() const {
+            return pendingQuantumBuffered ? pendingQuantum.load() : 0;
+        }
+
+        /*
+        * Lets the worker pool shared by all synths of the process render the held notes ahead, which the voices then 
+        * only add to the output; see AddSynthVoice::setRenderAhead and RenderAheadPool. Enabling gives each voice a 
+        * copy for the workers and hands their lanes to the pool, disabling takes the lanes back. Not real-time safe,
+        * call it from the message thread; the voices switch at the start of the next block.
+        */
+        void setRenderAhead(bool enabled) {
+            const juce::ScopedLock sl(renderAheadLock);
+            if (enabled == renderAheadRequested) {
+                return;
+            }
+            if (enabled) {
+                std::vector<RenderAheadLane*> lanes;
+                for (auto voice : voices) {
+                    lanes.push_back(&voice->prepareRenderAhead());
+                }
+                renderAheadQueue.start(std::move(lanes), renderAheadSampleRate);
+            }
+            else {
+                renderAheadQueue.stop();
+            }
+            renderAheadRequested = enabled;
+        }
+        bool isRenderAheadEnabled() const {
+            return renderAheadRequested;
         }
 
         void setUsingSineWaveSound()
@@ -162,36 +933,436 @@ class AdditiveSynth : public juce::AudioSource {
             synth.clearSounds();
         }
 
-        void setMidiBuffer(juce::MidiBuffer midiBuffer) {
-            incomingMidiBuffer = midiBuffer;
+        /*
+        * Sets the MIDI events for the next call of getNextAudioBlock. The buffer is not copied, so it has to stay valid
+        * until getNextAudioBlock has returned.
+        */
+        void setMidiBuffer(const juce::MidiBuffer& midiBuffer) {
+            incomingMidiBuffer = &midiBuffer;
+        }
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+        {
+            prepareToPlay(samplesPerBlockExpected, sampleRate, false);
         }
 
-        void prepareToPlay(int /*samplesPerBlockExpected*/, double sampleRate) override
+        // Prepares for blocks of float samples or, for hosts which mix in double precision, of double samples.
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate, bool doublePrecision)
         {
+            const juce::ScopedLock sl(renderAheadLock);
+            renderAheadQueue.stop();
+            renderAheadSampleRate = sampleRate;
             synth.setCurrentPlaybackSampleRate(sampleRate); // [3]
+            telemetry.setSampleRate(sampleRate);
+            bakedFadeLength = juce::jmax(1, juce::roundToInt(bakedFadeSeconds * sampleRate));
+            // some hosts do not know the block size yet; an empty buffer would never let a voice finish a block
+            if (samplesPerBlockExpected <= 0) {
+                samplesPerBlockExpected = defaultBlockSize;
+            }
+            // the buffers of all voices lie in one arena, one voice after the other
+            voiceArena.allocate(voices.size() * AddSynthVoice::getArenaSize(samplesPerBlockExpected));
+            for (auto voice : voices) {
+                voice->prepare(samplesPerBlockExpected, doublePrecision, voiceArena);
+            }
+            modulationMatrix.setSampleRate(sampleRate);
+            updateModulationEnvelopes();
+            subBlockMidi.ensureSize(subBlockMidiBytes);
+            chunkMidi.ensureSize(subBlockMidiBytes);
+            pendingMidi.ensureSize(subBlockMidiBytes);
+            spareMidi.ensureSize(subBlockMidiBytes);
+            heldFloat.setSize(2, maxQuantum);
+            heldDouble.setSize(2, maxQuantum);
+            resetQuantum();
+            baker->start();
+
+            // the lanes are only in the pool while rendering ahead is enabled
+            std::vector<RenderAheadLane*> lanes;
+            for (auto voice : voices) {
+                if (renderAheadRequested) {
+                    auto& lane = voice->prepareRenderAhead();
+                    lane.reset();
+                    lanes.push_back(&lane);
+                }
+                voice->setRenderAhead(renderAhead);
+            }
+            if (renderAheadRequested) {
+                renderAheadQueue.start(std::move(lanes), sampleRate);
+            }
         }
 
         void releaseResources() override {}
 
         void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override
         {
-            bufferToFill.clearActiveBufferRegion();
+            renderBlock(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        }
 
-            synth.renderNextBlock(*bufferToFill.buffer, incomingMidiBuffer,
-                bufferToFill.startSample, bufferToFill.numSamples);
+        // Same as getNextAudioBlock, for buffers of either precision; double buffers are processed in double throughout.
+        void renderNextBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+        {
+            renderBlock(buffer, startSample, numSamples);
+        }
+        void renderNextBlock(juce::AudioBuffer<double>& buffer, int startSample, int numSamples)
+        {
+            renderBlock(buffer, startSample, numSamples);
         }
 
-        std::vector<AddSynthVoice*> getVoices() {
-            std::vector<AddSynthVoice*> voices;
-            for (int i = 0; i < synth.getNumVoices(); ++i) {
-                voices.push_back(dynamic_cast<AddSynthVoice*>(synth.getVoice(i)));
+        // Stops all voices immediately, without release, and resets them.
+        void reset() {
+            synth.allNotesOff(0, false);
+            for (auto voice : voices) {
+                voice->reset();
             }
+            modulationMatrix.reset();
+            samplesToNextTick = 0;
+            resetQuantum();
+        }
+
+        const std::vector<AddSynthVoice*>& getVoices() const {
             return voices;
         }
 
+        // Timing of the processing stages. The caller of getNextAudioBlock marks the begin and end of each block.
+        TelemetryRecorder& getTelemetry() {
+            return telemetry;
+        }
+
     private:
-        juce::Synthesiser synth;
-        juce::MidiBuffer incomingMidiBuffer;
+        // the space for the MIDI events of a sub-block, which is allocated up front
+        static constexpr size_t subBlockMidiBytes = 4096;
+        // the block size assumed when the host does not give one
+        static constexpr int defaultBlockSize = 512;
+        // the range of the processing quantum
+        static constexpr int minQuantum = 16;
+        static constexpr int maxQuantum = 256;
+        // the length of the fade from one baked waveform to the next
+        static constexpr double bakedFadeSeconds = 0.01;
+
+        template <typename SampleType>
+        void renderBlock(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples)
+        {
+            const auto& midi = updateQuantum(incomingMidiBuffer != nullptr ? *incomingMidiBuffer : noMidi, 
+                startSample, numSamples);
+            incomingMidiBuffer = nullptr;
+            updateRenderAhead();
+
+            if (quantum == 0) {
+                renderChunk(buffer, midi, startSample, numSamples);
+            }
+            else if (quantumBuffered) {
+                renderBuffered(buffer, midi, startSample, numSamples);
+            }
+            else {
+                renderAligned(buffer, midi, startSample, numSamples);
+            }
+        }
+
+        // Takes over the setting of rendering ahead.
+        void updateRenderAhead() {
+            const bool requested = renderAheadRequested;
+            if (requested != renderAhead) {
+                renderAhead = requested;
+                for (auto voice : voices) {
+                    voice->setRenderAhead(renderAhead);
+                }
+            }
+        }
+
+        // Renders a block, or a chunk of it, with the given MIDI events, which all lie within it.
+        template <typename SampleType>
+        void renderChunk(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midi, int startSample, 
+            int numSamples)
+        {
+            buffer.clear(startSample, numSamples);
+            updateBakedWaveform(startSample, numSamples);
+            if (wavetable != nullptr) {
+                for (auto voice : voices) {
+                    voice->getHarmProcessor()->setMorph(wavetableMorph);
+                }
+            }
+
+            updateModulation();
+
+            if (modulationMatrix.getSettings().isActive()) {
+                renderModulated(buffer, midi, startSample, numSamples);
+            }
+            else {
+                synth.renderNextBlock(buffer, midi, startSample, numSamples);
+            }
+
+            // the previous waveform is kept until it has been faded out
+            if (fadingWaveform != nullptr) {
+                bakedFadePosition += numSamples;
+                if (bakedFadePosition >= bakedFadeLength) {
+                    baker->release(fadingWaveform);
+                    fadingWaveform = nullptr;
+                }
+            }
+        }
+
+        /*
+        * Renders the block in chunks on a grid of the processing quantum, which is counted across blocks. The chunks 
+        * at the edges of the block are rendered in parts.
+        */
+        template <typename SampleType>
+        void renderAligned(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midi, int startSample, 
+            int numSamples)
+        {
+            const int endSample = startSample + numSamples;
+            while (startSample < endSample) {
+                if (samplesToNextQuantum == 0) {
+                    samplesToNextQuantum = quantum;
+                }
+                const int length = juce::jmin(endSample - startSample, samplesToNextQuantum);
+                chunkMidi.clear();
+                addMidiEvents(midi, startSample, length, 0, chunkMidi);
+                renderChunk(buffer, chunkMidi, startSample, length);
+
+                startSample += length;
+                samplesToNextQuantum -= length;
+            }
+        }
+
+        /*
+        * Plays the block from the chunk held ahead, rendering whole chunks as it runs out. The output is one chunk
+        * behind, so that all events of a chunk have arrived when it is rendered: the events wait in pendingMidi, 
+        * positioned relative to the start of the next chunk.
+        */
+        template <typename SampleType>
+        void renderBuffered(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midi, int startSample, 
+            int numSamples)
+        {
+            addMidiEvents(midi, startSample, numSamples, heldPosition - startSample, pendingMidi);
+
+            auto& held = getHeldBuffer<SampleType>();
+            const int numChannels = juce::jmin(buffer.getNumChannels(), held.getNumChannels());
+            buffer.clear(startSample, numSamples);
+            while (numSamples > 0) {
+                if (heldPosition == quantum) {
+                    chunkMidi.clear();
+                    addMidiEvents(pendingMidi, 0, quantum, 0, chunkMidi);
+                    renderChunk(held, chunkMidi, 0, quantum);
+                    // the later events move on by one chunk
+                    spareMidi.clear();
+                    addMidiEvents(pendingMidi, quantum, std::numeric_limits<int>::max() - quantum, -quantum, 
+                        spareMidi);
+                    pendingMidi.swapWith(spareMidi);
+                    heldPosition = 0;
+                }
+
+                const int length = juce::jmin(numSamples, quantum - heldPosition);
+                for (int channel = 0; channel < numChannels; ++channel) {
+                    buffer.copyFrom(channel, startSample, held, channel, heldPosition, length);
+                }
+                heldPosition += length;
+                startSample += length;
+                numSamples -= length;
+            }
+        }
+
+        /*
+        * Takes over a new processing quantum. Events still waiting for a buffered chunk are passed on at the start of
+        * the block instead, together with the events of the block, which are returned; the held samples are dropped.
+        */
+        const juce::MidiBuffer& updateQuantum(const juce::MidiBuffer& midi, int startSample, int numSamples) {
+            const int newQuantum = pendingQuantum;
+            const bool newBuffered = newQuantum > 0 && pendingQuantumBuffered;
+            if (newQuantum == quantum && newBuffered == quantumBuffered) {
+                return midi;
+            }
+
+            const bool flush = quantumBuffered && !pendingMidi.isEmpty();
+            if (flush) {
+                spareMidi.clear();
+                for (const auto metadata : pendingMidi) {
+                    spareMidi.addEvent(metadata.data, metadata.numBytes, startSample);
+                }
+                addMidiEvents(midi, startSample, numSamples, 0, spareMidi);
+            }
+            quantum = newQuantum;
+            quantumBuffered = newBuffered;
+            resetQuantum();
+            return flush ? spareMidi : midi;
+        }
+
+        // Starts the grid of the chunks anew and fills the held chunk with silence.
+        void resetQuantum() {
+            samplesToNextQuantum = 0;
+            heldPosition = 0;
+            pendingMidi.clear();
+            heldFloat.clear();
+            heldDouble.clear();
+        }
+
+        template <typename SampleType>
+        juce::AudioBuffer<SampleType>& getHeldBuffer() {
+            if constexpr (std::is_same_v<SampleType, double>) {
+                return heldDouble;
+            }
+            else {
+                return heldFloat;
+            }
+        }
+
+        // Adds the events within the given range of the source to the target, moved by the given number of samples.
+        static void addMidiEvents(const juce::MidiBuffer& source, int startSample, int numSamples, int delta, 
+            juce::MidiBuffer& target) {
+            for (auto it = source.findNextSamplePosition(startSample); it != source.cend(); ++it) {
+                const auto metadata = *it;
+                if (metadata.samplePosition - startSample >= numSamples) {
+                    break;
+                }
+                target.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition + delta);
+            }
+        }
+
+        // Takes over new settings of the modulation, unless they are being written right now.
+        void updateModulation() {
+            {
+                const juce::SpinLock::ScopedTryLockType lock(modulationLock);
+                if (!lock.isLocked() || !modulationChanged) {
+                    return;
+                }
+                modulationMatrix.setSettings(pendingModulation);
+                modulationChanged = false;
+            }
+
+            updateModulationEnvelopes();
+            samplesToNextTick = juce::jmin(samplesToNextTick, modulationMatrix.getControlInterval());
+            if (!modulationMatrix.getSettings().isActive()) {
+                for (auto voice : voices) {
+                    voice->clearModulation();
+                }
+            }
+        }
+
+        void updateModulationEnvelopes() {
+            for (auto voice : voices) {
+                voice->setModulationEnvelopes(modulationMatrix.getSettings().envelopes, 
+                    modulationMatrix.getControlRate());
+            }
+        }
+
+        /*
+        * Renders the block in sub-blocks between the ticks of the control rate. The ticks lie on a fixed grid across
+        * blocks, so that the modulation does not depend on the block size. Each sub-block gets only its own MIDI 
+        * events, as juce::Synthesiser handles the first event after a block within that block.
+        */
+        template <typename SampleType>
+        void renderModulated(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midi, int startSample, 
+            int numSamples) {
+            const int endSample = startSample + numSamples;
+            while (startSample < endSample) {
+                if (samplesToNextTick == 0) {
+                    TelemetryRecorder::ScopedStage stage(&telemetry, stageModulation);
+                    const int interval = modulationMatrix.getControlInterval();
+                    modulationMatrix.tick();
+                    for (auto voice : voices) {
+                        if (voice->isVoiceActive()) {
+                            voice->tickModulation(modulationMatrix, interval);
+                        }
+                    }
+                    samplesToNextTick = interval;
+                }
+
+                const int length = juce::jmin(endSample - startSample, samplesToNextTick);
+                subBlockMidi.clear();
+                addMidiEvents(midi, startSample, length, 0, subBlockMidi);
+                synth.renderNextBlock(buffer, subBlockMidi, startSample, length);
+
+                startSample += length;
+                samplesToNextTick -= length;
+            }
+        }
+
+        // Requests a new waveform if the gains have changed, takes a finished one and passes the waveforms to the voices.
+        void updateBakedWaveform(int startSample, int numSamples) {
+            // the current waveform is kept while disabled, it is still valid when enabling again with the same gains
+            if (!bakedWaveformEnabled || wavetable != nullptr) {
+                for (auto voice : voices) {
+                    voice->setBakedWaveform(nullptr);
+                }
+                return;
+            }
+
+            const auto harmProcessor = voices.front()->getHarmProcessor();
+            for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+                bakedGains[i] = harmProcessor->getHarmGain(i);
+            }
+            baker->request(bakedGains);
+
+            // a newer waveform waits until the fade into the current one is done
+            if (fadingWaveform == nullptr) {
+                if (auto newWaveform = baker->take()) {
+                    fadingWaveform = bakedWaveform;
+                    bakedWaveform = newWaveform;
+                    bakedFadePosition = 0;
+                }
+            }
+            for (auto voice : voices) {
+                voice->setBakedWaveform(bakedWaveform, fadingWaveform, startSample, bakedFadePosition, 
+                    bakedFadeLength);
+            }
+        }
+
+        TelemetryRecorder telemetry;
+        AddSynthesiser synth;
+        // the voices of the synth, owned by it
+        std::vector<AddSynthVoice*> voices;
+        // the working buffers of the voices
+        Arena voiceArena;
+        const juce::MidiBuffer* incomingMidiBuffer{ nullptr };
+        const juce::MidiBuffer noMidi{};
+
+        std::shared_ptr<const Wavetable> wavetable;
+        std::atomic<float> wavetableMorph{ 0.f };
+
+        std::unique_ptr<WaveformBaker> baker;
+        // the sounds replaced by setSound which are still held elsewhere
+        std::vector<std::shared_ptr<const SoundTable>> retiredSounds;
+        std::atomic<bool> bakedWaveformEnabled{ false };
+        // the waveform the voices play, and the one they fade out of, with the samples of the fade passed so far and 
+        // its length
+        const BakedWaveform* bakedWaveform{ nullptr };
+        const BakedWaveform* fadingWaveform{ nullptr };
+        int bakedFadePosition{ 0 };
+        int bakedFadeLength{ 1 };
+        std::array<float, NO_ADDSYNTH_VOICES> bakedGains{};
+
+        // the settings of the modulation as last set, and the matrix of the audio thread, which takes them over
+        mutable juce::SpinLock modulationLock;
+        ModulationSettings pendingModulation;
+        bool modulationChanged{ false };
+        ModulationMatrix modulationMatrix;
+        // the samples to the next tick of the control rate, counted across blocks
+        int samplesToNextTick{ 0 };
+        juce::MidiBuffer subBlockMidi;
+
+        // the processing quantum as last set, and as taken over by the audio thread; 0 if off
+        std::atomic<int> pendingQuantum{ 0 };
+        std::atomic<bool> pendingQuantumBuffered{ false };
+        int quantum{ 0 };
+        bool quantumBuffered{ false };
+        // the samples to the next line of the grid of chunks, counted across blocks
+        int samplesToNextQuantum{ 0 };
+        // the events of the current chunk, the events waiting for the next buffered chunks, and space for moving them
+        juce::MidiBuffer chunkMidi;
+        juce::MidiBuffer pendingMidi;
+        juce::MidiBuffer spareMidi;
+        // the chunk rendered ahead with buffering, and the position up to which it has been played
+        juce::AudioBuffer<float> heldFloat;
+        juce::AudioBuffer<double> heldDouble;
+        int heldPosition{ 0 };
+
+        // rendering ahead as last set, with the lanes in the pool, and as taken over by the audio thread; the lock 
+        // guards the lanes and the queue against setRenderAhead and prepareToPlay running at the same time
+        juce::CriticalSection renderAheadLock;
+        std::atomic<bool> renderAheadRequested{ false };
+        bool renderAhead{ false };
+        double renderAheadSampleRate{ 44100. };
+        // the lanes of the voices in the worker pool of the process, declared last, so that it stops before the 
+        // voices go
+        RenderAheadQueue renderAheadQueue;
 };
 
 //===================================================================================
@@ -0,0 +1,180 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "BakedWaveform.h"
+#include <cmath>
+
+namespace cw::synth {
+
+BakedWaveform::BakedWaveform() : tables((size_t)numLevels * (tableSize + 1)) {}
+
+void BakedWaveform::bake(const SoundTable& sound, const std::array<float, NO_ADDSYNTH_VOICES>& gains) {
+    spectrum.resize(2 * tableSize);
+    levelSpectrum.resize(2 * tableSize);
+
+    // the full waveform: harmonic h plays the sound (h + 1) times per period, with linear interpolation
+    const auto* source = sound.data();
+    const auto sourceSize = sound.size();
+    std::fill(spectrum.begin(), spectrum.end(), 0.f);
+    for (int i = 0; i < tableSize; ++i) {
+        double value = 0.;
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            if (gains[harm] == 0.f) {
+                continue;
+            }
+            const auto pos = std::fmod((double)(harm + 1) * i * sourceSize / tableSize, (double)sourceSize);
+            const auto pos0 = (size_t)pos % sourceSize;
+            const auto pos1 = (pos0 + 1) % sourceSize;
+            const auto frac = pos - std::floor(pos);
+            value += (source[pos0] + frac * (source[pos1] - source[pos0])) * gains[harm];
+        }
+        spectrum[i] = (float)(value / NO_ADDSYNTH_VOICES);
+    }
+    fft.performRealOnlyForwardTransform(spectrum.data(), true);
+
+    // each level keeps the bins up to its limit, as complex pairs; the inverse transform mirrors them itself
+    for (int level = 0; level < numLevels; ++level) {
+        const int maxBin = (tableSize / 2) >> level;
+        std::fill(levelSpectrum.begin(), levelSpectrum.end(), 0.f);
+        std::copy(spectrum.begin(), spectrum.begin() + 2 * (maxBin + 1), levelSpectrum.begin());
+        fft.performRealOnlyInverseTransform(levelSpectrum.data());
+
+        auto* table = tables.data() + (size_t)level * (tableSize + 1);
+        std::copy(levelSpectrum.begin(), levelSpectrum.begin() + tableSize, table);
+        table[tableSize] = table[0];
+    }
+}
+
+int BakedWaveform::getLevelForFrequency(double frequency, double sampleRate) {
+    // the highest harmonic below the Nyquist frequency
+    const auto maxHarmonic = frequency > 0. ? 0.5 * sampleRate / frequency : (double)tableSize;
+    int level = 0;
+    while (level < numLevels - 1 && ((tableSize / 2) >> level) > maxHarmonic) {
+        ++level;
+    }
+    return level;
+}
+
+//===================================================================================
+
+WaveformBaker::WaveformBaker(std::shared_ptr<const SoundTable> sound) : juce::Thread("Waveform Baker"),
+    sound(std::move(sound)) {
+    for (auto& state : slotStates) {
+        state = slotFree;
+    }
+    for (auto& gain : requestedGains) {
+        gain = 0.f;
+    }
+    // nothing has been requested yet, so the first request always differs
+    lastRequestedGains.fill(-1.f);
+}
+
+WaveformBaker::~WaveformBaker() {
+    stop();
+}
+
+void WaveformBaker::start() {
+    if (!isThreadRunning()) {
+        startThread();
+    }
+}
+
+void WaveformBaker::stop() {
+    stopThread(1000);
+}
+
+void WaveformBaker::setSound(std::shared_ptr<const SoundTable> newSound) {
+    const bool wasRunning = isThreadRunning();
+    stop();
+
+    sound = std::move(newSound);
+    for (auto& state : slotStates) {
+        state = slotFree;
+    }
+    pendingSlot = -1;
+    // the next request bakes again, even for the same gains
+    lastRequestedGains.fill(-1.f);
+
+    if (wasRunning) {
+        start();
+    }
+}
+
+void WaveformBaker::request(const std::array<float, NO_ADDSYNTH_VOICES>& gains) {
+    if (gains == lastRequestedGains) {
+        return;
+    }
+    lastRequestedGains = gains;
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        requestedGains[i].store(gains[i], std::memory_order_relaxed);
+    }
+    requestedVersion.fetch_add(1, std::memory_order_release);
+}
+
+const BakedWaveform* WaveformBaker::take() {
+    const int slot = pendingSlot.exchange(-1, std::memory_order_acq_rel);
+    if (slot < 0) {
+        return nullptr;
+    }
+    slotStates[slot] = slotTaken;
+    takenVersion = slotVersions[slot];
+    return &slots[slot];
+}
+
+void WaveformBaker::release(const BakedWaveform* waveform) {
+    if (waveform != nullptr) {
+        slotStates[waveform - slots.data()].store(slotFree, std::memory_order_release);
+    }
+}
+
+int WaveformBaker::findFreeSlot() {
+    for (int slot = 0; slot < numSlots; ++slot) {
+        int expected = slotFree;
+        if (slotStates[slot].compare_exchange_strong(expected, slotBaking)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void WaveformBaker::run() {
+    std::array<float, NO_ADDSYNTH_VOICES> gains;
+    while (!threadShouldExit()) {
+        const auto version = requestedVersion.load(std::memory_order_acquire);
+        const int slot = version != bakedVersion ? findFreeSlot() : -1;
+        if (slot < 0) {
+            wait(pollIntervalMs);
+            continue;
+        }
+
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            gains[i] = requestedGains[i].load(std::memory_order_relaxed);
+        }
+        slots[slot].bake(*sound, gains);
+        slotVersions[slot] = version;
+        bakedVersion = version;
+
+        // a finished waveform which the audio thread has not taken yet is superseded by this one
+        const int superseded = pendingSlot.exchange(slot, std::memory_order_acq_rel);
+        if (superseded >= 0) {
+            slotStates[superseded].store(slotFree, std::memory_order_release);
+        }
+    }
+}
+
+} // namespace cw::synth
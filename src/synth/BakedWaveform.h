@@ -0,0 +1,119 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "../util/SoundProcessor.h"
+
+namespace cw::synth {
+
+/**
+ * One period of the weighted sum of all harmonics, as HarmonicSoundProcessor would play it, baked into a table. Since
+ * all partials are integer multiples of the fundamental, the sum is periodic, and playing the table costs one lookup
+ * per sample instead of one per partial. The table is stored in band-limited versions, one per octave: level k 
+ * contains the harmonics up to tableSize / 2^(k+1) only, so that notes can be played without aliasing.
+ */
+class BakedWaveform {
+    public:
+        static constexpr int tableOrder = 11;
+        static constexpr int tableSize = 1 << tableOrder;
+        static constexpr int numLevels = tableOrder;
+
+        BakedWaveform();
+
+        /*
+        * Bakes the harmonics of the sound with the given gains, each of the NO_ADDSYNTH_VOICES harmonics playing the
+        * sound at a multiple of the speed. Allocates nothing after the first call, but takes a while; not for the 
+        * audio thread.
+        */
+        void bake(const SoundTable& sound, const std::array<float, NO_ADDSYNTH_VOICES>& gains);
+
+        // The table of the given level, with tableSize + 1 samples: the last sample repeats the first one.
+        const float* getLevel(int level) const { return tables.data() + (size_t)level * (tableSize + 1); }
+
+        // The level without aliasing for the given fundamental frequency.
+        static int getLevelForFrequency(double frequency, double sampleRate);
+
+    private:
+        std::vector<float> tables;
+        std::vector<float> spectrum;
+        std::vector<float> levelSpectrum;
+        juce::dsp::FFT fft{ tableOrder };
+};
+
+/**
+ * Bakes waveforms on a background thread and hands them to the audio thread. The audio thread requests a waveform for
+ * a set of gains and later takes the finished waveform; both are wait-free. Waveforms live in a fixed number of slots,
+ * which the audio thread releases when it has faded out of them, so nothing is allocated or freed on the audio thread.
+ */
+class WaveformBaker : private juce::Thread {
+    public:
+        WaveformBaker(std::shared_ptr<const SoundTable> sound);
+        ~WaveformBaker() override;
+
+        void start();
+        void stop();
+
+        /*
+        * Bakes from the given sound from now on. All waveforms are given up; the caller must not play any waveform it
+        * has taken before. Not real-time safe.
+        */
+        void setSound(std::shared_ptr<const SoundTable> newSound);
+
+        // Requests a waveform for the gains, if they differ from the last requested ones. For the audio thread.
+        void request(const std::array<float, NO_ADDSYNTH_VOICES>& gains);
+        // Returns the latest finished waveform which has not been taken yet, or null. For the audio thread.
+        const BakedWaveform* take();
+        // Gives a taken waveform back, once it is not played any more. For the audio thread.
+        void release(const BakedWaveform* waveform);
+        // Whether the last taken waveform was baked for the last requested gains. For the audio thread.
+        bool isUpToDate() const { return takenVersion == requestedVersion.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr int numSlots = 4;
+        static constexpr int pollIntervalMs = 5;
+
+        enum SlotState {
+            slotFree,
+            slotBaking,
+            slotTaken
+        };
+
+        std::shared_ptr<const SoundTable> sound;
+        std::array<BakedWaveform, numSlots> slots;
+        std::array<std::atomic<int>, numSlots> slotStates;
+        // the request each slot was baked for
+        std::array<juce::uint32, numSlots> slotVersions{};
+        // the slot of the finished waveform which has not been taken yet, or -1
+        std::atomic<int> pendingSlot{ -1 };
+
+        std::array<std::atomic<float>, NO_ADDSYNTH_VOICES> requestedGains;
+        std::array<float, NO_ADDSYNTH_VOICES> lastRequestedGains;
+        std::atomic<juce::uint32> requestedVersion{ 0 };
+        juce::uint32 bakedVersion{ 0 };
+        juce::uint32 takenVersion{ 0 };
+
+        void run() override;
+        int findFreeSlot();
+};
+
+} // namespace cw::synth
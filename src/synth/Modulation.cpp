@@ -0,0 +1,146 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "Modulation.h"
+
+namespace cw::synth {
+
+bool ModulationSettings::addRoute(const ModulationRoute& route) {
+    if (numRoutes >= maxRoutes) {
+        return false;
+    }
+    routes[numRoutes++] = route;
+    return true;
+}
+
+void ModulationSettings::validate() {
+    numRoutes = juce::jlimit(0, maxRoutes, numRoutes);
+    controlInterval = juce::jlimit(minControlInterval, maxControlInterval, controlInterval);
+    for (auto& route : routes) {
+        const int numSources = route.source == ModulationSource::lfo ? maxLfos : maxEnvelopes;
+        route.sourceIndex = juce::jlimit(0, numSources - 1, route.sourceIndex);
+        route.harmonic = juce::jlimit(0, NO_ADDSYNTH_VOICES - 1, route.harmonic);
+    }
+    for (auto& lfo : lfos) {
+        lfo.rate = juce::jmax(0.f, lfo.rate);
+    }
+    for (auto& envelope : envelopes) {
+        envelope.attack = juce::jmax(0.f, envelope.attack);
+        envelope.decay = juce::jmax(0.f, envelope.decay);
+        envelope.sustain = juce::jlimit(0.f, 1.f, envelope.sustain);
+        envelope.release = juce::jmax(0.f, envelope.release);
+    }
+}
+
+//===================================================================================
+
+float Lfo::getValue() const {
+    const auto p = (float)phase;
+    switch (settings.shape) {
+        case LfoShape::triangle:
+            // rising from 0, like the sine
+            return p < 0.25f ? 4.f * p : (p < 0.75f ? 2.f - 4.f * p : 4.f * p - 4.f);
+        case LfoShape::saw:
+            return 2.f * p - 1.f;
+        case LfoShape::square:
+            return p < 0.5f ? 1.f : -1.f;
+        default:
+            return std::sin(juce::MathConstants<float>::twoPi * p);
+    }
+}
+
+//===================================================================================
+
+void ModulationEnvelopes::setParameters(
+    const std::array<ModulationEnvelopeSettings, ModulationSettings::maxEnvelopes>& settings, double controlRate) {
+    for (size_t i = 0; i < envelopes.size(); ++i) {
+        envelopes[i].setSampleRate(controlRate);
+        envelopes[i].setParameters(juce::ADSR::Parameters(settings[i].attack, settings[i].decay, settings[i].sustain,
+            settings[i].release));
+    }
+}
+
+void ModulationEnvelopes::noteOn() {
+    for (auto& envelope : envelopes) {
+        envelope.noteOn();
+    }
+}
+
+void ModulationEnvelopes::noteOff() {
+    for (auto& envelope : envelopes) {
+        envelope.noteOff();
+    }
+}
+
+void ModulationEnvelopes::reset() {
+    for (auto& envelope : envelopes) {
+        envelope.reset();
+    }
+    values.fill(0.f);
+}
+
+const ModulationEnvelopes::Values& ModulationEnvelopes::tick() {
+    for (size_t i = 0; i < envelopes.size(); ++i) {
+        values[i] = envelopes[i].getNextSample();
+    }
+    return values;
+}
+
+//===================================================================================
+
+void ModulationMatrix::setSettings(const ModulationSettings& newSettings) {
+    const auto previous = settings;
+    settings = newSettings;
+    settings.validate();
+    for (int i = 0; i < ModulationSettings::maxLfos; ++i) {
+        lfos[i].setSettings(settings.lfos[i]);
+        if (settings.lfos[i].phase != previous.lfos[i].phase) {
+            lfos[i].reset();
+        }
+    }
+}
+
+void ModulationMatrix::reset() {
+    for (auto& lfo : lfos) {
+        lfo.reset();
+    }
+}
+
+void ModulationMatrix::tick() {
+    for (int i = 0; i < ModulationSettings::maxLfos; ++i) {
+        lfoValues[i] = lfos[i].getValue();
+        lfos[i].advance(settings.controlInterval, sampleRate);
+    }
+}
+
+void ModulationMatrix::evaluate(const ModulationEnvelopes::Values& envelopeValues, ModulationOffsets& offsets) const {
+    offsets = ModulationOffsets{};
+    for (int i = 0; i < settings.numRoutes; ++i) {
+        const auto& route = settings.routes[i];
+        const auto value = route.source == ModulationSource::lfo ? lfoValues[route.sourceIndex] 
+            : envelopeValues[route.sourceIndex];
+        const auto amount = value * route.depth;
+        switch (route.target) {
+            case ModulationTarget::phi: offsets.phi += amount; break;
+            case ModulationTarget::theta: offsets.theta += amount; break;
+            case ModulationTarget::harmonicGain: offsets.harmonicGains[route.harmonic] += amount; break;
+        }
+    }
+}
+
+} // namespace cw::synth
@@ -0,0 +1,177 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "../util/SoundProcessor.h"
+
+namespace cw::synth {
+
+enum class LfoShape {
+    sine,
+    triangle,
+    saw,
+    square
+};
+
+struct LfoSettings {
+    LfoShape shape{ LfoShape::sine };
+    float rate{ 1.f }; // in Hz
+    float phase{ 0.f }; // the phase at the start, in periods
+};
+
+// An ADSR envelope of the modulation, which starts with each note; the times are in seconds.
+struct ModulationEnvelopeSettings {
+    float attack{ 0.1f };
+    float decay{ 0.2f };
+    float sustain{ 0.5f };
+    float release{ 0.2f };
+};
+
+enum class ModulationSource {
+    lfo,
+    envelope
+};
+
+enum class ModulationTarget {
+    phi,
+    theta,
+    harmonicGain
+};
+
+/**
+ * A route of the modulation matrix: the value of the source, within [-1, 1] for LFOs and [0, 1] for envelopes, times 
+ * the depth is added to the target. The depth is in radians for the angles.
+ */
+struct ModulationRoute {
+    ModulationSource source{ ModulationSource::lfo };
+    int sourceIndex{ 0 };
+    ModulationTarget target{ ModulationTarget::phi };
+    // the harmonic of a harmonicGain target
+    int harmonic{ 0 };
+    float depth{ 0.f };
+};
+
+/**
+ * The LFOs, envelopes and routes of the modulation. The routes are evaluated once per control interval, and the 
+ * targets glide linearly from one value to the next in between, which keeps the cost of many routes small. The sizes
+ * are fixed, so that the settings can be copied on the audio thread.
+ */
+struct ModulationSettings {
+    static constexpr int maxLfos = 8;
+    static constexpr int maxEnvelopes = 2;
+    static constexpr int maxRoutes = 32;
+    // the control interval in samples
+    static constexpr int minControlInterval = 16;
+    static constexpr int maxControlInterval = 64;
+    static constexpr int defaultControlInterval = 32;
+
+    std::array<LfoSettings, maxLfos> lfos{};
+    std::array<ModulationEnvelopeSettings, maxEnvelopes> envelopes{};
+    std::array<ModulationRoute, maxRoutes> routes{};
+    int numRoutes{ 0 };
+    int controlInterval{ defaultControlInterval };
+
+    // Without routes, the synth renders as without modulation.
+    bool isActive() const { return numRoutes > 0; }
+    // Appends a route. Returns false if all routes are in use.
+    bool addRoute(const ModulationRoute& route);
+    // Brings all values into their ranges, e.g. after loading.
+    void validate();
+};
+
+// The sums of the routes of each target, added to the values of the parameters.
+struct ModulationOffsets {
+    float phi{ 0.f };
+    float theta{ 0.f };
+    std::array<float, NO_ADDSYNTH_VOICES> harmonicGains{};
+};
+
+//===================================================================================
+
+class Lfo {
+    public:
+        void setSettings(const LfoSettings& newSettings) { settings = newSettings; }
+        // Goes back to the phase at the start.
+        void reset() { phase = settings.phase - std::floor(settings.phase); }
+        // The value at the current phase, within [-1, 1].
+        float getValue() const;
+        void advance(int numSamples, double sampleRate) {
+            phase += settings.rate * numSamples / sampleRate;
+            phase -= std::floor(phase);
+        }
+
+    private:
+        LfoSettings settings;
+        double phase{ 0. }; // in periods
+};
+
+/**
+ * The envelopes of the modulation for one voice, advanced once per control interval. The envelopes of the voices 
+ * start and stop with their notes, while the LFOs are shared by all voices.
+ */
+class ModulationEnvelopes {
+    public:
+        using Values = std::array<float, ModulationSettings::maxEnvelopes>;
+
+        // Sets the envelopes, for the rate at which tick is called.
+        void setParameters(const std::array<ModulationEnvelopeSettings, ModulationSettings::maxEnvelopes>& settings,
+            double controlRate);
+        void noteOn();
+        void noteOff();
+        void reset();
+        // Advances the envelopes by one control interval and returns their values.
+        const Values& tick();
+
+    private:
+        std::array<juce::ADSR, ModulationSettings::maxEnvelopes> envelopes;
+        Values values{};
+};
+
+/**
+ * Evaluates the routes of the modulation for the voices. The audio thread calls tick once per control interval, and
+ * then evaluate for each voice.
+ */
+class ModulationMatrix {
+    public:
+        // Takes over the settings. The LFOs keep their phases, so that a change of a route does not make them jump.
+        void setSettings(const ModulationSettings& newSettings);
+        const ModulationSettings& getSettings() const { return settings; }
+
+        void setSampleRate(double newSampleRate) { sampleRate = newSampleRate; }
+        // The rate of the ticks, at which the envelopes of the voices are advanced.
+        double getControlRate() const { return sampleRate / settings.controlInterval; }
+        int getControlInterval() const { return settings.controlInterval; }
+
+        // Restarts the LFOs.
+        void reset();
+        // Takes the values of the LFOs for the current control interval, and advances them to the next one.
+        void tick();
+        // Sums up the routes, with the current values of the LFOs and the given values of the envelopes of a voice.
+        void evaluate(const ModulationEnvelopes::Values& envelopeValues, ModulationOffsets& offsets) const;
+
+    private:
+        ModulationSettings settings;
+        std::array<Lfo, ModulationSettings::maxLfos> lfos;
+        std::array<float, ModulationSettings::maxLfos> lfoValues{};
+        double sampleRate{ 44100. };
+};
+
+} // namespace cw::synth
@@ -0,0 +1,102 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "PresetLoader.h"
+
+namespace cw::synth {
+
+PresetLoader::PresetLoader() : juce::Thread("Preset Loader"), fifo(fifoSize) {
+    startThread();
+}
+
+PresetLoader::~PresetLoader() {
+    stopThread(1000);
+}
+
+void PresetLoader::loadState(const void* data, int sizeInBytes) {
+    {
+        const juce::ScopedLock sl(lock);
+        latestState.replaceAll(data, (size_t)sizeInBytes);
+        ++latestId;
+    }
+    notify();
+}
+
+bool PresetLoader::fetchPreset(SynthPreset& preset) {
+    const int numReady = fifo.getNumReady();
+    if (numReady == 0) {
+        return false;
+    }
+    // only the newest of the ready presets matters
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+    const auto& newest = size2 > 0 ? decoded[(size_t)(start2 + size2 - 1)] : decoded[(size_t)(start1 + size1 - 1)];
+    preset = newest.preset;
+    fetchedId = newest.id;
+    fifo.finishedRead(size1 + size2);
+    return true;
+}
+
+void PresetLoader::markApplied() {
+    appliedId = fetchedId;
+}
+
+bool PresetLoader::getPendingPreset(SynthPreset& preset) const {
+    const juce::ScopedLock sl(lock);
+    if (appliedId.load() == latestId) {
+        return false;
+    }
+    preset = {};
+    return preset.readBinary(latestState.getData(), latestState.getSize());
+}
+
+void PresetLoader::run() {
+    juce::MemoryBlock state;
+    while (!threadShouldExit()) {
+        juce::uint32 id;
+        {
+            const juce::ScopedLock sl(lock);
+            id = latestId;
+            if (id != decodedId) {
+                state = latestState;
+            }
+        }
+        if (id == decodedId) {
+            wait(-1);
+            continue;
+        }
+
+        // states which can't be decoded are dropped, the synth keeps its current sound
+        SynthPreset preset;
+        if (preset.readBinary(state.getData(), state.getSize())) {
+            // the audio thread only empties the FIFO while processing, so it may stay full while playback is stopped
+            while (fifo.getFreeSpace() == 0 && !threadShouldExit()) {
+                wait(10);
+            }
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite(1, start1, size1, start2, size2);
+            if (size1 > 0) {
+                decoded[(size_t)start1] = { preset, id };
+            }
+            fifo.finishedWrite(size1);
+        }
+        decodedId = id;
+    }
+}
+
+} // namespace cw::synth
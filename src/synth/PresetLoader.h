@@ -0,0 +1,75 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include "SynthPreset.h"
+
+namespace cw::synth {
+
+/**
+ * Loads presets for a running synth without stalling the audio thread. A state is decoded, and anything derived from
+ * it is built, on a background thread; the result is handed to the audio thread through a wait-free FIFO and picked
+ * up at the start of a block. If several states are loaded in quick succession, only the latest one is decoded.
+ */
+class PresetLoader : private juce::Thread {
+    public:
+        PresetLoader();
+        ~PresetLoader() override;
+
+        // Queues a state in the binary preset format for decoding. The data is copied. Not for the audio thread.
+        void loadState(const void* data, int sizeInBytes);
+
+        /*
+        * Copies the newest decoded preset, if there is one which has not been fetched yet, and returns true. Wait-free
+        * and without allocation, for the audio thread.
+        */
+        bool fetchPreset(SynthPreset& preset);
+        // Marks the preset fetched last as applied to the synth. For the audio thread.
+        void markApplied();
+
+        // Returns true together with the latest loaded preset, if the audio thread has not applied it yet.
+        bool getPendingPreset(SynthPreset& preset) const;
+
+    private:
+        struct DecodedPreset {
+            SynthPreset preset;
+            juce::uint32 id;
+        };
+
+        static constexpr int fifoSize = 8;
+
+        mutable juce::CriticalSection lock;
+        // the latest loaded state and its ID, counting up with each call of loadState
+        juce::MemoryBlock latestState;
+        juce::uint32 latestId{ 0 };
+        juce::uint32 decodedId{ 0 };
+        // the preset fetched last by the audio thread, and the one it has applied
+        juce::uint32 fetchedId{ 0 };
+        std::atomic<juce::uint32> appliedId{ 0 };
+
+        juce::AbstractFifo fifo;
+        std::array<DecodedPreset, fifoSize> decoded;
+
+        void run() override;
+};
+
+} // namespace cw::synth
@@ -20,105 +20,139 @@
 
 namespace cw::synth {
 
-Spin3Rotation::Spin3Rotation() {
+template <typename SampleType>
+BasicSpin3Rotation<SampleType>::BasicSpin3Rotation() {
 	clearBuffer();
 }
 
-cVector Spin3Rotation::matMult(const cMatrix& matrix, const cVector& inVec, float factor = 1) {
-	int dimension = inVec.size();
-	cVector result;
-	result.reserve(dimension);
-	for (int row = 0; row < dimension; ++row) {
-		result.push_back(0);
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::updateMatrix() {
+	// angles which are set directly end a glide
+	glideChunks = 0;
+	if (mode == RotationMode::unitary) {
+		updateRotationMatrix();
+		return;
 	}
-	for (int row = 0; row < dimension; ++row) {
-		for (int col = 0; col < dimension; ++col) {
-			result[row] += matrix[row][col] * inVec[col] * factor;
+
+	const auto phiValue = (SampleType)phi;
+	const auto thetaValue = (SampleType)theta;
+	const SampleType factorX = std::cos(phiValue) * std::sin(thetaValue);
+	const SampleType factorY = std::sin(phiValue) * std::sin(thetaValue);
+	const SampleType factorZ = std::cos(thetaValue);
+
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			matrix[row][col] = Complex(spins.S_x[row][col]) * factorX + Complex(spins.S_y[row][col]) * factorY 
+				+ Complex(spins.S_z[row][col]) * factorZ;
 		}
 	}
-
-	return result;
+	matrixNeedsUpdate = false;
 }
 
-cVector Spin3Rotation::cVecAdd(const cVector& v0, const cVector& v1) {
-	cVector result;
-	result.reserve(v0.size());
-	auto it0 = v0.begin();
-	auto it1 = v1.begin();
-	while (it0 != v0.end()) {
-		result.push_back(*it0 + *it1);
-		++it0;
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::updateRotationMatrix() {
+	/*
+	* The Wigner-D matrix D(phi, theta, 0) = exp(-i phi J_z) exp(-i theta J_y) of spin 3/2, with J = S / 2, in closed 
+	* form: the rows and columns belong to m = 3/2, 1/2, -1/2, -3/2, like the diagonal of S_z, and the element (m', m)
+	* is exp(-i m' phi) d_m'm(theta), with the small Wigner-d matrix d below.
+	*/
+	const SampleType one{ 1 }, two{ 2 }, three{ 3 };
+	const SampleType c = std::cos(SampleType(0.5) * theta);
+	const SampleType s = std::sin(SampleType(0.5) * theta);
+	const SampleType sqrt3 = std::sqrt(three);
+
+	const SampleType d[4][4] = {
+		{ c * c * c, -sqrt3 * c * c * s, sqrt3 * c * s * s, -s * s * s },
+		{ sqrt3 * c * c * s, c * (three * c * c - two), -s * (three * c * c - one), sqrt3 * c * s * s },
+		{ sqrt3 * c * s * s, s * (three * c * c - one), c * (three * c * c - two), -sqrt3 * c * c * s },
+		{ s * s * s, sqrt3 * c * s * s, sqrt3 * c * c * s, c * c * c }
+	};
+
+	for (int row = 0; row < 4; ++row) {
+		const SampleType m = SampleType(1.5) - row;
+		const auto phase = std::polar(one, -m * (SampleType)phi);
+		for (int col = 0; col < 4; ++col) {
+			matrix[row][col] = phase * d[row][col];
+		}
 	}
-	return result;
+	matrixNeedsUpdate = false;
 }
 
-std::array<std::vector<float>, 2> Spin3Rotation::spinRotate(const std::array<std::vector<float>, 2>& inVec) {
-	
-	int inVecSize = inVec[0].size();
-	int bufSize = buffer.size();
-	int remain = (inVecSize + bufSize) % 4;
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::spinRotate(const SampleType* inLeft, const SampleType* inRight, 
+	SampleType* outLeft, SampleType* outRight, int numSamples) {
 
-	// TODO: make it safe: Up to now, it is expected that always a vector of sufficient size comes in. The check now does
-	// not make so much sense...but it is at least safe
-	if (inVecSize < bufSize + 4) {
-		return inVec;
+	if (matrixNeedsUpdate) {
+		updateMatrix();
 	}
 
-	cVector inCVec;
-	inCVec.reserve(inVecSize + bufSize - remain);
+	for (int i = 0; i < numSamples; ++i) {
+		// Collect the input chunk. Once it is complete, transform it; the output always lags 3 samples behind, so
+		// that the first sample of a transformed chunk is output together with the last sample of its input.
+		inChunk[chunkPos] = Complex(inLeft[i], inRight[i]);
+
+		if (chunkPos == 3) {
+			if (glideChunks > 0) {
+				advanceGlide();
+			}
+			for (int row = 0; row < 4; ++row) {
+				outChunk[row] = matrix[row][0] * inChunk[0] + matrix[row][1] * inChunk[1] 
+					+ matrix[row][2] * inChunk[2] + matrix[row][3] * inChunk[3];
+			}
+		}
+		chunkPos = (chunkPos + 1) % 4;
 
-	// First, check the buffer whether it has remaining elements and pick those. 
-	while (!buffer.empty()) {
-		inCVec.push_back(buffer.front());
-		buffer.pop();
+		outLeft[i] = outChunk[chunkPos].real();
+		outRight[i] = outChunk[chunkPos].imag();
 	}
-	// Construct the input complex vector: Real and imag part from left and right channel. If the input vector together 
-	// with the previous buffer size is not a multiple of 4, push the remainder into the buffer. This is necessary, as 
-	// in the following, we will need vectors which have size 4.
-	
-	//int totSize = inCVec.size() + inVecSize;
-
-	for (int i = 0; i< inVec[0].size() - remain; ++i) {
-		inCVec.push_back(std::complex<float>(inVec[0].at(i), inVec[1].at(i)));
+	// TODO: loudness scaling of the generator mode; the unitary mode keeps the loudness
+}
+
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::glideTo(float newPhi, float newTheta, int numSamples) {
+	if (newPhi == phi && newTheta == theta && !matrixNeedsUpdate) {
+		return;
 	}
-	for (int i = inVecSize - remain; i < inVecSize; ++i) {
-		buffer.push(std::complex<float>(inVec[0].at(i), inVec[1].at(i)));
+	if (matrixNeedsUpdate) {
+		updateMatrix();
 	}
 
-	
-	// Now, do the transformation - from here, I know now that the inCVec will have a length of multiples of 4.
-	std::vector<float> resultR;
-	std::vector<float> resultL;
-	cVector chunk(4);
-	for (int i = 0; i < inCVec.size() - 3; i += 4) {
-		for (int j = 0; j < 4; ++j) {
-			chunk[j] = (inCVec.at(i + j));
+	// the glide starts from the current matrix, which may itself be on the way to the previous target
+	const auto startMatrix = matrix;
+	phi = newPhi;
+	theta = newTheta;
+	updateMatrix();
+	targetMatrix = matrix;
+	glideChunks = std::max(1, numSamples / 4);
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			matrixStep[row][col] = (targetMatrix[row][col] - startMatrix[row][col]) / (SampleType)glideChunks;
 		}
-		
-		auto outX = matMult(spins.S_x, chunk, std::cos(phi) * std::sin(theta));
-		auto outY = matMult(spins.S_y, chunk, std::sin(phi) * std::sin(theta));
-		auto outZ = matMult(spins.S_z, chunk, std::cos(theta));
-		auto outTotal = cVecAdd(outX, cVecAdd(outY, outZ));
-
-		// prepare size of inVec and then write new data to it
-		//for (int i = 0; i < remain; ++i) {
-		//	inVec[0].pop_back();
-		//}
-
-		for (int k = 0; k < 4; ++k) {
-			resultL.push_back(outTotal.at(k).real());
-			resultR.push_back(outTotal.at(k).imag());
-		} 
-	} 
-	
-	return std::array<std::vector<float>, 2>{resultL, resultR};
-	// TODO: loudness scaling
+	}
+	matrix = startMatrix;
 }
 
-void Spin3Rotation::clearBuffer() {
-	while (!buffer.empty()) {
-		buffer.pop();
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::advanceGlide() {
+	if (--glideChunks == 0) {
+		matrix = targetMatrix;
+		return;
+	}
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			matrix[row][col] += matrixStep[row][col];
+		}
 	}
 }
 
+template <typename SampleType>
+void BasicSpin3Rotation<SampleType>::clearBuffer() {
+	inChunk.fill(0);
+	outChunk.fill(0);
+	chunkPos = 0;
+}
+
+template class BasicSpin3Rotation<float>;
+template class BasicSpin3Rotation<double>;
+
 } // namespace cw::synth
\ No newline at end of file
@@ -22,7 +22,9 @@
 #include <vector>
 #include <cmath>
 #include <array>
-#include <queue>
+#include <tuple>
+#include <utility>
+#include <algorithm>
 
 namespace cw::synth {
 
@@ -58,51 +60,472 @@ struct Spin3 {
 	};
 };
 
-class Spin3Rotation {
+/**
+ * How Spin3Rotation transforms the chunks: by the combination of the spin matrices along the direction given by the
+ * angles, which is not normalized, or by the rotation of the spin-3/2 representation which turns the z axis into that
+ * direction. The rotation is unitary and so keeps the energy of the signal.
+ */
+enum class RotationMode {
+	generators,
+	unitary
+};
+
+/**
+ * The rotation of spin 3/2, for samples of the given type: each precision has its own kernel, which transforms the 
+ * samples without converting them. Spin3Rotation is the one for float samples.
+ */
+template <typename SampleType>
+class BasicSpin3Rotation {
 	public:
-		Spin3Rotation();
+		BasicSpin3Rotation();
 		// Clears the buffer - should always be called when a note stops playing. 
 		void clearBuffer();
 		/*
 		* This method will do the actual transformation of the input data. It does a complex spin rotation on the input
-		* vectors, depending on the angles theta and phi. The method expects two vectors: one for the left and one for
-		* the right channel. The left channel is treated as real, the right channel as imaginary part. For the ouput,
-		* it is vice versa: Real to left, imaginary to right. 
+		* samples, depending on the angles theta and phi. The left channel is treated as real, the right channel as 
+		* imaginary part. For the output, it is vice versa: Real to left, imaginary to right. 
+		* The rotation acts on chunks of 4 consecutive samples, so the output is delayed by 3 samples. Exactly 
+		* numSamples samples are written; the output may be the same memory as the input. 
 		*/
-		std::array<std::vector<float>, 2> spinRotate(const std::array<std::vector<float>, 2>& inVec);
+		void spinRotate(const SampleType* inLeft, const SampleType* inRight, SampleType* outLeft, SampleType* outRight, 
+			int numSamples);
 
 		/**
 		 * Sets the theta angle (in radians).
 		 * 
 		 * @param theta theta angle
 		*/
-		void setTheta(float theta) { this->theta = theta; }
-		void setPhi(float phi) { this->phi = phi; }
+		void setTheta(float theta) { 
+			if (theta != this->theta) {
+				this->theta = theta;
+				matrixNeedsUpdate = true;
+			}
+		}
+		void setPhi(float phi) { 
+			if (phi != this->phi) {
+				this->phi = phi;
+				matrixNeedsUpdate = true;
+			}
+		}
+
+		void setMode(RotationMode mode) {
+			if (mode != this->mode) {
+				this->mode = mode;
+				matrixNeedsUpdate = true;
+			}
+		}
+		RotationMode getMode() const { return mode; }
+
+		/*
+		* Moves to the given angles within the given number of samples: the matrix is interpolated linearly from chunk
+		* to chunk, instead of jumping at the next chunk as with setPhi and setTheta. Meant for modulation at control
+		* rate, where the angles change by small steps.
+		*/
+		void glideTo(float phi, float theta, int numSamples);
 
 	private:
+		using Complex = std::complex<SampleType>;
+		using Chunk = std::array<Complex, 4>;
+
 		float theta{ 0 }; // in radians
 		float phi{ 0 }; // in radians
-		Spin3 spins{};
+		RotationMode mode{ RotationMode::generators };
+		// the spin matrices are the same for every rotation, so they are shared instead of allocated per instance
+		static inline const Spin3 spins{};
 		/*
-		* The buffer within which possible unprocessed samples from the previous chunk are saved. It is a queue, so each
-		* time there are remaining samples from the last chunk to be processed, these will be the first to be picked.
+		* The combination cos(phi)sin(theta) S_x + sin(phi)sin(theta) S_y + cos(theta) S_z, or the Wigner-D matrix of
+		* the rotation, which is applied to each chunk. It is only recomputed when one of the angles or the mode has 
+		* changed.
 		*/
-		std::queue<std::complex<float>> buffer;
-		/**
-		 * Convenience method to multiply a complex matrix with a complex vector and output the result. The matrix is
-		 * expected to be square, and thus fitting the length of the vector. 
-		 * 
-		 * @param matrix the square matrix
-		 * @param inVec the input vector
-		 * @param factor a customary factor to scale the output vector
-		 */
+		std::array<Chunk, 4> matrix{};
+		bool matrixNeedsUpdate{ true };
+		// while gliding: the matrix of the target angles, the step per chunk and the number of chunks left
+		std::array<Chunk, 4> targetMatrix{};
+		std::array<Chunk, 4> matrixStep{};
+		int glideChunks{ 0 };
+		/*
+		* The samples of the current, incomplete input chunk, and the result of the last complete chunk, from which the
+		* output is taken.
+		*/
+		Chunk inChunk{};
+		Chunk outChunk{};
+		int chunkPos{ 0 };
+
+		void updateMatrix();
+		void updateRotationMatrix();
+		void advanceGlide();
+};
+
+using Spin3Rotation = BasicSpin3Rotation<float>;
+
+//===================================================================================
+
+namespace spin {
+
+	// Square root for constant expressions, by Newton's method.
+	constexpr double sqrt(double x) {
+		if (x <= 0.) {
+			return 0.;
+		}
+		double root = x > 1. ? x : 1.;
+		for (int i = 0; i < 64; ++i) {
+			root = 0.5 * (root + x / root);
+		}
+		return root;
+	}
+
+	template <int N, typename T = float>
+	using RealMatrix = std::array<std::array<T, N>, N>;
+
+	/**
+	 * The spin matrices of the N-dimensional representation, i.e. spin j = (N - 1) / 2, scaled like those of Spin3 to
+	 * twice the angular momentum: S_z = diag(2j, 2j - 2, ..., -2j). The rows and columns belong to m = j, j - 1, ..., 
+	 * -j. S_y is imaginary, so only its imaginary part is stored.
+	 */
+	template <int N, typename T = float>
+	struct SpinMatrices {
+		RealMatrix<N, T> x{};
+		RealMatrix<N, T> yImag{};
+		RealMatrix<N, T> z{};
+	};
+
+	template <int N, typename T = float>
+	constexpr SpinMatrices<N, T> makeSpinMatrices() {
+		SpinMatrices<N, T> spins{};
+		const double j = 0.5 * (N - 1);
+		for (int row = 0; row < N; ++row) {
+			const double m = j - row;
+			spins.z[row][row] = (T)(2. * m);
+			if (row + 1 < N) {
+				// <m|S_+|m-1> = 2 sqrt(j(j+1) - m(m-1)), and S_x = (S_+ + S_-) / 2, S_y = (S_+ - S_-) / 2i
+				const auto ladder = (T)sqrt(j * (j + 1.) - m * (m - 1.));
+				spins.x[row][row + 1] = ladder;
+				spins.x[row + 1][row] = ladder;
+				spins.yImag[row][row + 1] = -ladder;
+				spins.yImag[row + 1][row] = ladder;
+			}
+		}
+		return spins;
+	}
+
+	constexpr double factorial(int n) {
+		double result = 1.;
+		for (int i = 2; i <= n; ++i) {
+			result *= i;
+		}
+		return result;
+	}
+
+	/*
+	* The coefficients of Wigner's formula for the small matrix d of the representation of dimension N: with 
+	* c = cos(theta / 2) and s = sin(theta / 2), the element (row, col) is the sum over k of 
+	* coefficients[row][col][k] c^(N - 1 + row - col - 2k) s^(col - row + 2k). Terms which do not occur in the formula
+	* are zero.
+	*/
+	template <int N>
+	using WignerCoefficients = std::array<std::array<std::array<double, N>, N>, N>;
+
+	template <int N>
+	constexpr WignerCoefficients<N> makeWignerCoefficients() {
+		WignerCoefficients<N> coefficients{};
+		for (int row = 0; row < N; ++row) {
+			for (int col = 0; col < N; ++col) {
+				// with j = (N - 1) / 2, m' = j - row and m = j - col: j + m' = N - 1 - row, j - m' = row etc.
+				const double norm = sqrt(factorial(N - 1 - row) * factorial(row) * factorial(N - 1 - col) 
+					* factorial(col));
+				for (int k = 0; k < N; ++k) {
+					const int a = N - 1 - col - k, b = col - row + k, e = row - k;
+					if (a < 0 || b < 0 || e < 0) {
+						continue;
+					}
+					const double sign = b % 2 == 0 ? 1. : -1.;
+					coefficients[row][col][k] = sign * norm 
+						/ (factorial(a) * factorial(k) * factorial(b) * factorial(e));
+				}
+			}
+		}
+		return coefficients;
+	}
+
+} // namespace spin
+
+/**
+ * The spin rotation for the representation of dimension N, i.e. spin j = (N - 1) / 2, as a family of timbral variants
+ * of Spin3Rotation. The signal is transformed in chunks of N samples, so the output is delayed by N - 1 samples. The
+ * spin matrices are generated at compile time, and the kernel is unrolled for each dimension and sample type.
+ * 
+ * Unlike Spin3Rotation, the generators use the imaginary S_y, so SpinRotation<4> sounds different from Spin3Rotation
+ * in the generator mode; in the unitary mode, both are the same.
+ */
+template <int N, typename SampleType = float>
+class SpinRotation {
+	public:
+		static_assert(N >= 2, "a spin representation has at least two dimensions");
+		static constexpr int dimension = N;
+		static constexpr spin::SpinMatrices<N, SampleType> spins = spin::makeSpinMatrices<N, SampleType>();
+		static constexpr spin::WignerCoefficients<N> wigner = spin::makeWignerCoefficients<N>();
+
+		SpinRotation() {
+			clearBuffer();
+		}
+
+		void clearBuffer() {
+			inRe.fill(0.f);
+			inIm.fill(0.f);
+			outRe.fill(0.f);
+			outIm.fill(0.f);
+			chunkPos = 0;
+		}
+
+		// Same as Spin3Rotation::spinRotate, with chunks of N samples.
+		void spinRotate(const SampleType* inLeft, const SampleType* inRight, SampleType* outLeft, SampleType* outRight,
+			int numSamples) {
+			if (matrixNeedsUpdate) {
+				updateMatrix();
+			}
+
+			for (int i = 0; i < numSamples; ++i) {
+				inRe[chunkPos] = inLeft[i];
+				inIm[chunkPos] = inRight[i];
+
+				if (chunkPos == N - 1) {
+					if (glideChunks > 0) {
+						advanceGlide();
+					}
+					applyMatrix(std::make_index_sequence<N>());
+				}
+				chunkPos = chunkPos + 1 < N ? chunkPos + 1 : 0;
+
+				outLeft[i] = outRe[chunkPos];
+				outRight[i] = outIm[chunkPos];
+			}
+		}
+
+		void setTheta(float theta) {
+			if (theta != this->theta) {
+				this->theta = theta;
+				matrixNeedsUpdate = true;
+			}
+		}
+		void setPhi(float phi) {
+			if (phi != this->phi) {
+				this->phi = phi;
+				matrixNeedsUpdate = true;
+			}
+		}
+		void setMode(RotationMode mode) {
+			if (mode != this->mode) {
+				this->mode = mode;
+				matrixNeedsUpdate = true;
+			}
+		}
+
+		// Same as Spin3Rotation::glideTo, from chunk to chunk of N samples.
+		void glideTo(float newPhi, float newTheta, int numSamples) {
+			if (newPhi == phi && newTheta == theta && !matrixNeedsUpdate) {
+				return;
+			}
+			if (matrixNeedsUpdate) {
+				updateMatrix();
+			}
+
+			const auto startRe = matrixRe;
+			const auto startIm = matrixIm;
+			phi = newPhi;
+			theta = newTheta;
+			updateMatrix();
+			targetRe = matrixRe;
+			targetIm = matrixIm;
+			glideChunks = std::max(1, numSamples / N);
+			for (int row = 0; row < N; ++row) {
+				for (int col = 0; col < N; ++col) {
+					stepRe[row][col] = (targetRe[row][col] - startRe[row][col]) / (SampleType)glideChunks;
+					stepIm[row][col] = (targetIm[row][col] - startIm[row][col]) / (SampleType)glideChunks;
+				}
+			}
+			matrixRe = startRe;
+			matrixIm = startIm;
+		}
+
+	private:
+		float theta{ 0 }; // in radians
+		float phi{ 0 }; // in radians
+		RotationMode mode{ RotationMode::generators };
+		// the matrix applied to each chunk, split into real and imaginary parts
+		spin::RealMatrix<N, SampleType> matrixRe{};
+		spin::RealMatrix<N, SampleType> matrixIm{};
+		bool matrixNeedsUpdate{ true };
+		// gliding to the target matrix, as in Spin3Rotation
+		spin::RealMatrix<N, SampleType> targetRe{};
+		spin::RealMatrix<N, SampleType> targetIm{};
+		spin::RealMatrix<N, SampleType> stepRe{};
+		spin::RealMatrix<N, SampleType> stepIm{};
+		int glideChunks{ 0 };
+		// the current input chunk and the result of the last complete chunk, as in Spin3Rotation
+		std::array<SampleType, N> inRe{};
+		std::array<SampleType, N> inIm{};
+		std::array<SampleType, N> outRe{};
+		std::array<SampleType, N> outIm{};
+		int chunkPos{ 0 };
+
+		template <size_t... cols>
+		void applyRow(int row, std::index_sequence<cols...>) {
+			const auto& re = matrixRe[row];
+			const auto& im = matrixIm[row];
+			outRe[row] = ((re[cols] * inRe[cols] - im[cols] * inIm[cols]) + ...);
+			outIm[row] = ((re[cols] * inIm[cols] + im[cols] * inRe[cols]) + ...);
+		}
+
+		template <size_t... rows>
+		void applyMatrix(std::index_sequence<rows...> indices) {
+			(applyRow((int)rows, indices), ...);
+		}
+
+		void advanceGlide() {
+			if (--glideChunks == 0) {
+				matrixRe = targetRe;
+				matrixIm = targetIm;
+				return;
+			}
+			for (int row = 0; row < N; ++row) {
+				for (int col = 0; col < N; ++col) {
+					matrixRe[row][col] += stepRe[row][col];
+					matrixIm[row][col] += stepIm[row][col];
+				}
+			}
+		}
+
+		void updateMatrix() {
+			glideChunks = 0;
+			if (mode == RotationMode::unitary) {
+				updateRotationMatrix();
+			}
+			else {
+				const auto phiValue = (SampleType)phi;
+				const auto thetaValue = (SampleType)theta;
+				const SampleType factorX = std::cos(phiValue) * std::sin(thetaValue);
+				const SampleType factorY = std::sin(phiValue) * std::sin(thetaValue);
+				const SampleType factorZ = std::cos(thetaValue);
+				for (int row = 0; row < N; ++row) {
+					for (int col = 0; col < N; ++col) {
+						matrixRe[row][col] = spins.x[row][col] * factorX + spins.z[row][col] * factorZ;
+						matrixIm[row][col] = spins.yImag[row][col] * factorY;
+					}
+				}
+			}
+			matrixNeedsUpdate = false;
+		}
 
-		cVector matMult(const cMatrix& matrix, const cVector& inVec, float factor);
 		/*
-		* Convenience method to add two complex vectors.
+		* The Wigner-D matrix D(phi, theta, 0), as in Spin3Rotation: the element (m', m) is exp(-i m' phi) d_m'm(theta),
+		* with Wigner's formula for the small matrix d. The coefficients of the formula are computed at compile time, 
+		* so that an update is cheap enough for modulation at control rate.
 		*/
-		cVector cVecAdd(const cVector&, const cVector&);
+		void updateRotationMatrix() {
+			const double c = std::cos(0.5 * theta);
+			const double s = std::sin(0.5 * theta);
+			std::array<double, N> cPower{}, sPower{};
+			cPower[0] = 1.;
+			sPower[0] = 1.;
+			for (int i = 1; i < N; ++i) {
+				cPower[i] = cPower[i - 1] * c;
+				sPower[i] = sPower[i - 1] * s;
+			}
 
+			for (int row = 0; row < N; ++row) {
+				const double mRow = 0.5 * (N - 1) - row;
+				const double phaseRe = std::cos(mRow * phi);
+				const double phaseIm = -std::sin(mRow * phi);
+				for (int col = 0; col < N; ++col) {
+					double d = 0.;
+					const int kEnd = std::min(N - 1 - col, row);
+					for (int k = std::max(0, row - col); k <= kEnd; ++k) {
+						d += wigner[row][col][k] * cPower[N - 1 + row - col - 2 * k] * sPower[col - row + 2 * k];
+					}
+					matrixRe[row][col] = (SampleType)(phaseRe * d);
+					matrixIm[row][col] = (SampleType)(phaseIm * d);
+				}
+			}
+		}
 };
 
+/**
+ * Selects one of the spin rotations at runtime: the classic Spin3Rotation or a SpinRotation of dimension 2 to 
+ * maxDimension. All of them are members, so that switching allocates nothing; only the selected one runs. 
+ * SelectableSpinRotation is the one for float samples.
+ */
+template <typename SampleType>
+class BasicSelectableSpinRotation {
+	public:
+		// the classic Spin3Rotation, as opposed to the dimensions of SpinRotation
+		static constexpr int classic = 0;
+		static constexpr int minDimension = 2;
+		static constexpr int maxDimension = 8;
+
+		// Selects the classic rotation or a dimension; values out of range select the classic rotation.
+		void setDimension(int newDimension) {
+			if (newDimension < minDimension || newDimension > maxDimension) {
+				newDimension = classic;
+			}
+			if (newDimension != dimension) {
+				dimension = newDimension;
+				clearBuffer();
+			}
+		}
+		int getDimension() const { return dimension; }
+
+		void clearBuffer() {
+			forEach([](auto& rotation) { rotation.clearBuffer(); });
+		}
+		void spinRotate(const SampleType* inLeft, const SampleType* inRight, SampleType* outLeft, SampleType* outRight,
+			int numSamples) {
+			forSelected([=](auto& rotation) { rotation.spinRotate(inLeft, inRight, outLeft, outRight, numSamples); });
+		}
+		// Glides the selected rotation to the angles; the others take them over directly.
+		void glideTo(float phi, float theta, int numSamples) {
+			forSelected([=](auto& rotation) { rotation.glideTo(phi, theta, numSamples); });
+			setPhi(phi);
+			setTheta(theta);
+		}
+		void setTheta(float theta) {
+			forEach([theta](auto& rotation) { rotation.setTheta(theta); });
+		}
+		void setPhi(float phi) {
+			forEach([phi](auto& rotation) { rotation.setPhi(phi); });
+		}
+		void setMode(RotationMode mode) {
+			forEach([mode](auto& rotation) { rotation.setMode(mode); });
+		}
+
+	private:
+		int dimension{ classic };
+		BasicSpin3Rotation<SampleType> classicRotation;
+		std::tuple<SpinRotation<2, SampleType>, SpinRotation<3, SampleType>, SpinRotation<4, SampleType>, 
+			SpinRotation<5, SampleType>, SpinRotation<6, SampleType>, SpinRotation<7, SampleType>, 
+			SpinRotation<8, SampleType>> rotations;
+
+		// The angles and the mode are passed to all rotations, which only mark their matrices for an update.
+		template <typename Function>
+		void forEach(Function function) {
+			function(classicRotation);
+			std::apply([&function](auto&... rotation) { (function(rotation), ...); }, rotations);
+		}
+
+		template <typename Function>
+		void forSelected(Function function) {
+			switch (dimension) {
+				case 2: function(std::get<0>(rotations)); break;
+				case 3: function(std::get<1>(rotations)); break;
+				case 4: function(std::get<2>(rotations)); break;
+				case 5: function(std::get<3>(rotations)); break;
+				case 6: function(std::get<4>(rotations)); break;
+				case 7: function(std::get<5>(rotations)); break;
+				case 8: function(std::get<6>(rotations)); break;
+				default: function(classicRotation); break;
+			}
+		}
+};
+
+using SelectableSpinRotation = BasicSelectableSpinRotation<float>;
+
 } // namespace cw::synth
\ No newline at end of file
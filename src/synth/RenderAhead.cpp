@@ -0,0 +1,309 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "RenderAhead.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cw::synth {
+
+RenderAheadLane::RenderAheadLane(RenderAheadSource& source) : source(source), samples(2, ringSize) {}
+
+void RenderAheadLane::start() {
+    jassert(isIdle());
+    writtenSlots.store(0, std::memory_order_relaxed);
+    freedSlots.store(0, std::memory_order_relaxed);
+    position = 0;
+    readAny = false;
+    active = true;
+    // publishes the state of the source as well
+    state.store(starting, std::memory_order_release);
+}
+
+void RenderAheadLane::cancel() {
+    if (active) {
+        active = false;
+        state.store(cancelling, std::memory_order_release);
+    }
+}
+
+bool RenderAheadLane::read(juce::AudioBuffer<float>& output, int startSample, int numSamples) {
+    const auto end = position + numSamples;
+    if (end > writtenSlots.load(std::memory_order_acquire) * slotSize) {
+        return false;
+    }
+
+    const int numChannels = juce::jmin(output.getNumChannels(), samples.getNumChannels());
+    for (int done = 0; done < numSamples;) {
+        const int ringPosition = (int)((position + done) % ringSize);
+        const int length = juce::jmin(numSamples - done, ringSize - ringPosition);
+        for (int channel = 0; channel < numChannels; ++channel) {
+            output.addFrom(channel, startSample + done, samples, channel, ringPosition, length);
+        }
+        done += length;
+    }
+    position = end;
+    readAny = true;
+    freeSlots();
+    return true;
+}
+
+void RenderAheadLane::skip(int numSamples) {
+    jassert(!readAny);
+    position += numSamples;
+    freeSlots();
+}
+
+int RenderAheadLane::getCheckpoint(int& samplesSinceCheckpoint) const {
+    auto slot = position / slotSize;
+    samplesSinceCheckpoint = (int)(position % slotSize);
+    // at the end of a slot which was the last one written, that slot is the one to return to
+    if (slot >= writtenSlots.load(std::memory_order_acquire)) {
+        --slot;
+        samplesSinceCheckpoint += slotSize;
+    }
+    return (int)(slot % numSlots);
+}
+
+void RenderAheadLane::reset() {
+    active = false;
+    state.store(idle, std::memory_order_release);
+}
+
+void RenderAheadLane::freeSlots() {
+    freedSlots.store(position > 0 ? (position - 1) / slotSize : 0, std::memory_order_release);
+}
+
+bool RenderAheadLane::needsWork() const {
+    const int current = state.load(std::memory_order_acquire);
+    if (current == running) {
+        return writtenSlots.load(std::memory_order_relaxed) - freedSlots.load(std::memory_order_acquire) < numSlots;
+    }
+    return current != idle;
+}
+
+int RenderAheadLane::getSamplesAhead() const {
+    if (state.load(std::memory_order_acquire) != running) {
+        return 0;
+    }
+    return (int)(writtenSlots.load(std::memory_order_relaxed) - freedSlots.load(std::memory_order_acquire)) * slotSize;
+}
+
+bool RenderAheadLane::work() {
+    int current = state.load(std::memory_order_acquire);
+    if (current == cancelling) {
+        state.compare_exchange_strong(current, idle, std::memory_order_acq_rel);
+        return false;
+    }
+    if (current == starting && !state.compare_exchange_strong(current, running, std::memory_order_acq_rel)) {
+        return false;
+    }
+    if (current != starting && current != running) {
+        return false;
+    }
+
+    const auto slot = writtenSlots.load(std::memory_order_relaxed);
+    if (slot - freedSlots.load(std::memory_order_acquire) >= numSlots) {
+        return false;
+    }
+    const int index = (int)(slot % numSlots);
+    source.saveCheckpoint(index);
+    samples.clear(index * slotSize, slotSize);
+    source.renderAhead(samples, index * slotSize, slotSize);
+    writtenSlots.store(slot + 1, std::memory_order_release);
+    return true;
+}
+
+RenderAheadQueue::RenderAheadQueue() = default;
+
+RenderAheadQueue::~RenderAheadQueue() {
+    stop();
+}
+
+void RenderAheadQueue::start(std::vector<RenderAheadLane*> newLanes, double newSampleRate) {
+    stop();
+    lanes = std::move(newLanes);
+    claimed = std::make_unique<std::atomic<bool>[]>(lanes.size());
+    sampleRate = newSampleRate;
+    pool->add(*this);
+    started = true;
+}
+
+void RenderAheadQueue::stop() {
+    if (started) {
+        pool->remove(*this);
+        started = false;
+    }
+}
+
+RenderAheadPool::RenderAheadPool() {
+    const int numWorkers = juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+    }
+    for (auto& worker : workers) {
+        worker->startThread();
+    }
+}
+
+RenderAheadPool::~RenderAheadPool() {
+    for (auto& worker : workers) {
+        worker->signalThreadShouldExit();
+        worker->wake();
+    }
+    workers.clear();
+}
+
+void RenderAheadPool::add(RenderAheadQueue& queue) {
+    auto& home = *workers[(size_t)(nextHomeWorker++ % getNumWorkers())];
+    {
+        const juce::ScopedLock sl(home.lock);
+        queue.homeWorker = home.index;
+        home.queues.push_back(&queue);
+    }
+    home.wake();
+}
+
+void RenderAheadPool::remove(RenderAheadQueue& queue) {
+    {
+        auto& home = *workers[(size_t)queue.homeWorker];
+        const juce::ScopedLock sl(home.lock);
+        home.queues.erase(std::remove(home.queues.begin(), home.queues.end(), &queue), home.queues.end());
+    }
+    // a worker which has claimed a lane before finishes it
+    while (queue.busyWorkers.load(std::memory_order_acquire) > 0) {
+        juce::Thread::yield();
+    }
+}
+
+bool RenderAheadPool::claim(Worker& owner, RenderAheadQueue*& queue, int& lane, int& numWaiting, int& waitMs) {
+    // the lane with the least time until it runs dry; a lane to start or to cancel counts as dry
+    constexpr double none = std::numeric_limits<double>::max();
+    double earliest = none;
+    double nextWork = idleWaitMs / 1000.;
+    numWaiting = 0;
+    // without queues, only a sibling has work for the worker
+    waitMs = owner.queues.empty() ? -1 : idleWaitMs;
+    for (auto candidate : owner.queues) {
+        for (int i = 0; i < (int)candidate->lanes.size(); ++i) {
+            const auto* candidateLane = candidate->lanes[i];
+            const double secondsAhead = candidateLane->getSamplesAhead() / candidate->sampleRate;
+            if (!candidateLane->needsWork()) {
+                // a full lane needs work once the audio thread has played a slot of it
+                if (secondsAhead > 0.) {
+                    nextWork = std::min(nextWork, RenderAheadLane::slotSize / candidate->sampleRate);
+                }
+                continue;
+            }
+            if (candidate->claimed[i].load(std::memory_order_relaxed)) {
+                continue;
+            }
+            ++numWaiting;
+            if (secondsAhead < earliest) {
+                earliest = secondsAhead;
+                queue = candidate;
+                lane = i;
+            }
+        }
+    }
+    if (!owner.queues.empty()) {
+        waitMs = juce::jmax(1, (int)(nextWork * 1000.));
+    }
+    if (earliest == none) {
+        return false;
+    }
+    // another worker may have taken the lane in the meantime, then the next one is looked for
+    bool expected = false;
+    if (!queue->claimed[lane].compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+        return claim(owner, queue, lane, numWaiting, waitMs);
+    }
+    // counted while the lock of the list is held, so that removing the queue waits for the lane
+    queue->busyWorkers.fetch_add(1, std::memory_order_acq_rel);
+    --numWaiting;
+    return true;
+}
+
+bool RenderAheadPool::steal(int thief, RenderAheadQueue*& queue, int& lane, int& numWaiting) {
+    const int numWorkers = getNumWorkers();
+    for (int offset = 1; offset < numWorkers; ++offset) {
+        auto& victim = *workers[(size_t)((thief + offset) % numWorkers)];
+        const juce::ScopedTryLock sl(victim.lock);
+        int waitMs = 0;
+        if (sl.isLocked() && claim(victim, queue, lane, numWaiting, waitMs)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderAheadPool::wakeSibling(int worker) {
+    const int numWorkers = getNumWorkers();
+    if (numWorkers < 2) {
+        return;
+    }
+    for (int offset = 1; offset < numWorkers; ++offset) {
+        auto& sibling = *workers[(size_t)((worker + offset) % numWorkers)];
+        if (sibling.isSleeping()) {
+            sibling.wake();
+            return;
+        }
+    }
+    // a sibling which is about to sleep looks once more
+    workers[(size_t)((worker + 1) % numWorkers)]->wake();
+}
+
+void RenderAheadPool::runClaimed(RenderAheadQueue& queue, int lane) {
+    queue.lanes[lane]->work();
+    queue.claimed[lane].store(false, std::memory_order_release);
+    queue.busyWorkers.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+RenderAheadPool::Worker::Worker(RenderAheadPool& pool, int index) : juce::Thread("Render Ahead " + juce::String(index)),
+    pool(pool), index(index) {}
+
+RenderAheadPool::Worker::~Worker() {
+    stopThread(1000);
+}
+
+void RenderAheadPool::Worker::run() {
+    while (!threadShouldExit()) {
+        RenderAheadQueue* queue = nullptr;
+        int lane = 0;
+        int numWaiting = 0;
+        int waitMs = idleWaitMs;
+        bool claimed = false;
+        {
+            const juce::ScopedLock sl(lock);
+            claimed = pool.claim(*this, queue, lane, numWaiting, waitMs);
+        }
+        if (!claimed && !pool.steal(index, queue, lane, numWaiting)) {
+            sleeping.store(true, std::memory_order_relaxed);
+            wakeUp.wait(waitMs);
+            sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        // more lanes wait than this worker takes, a sibling helps
+        if (numWaiting > 0) {
+            pool.wakeSibling(index);
+        }
+        pool.runClaimed(*queue, lane);
+    }
+}
+
+} // namespace cw::synth
@@ -0,0 +1,227 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace cw::synth {
+
+/**
+ * What a lane renders ahead: a copy of a voice, which only the worker touches while the lane runs.
+ */
+class RenderAheadSource {
+    public:
+        virtual ~RenderAheadSource() = default;
+
+        // Keeps the state at the start of the given slot, so that the voice can return to it.
+        virtual void saveCheckpoint(int slot) = 0;
+        // Adds the next samples to the given range of the buffer.
+        virtual void renderAhead(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) = 0;
+};
+
+/**
+ * The samples of a held note, rendered ahead by a worker thread, which the audio thread plays instead of rendering
+ * them. The samples lie in a ring of slots, each with a checkpoint of the voice at its start, so that the voice can
+ * return to direct rendering at any position: from the checkpoint of the slot, it renders the samples up to the
+ * position once more. The worker is the only writer and the audio thread the only reader; both are wait-free.
+ *
+ * The audio thread starts the lane from the state of the voice and cancels it whenever anything but time changes. 
+ * The worker acknowledges the cancellation before the lane can be started again.
+ */
+class RenderAheadLane {
+    public:
+        static constexpr int slotSize = 256;
+        static constexpr int numSlots = 16;
+
+        explicit RenderAheadLane(RenderAheadSource& source);
+
+        // Whether the lane can be started, i.e. it is not active and the worker has let go of it. For the audio thread.
+        bool isIdle() const { return state.load(std::memory_order_acquire) == idle; }
+        // Whether the lane has been started and not cancelled since. For the audio thread.
+        bool isActive() const { return active; }
+        /*
+        * Starts rendering ahead from the state of the source, which the audio thread has set up while the lane was 
+        * idle. For the audio thread.
+        */
+        void start();
+        // Stops rendering ahead, the samples which have not been read are given up. For the audio thread.
+        void cancel();
+        /*
+        * Adds the next samples to the output and returns true, if they have been rendered already. Returns false 
+        * otherwise, the position stays. For the audio thread.
+        */
+        bool read(juce::AudioBuffer<float>& output, int startSample, int numSamples);
+        /*
+        * Moves the position on while the voice still renders the samples itself, until the worker has caught up. 
+        * For the audio thread, before anything has been read.
+        */
+        void skip(int numSamples);
+        // Whether samples have been read since the start, i.e. the voice has not rendered all of them itself.
+        bool hasRead() const { return readAny; }
+        /*
+        * The slot whose checkpoint lies closest before the position, with the number of samples from the checkpoint
+        * to the position. For the audio thread, once samples have been read, also after cancelling.
+        */
+        int getCheckpoint(int& samplesSinceCheckpoint) const;
+        // Stops the lane at once. Only while no worker runs it.
+        void reset();
+
+        // Whether the worker has anything to do: a start or cancellation to acknowledge, or a free slot to render.
+        bool needsWork() const;
+        // The number of samples rendered ahead of the audio thread, up to the slot it plays.
+        int getSamplesAhead() const;
+        /*
+        * Renders the next slot if there is room and acknowledges starts and cancellations. Returns whether it 
+        * rendered anything. For one worker at a time.
+        */
+        bool work();
+
+    private:
+        static constexpr int ringSize = slotSize * numSlots;
+
+        enum State {
+            idle,
+            starting,
+            running,
+            cancelling
+        };
+
+        RenderAheadSource& source;
+        std::atomic<int> state{ idle };
+        // the slots written by the worker and the slots freed by the audio thread, counted from the start
+        std::atomic<juce::int64> writtenSlots{ 0 };
+        std::atomic<juce::int64> freedSlots{ 0 };
+        juce::AudioBuffer<float> samples;
+
+        // the view of the audio thread: started and not cancelled, the position since the start, and whether any 
+        // samples have been read
+        bool active{ false };
+        juce::int64 position{ 0 };
+        bool readAny{ false };
+
+        // Frees the slots before the position, but keeps the one which ends at the position.
+        void freeSlots();
+};
+
+class RenderAheadPool;
+
+/**
+ * The lanes of one synth, which it hands to the worker pool shared by all synths of the process. Stopping the queue 
+ * waits until no worker touches its lanes any more, so a synth which goes away leaves nothing behind.
+ */
+class RenderAheadQueue {
+    public:
+        RenderAheadQueue();
+        ~RenderAheadQueue();
+
+        /*
+        * Hands the lanes to the pool, at the given sample rate, by which the time left until each lane runs dry is 
+        * measured. Not real-time safe; the lanes must outlive the queue or the next call to stop.
+        */
+        void start(std::vector<RenderAheadLane*> newLanes, double newSampleRate);
+        // Takes the lanes back from the pool. Not real-time safe.
+        void stop();
+
+    private:
+        friend class RenderAheadPool;
+
+        juce::SharedResourcePointer<RenderAheadPool> pool;
+        // the lanes, whether a worker runs each of them, and the number of workers running any of them
+        std::vector<RenderAheadLane*> lanes;
+        std::unique_ptr<std::atomic<bool>[]> claimed;
+        std::atomic<int> busyWorkers{ 0 };
+        double sampleRate{ 44100. };
+        // the worker whose list holds the queue
+        int homeWorker{ 0 };
+        bool started{ false };
+};
+
+/**
+ * The worker threads which render ahead for all synths of the process, one for each core but the one of the audio 
+ * thread, so that many instances of the plugin do not compete for the cores. Each queue belongs to the list of one
+ * worker, which serves the lane of its queues that runs dry first and keeps them warm in that core's cache. A worker
+ * with nothing to do in its own list steals from the lists of the others, without waiting for their locks. Lanes are
+ * claimed one at a time, so that several workers can run the lanes of one queue.
+ *
+ * A worker sleeps on its own event. It is woken when a queue is added to its list, and by a sibling which gives back
+ * a lane while more lanes wait. The audio thread does not signal, as that takes a lock; a worker with running lanes
+ * sleeps for the time the audio thread takes to play one slot, after which a slot has been freed, a worker whose lanes
+ * are idle looks for started ones after idleWaitMs, and a worker without queues sleeps until a sibling wakes it.
+ * Shared through juce::SharedResourcePointer.
+ */
+class RenderAheadPool {
+    public:
+        RenderAheadPool();
+        ~RenderAheadPool();
+
+        int getNumWorkers() const { return (int)workers.size(); }
+
+    private:
+        friend class RenderAheadQueue;
+
+        class Worker : public juce::Thread {
+            public:
+                Worker(RenderAheadPool& pool, int index);
+                ~Worker() override;
+
+                // Wakes the worker, if it sleeps.
+                void wake() { wakeUp.signal(); }
+                bool isSleeping() const { return sleeping.load(std::memory_order_relaxed); }
+
+            private:
+                friend class RenderAheadPool;
+
+                RenderAheadPool& pool;
+                const int index;
+                // the queues of the worker, guarded by the lock, which thieves only try
+                juce::CriticalSection lock;
+                std::vector<RenderAheadQueue*> queues;
+                juce::WaitableEvent wakeUp;
+                std::atomic<bool> sleeping{ false };
+
+                void run() override;
+        };
+
+        // the longest sleep of a worker whose queues have no running lanes, which picks up started lanes by then
+        static constexpr int idleWaitMs = 10;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<int> nextHomeWorker{ 0 };
+
+        void add(RenderAheadQueue& queue);
+        // Waits until no worker runs any lane of the queue.
+        void remove(RenderAheadQueue& queue);
+        /*
+        * Claims the lane of the worker's queues which runs dry first. Returns false if there is nothing to do. Counts
+        * the other lanes which need work, and returns how long the worker may sleep, in milliseconds: until a running
+        * lane needs work again, or for good without queues. Only with the lock of the worker held.
+        */
+        bool claim(Worker& owner, RenderAheadQueue*& queue, int& lane, int& numWaiting, int& waitMs);
+        // Claims a lane from the queues of another worker whose lock is free. Returns false if there is none.
+        bool steal(int thief, RenderAheadQueue*& queue, int& lane, int& numWaiting);
+        // Wakes one sleeping worker other than the given one.
+        void wakeSibling(int worker);
+        // Runs the claimed lane once and gives it back.
+        void runClaimed(RenderAheadQueue& queue, int lane);
+};
+
+} // namespace cw::synth
@@ -0,0 +1,488 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "SynthPreset.h"
+
+namespace cw::synth {
+
+namespace {
+
+const juce::String presetTag{ "AddSynthPreset" };
+constexpr int presetVersion = 1;
+
+// IDs of the binary format, four characters each
+const auto binaryMagic = (int)juce::ByteOrder::littleEndianInt("ASPS");
+const auto harmonicsChunk = (int)juce::ByteOrder::littleEndianInt("HARM");
+const auto envelopeChunk = (int)juce::ByteOrder::littleEndianInt("ADSR");
+const auto rotationChunk = (int)juce::ByteOrder::littleEndianInt("ROTN");
+const auto oscillatorChunk = (int)juce::ByteOrder::littleEndianInt("OSCM");
+const auto modulationChunk = (int)juce::ByteOrder::littleEndianInt("MODM");
+const auto partialsChunk = (int)juce::ByteOrder::littleEndianInt("PART");
+constexpr int binaryVersion = 1;
+
+juce::String getHarmonicId(int harmonic) {
+    return "harmonic" + juce::String(harmonic);
+}
+
+const juce::StringArray engineNames{ "table", "poly5", "poly7", "poly9", "phasor" };
+const juce::StringArray interpolationNames{ "linear", "hermite", "lagrange" };
+const juce::StringArray tuningNames{ "harmonic", "stretched", "bell", "bar", "custom" };
+
+const juce::String modulationTag{ "Modulation" };
+const juce::StringArray lfoShapeNames{ "sine", "triangle", "saw", "square" };
+
+// sources are named "lfo1" to "lfo8" and "env1", "env2"
+juce::String getSourceName(const ModulationRoute& route) {
+    return (route.source == ModulationSource::lfo ? "lfo" : "env") + juce::String(route.sourceIndex + 1);
+}
+
+bool parseSource(const juce::String& name, ModulationRoute& route) {
+    if (name.startsWith("lfo")) {
+        route.source = ModulationSource::lfo;
+    }
+    else if (name.startsWith("env")) {
+        route.source = ModulationSource::envelope;
+    }
+    else {
+        return false;
+    }
+    route.sourceIndex = name.substring(3).getIntValue() - 1;
+    return true;
+}
+
+// targets are named "phi", "theta" and like the harmonic gain parameters, "harmonic0" etc.
+juce::String getTargetName(const ModulationRoute& route) {
+    switch (route.target) {
+        case ModulationTarget::phi: return "phi";
+        case ModulationTarget::theta: return "theta";
+        default: return getHarmonicId(route.harmonic);
+    }
+}
+
+bool parseTarget(const juce::String& name, ModulationRoute& route) {
+    if (name == "phi") {
+        route.target = ModulationTarget::phi;
+    }
+    else if (name == "theta") {
+        route.target = ModulationTarget::theta;
+    }
+    else if (name.startsWith("harmonic")) {
+        route.target = ModulationTarget::harmonicGain;
+        route.harmonic = name.substring(8).getIntValue();
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Only a modulation with routes is written, as it has no effect otherwise.
+std::unique_ptr<juce::XmlElement> modulationToXml(const ModulationSettings& modulation) {
+    auto xml = std::make_unique<juce::XmlElement>(modulationTag);
+    xml->setAttribute("interval", modulation.controlInterval);
+    for (int i = 0; i < ModulationSettings::maxLfos; ++i) {
+        const auto& lfo = modulation.lfos[i];
+        auto* element = xml->createNewChildElement("Lfo");
+        element->setAttribute("index", i + 1);
+        element->setAttribute("shape", lfoShapeNames[(int)lfo.shape]);
+        element->setAttribute("rate", lfo.rate);
+        element->setAttribute("phase", lfo.phase);
+    }
+    for (int i = 0; i < ModulationSettings::maxEnvelopes; ++i) {
+        const auto& envelope = modulation.envelopes[i];
+        auto* element = xml->createNewChildElement("Envelope");
+        element->setAttribute("index", i + 1);
+        element->setAttribute("attack", envelope.attack);
+        element->setAttribute("decay", envelope.decay);
+        element->setAttribute("sustain", envelope.sustain);
+        element->setAttribute("release", envelope.release);
+    }
+    for (int i = 0; i < modulation.numRoutes; ++i) {
+        const auto& route = modulation.routes[i];
+        auto* element = xml->createNewChildElement("Route");
+        element->setAttribute("source", getSourceName(route));
+        element->setAttribute("target", getTargetName(route));
+        element->setAttribute("depth", route.depth);
+    }
+    return xml;
+}
+
+// Routes with unknown sources or targets are left out.
+ModulationSettings modulationFromXml(const juce::XmlElement& xml) {
+    ModulationSettings modulation;
+    modulation.controlInterval = xml.getIntAttribute("interval", modulation.controlInterval);
+    for (auto* element : xml.getChildWithTagNameIterator("Lfo")) {
+        const int index = element->getIntAttribute("index") - 1;
+        if (index < 0 || index >= ModulationSettings::maxLfos) {
+            continue;
+        }
+        auto& lfo = modulation.lfos[index];
+        lfo.shape = (LfoShape)juce::jmax(0, lfoShapeNames.indexOf(element->getStringAttribute("shape", "sine")));
+        lfo.rate = (float)element->getDoubleAttribute("rate", lfo.rate);
+        lfo.phase = (float)element->getDoubleAttribute("phase", lfo.phase);
+    }
+    for (auto* element : xml.getChildWithTagNameIterator("Envelope")) {
+        const int index = element->getIntAttribute("index") - 1;
+        if (index < 0 || index >= ModulationSettings::maxEnvelopes) {
+            continue;
+        }
+        auto& envelope = modulation.envelopes[index];
+        envelope.attack = (float)element->getDoubleAttribute("attack", envelope.attack);
+        envelope.decay = (float)element->getDoubleAttribute("decay", envelope.decay);
+        envelope.sustain = (float)element->getDoubleAttribute("sustain", envelope.sustain);
+        envelope.release = (float)element->getDoubleAttribute("release", envelope.release);
+    }
+    for (auto* element : xml.getChildWithTagNameIterator("Route")) {
+        ModulationRoute route;
+        if (parseSource(element->getStringAttribute("source"), route) 
+            && parseTarget(element->getStringAttribute("target"), route)) {
+            route.depth = (float)element->getDoubleAttribute("depth");
+            modulation.addRoute(route);
+        }
+    }
+    modulation.validate();
+    return modulation;
+}
+
+// Reads the modulation chunk up to its end. Entries beyond the sizes of the settings are skipped.
+bool readModulation(juce::MemoryInputStream& stream, juce::int64 chunkEnd, ModulationSettings& modulation) {
+    auto fits = [&stream, chunkEnd](juce::int64 count, juce::int64 entrySize) {
+        return count >= 0 && stream.getPosition() + count * entrySize <= chunkEnd;
+    };
+    if (!fits(2, sizeof(int))) {
+        return false;
+    }
+    ModulationSettings result;
+    result.controlInterval = stream.readInt();
+
+    const int numLfos = stream.readInt();
+    if (!fits(numLfos, sizeof(int) + 2 * sizeof(float))) {
+        return false;
+    }
+    for (int i = 0; i < numLfos; ++i) {
+        LfoSettings lfo;
+        lfo.shape = (LfoShape)juce::jlimit(0, lfoShapeNames.size() - 1, stream.readInt());
+        lfo.rate = stream.readFloat();
+        lfo.phase = stream.readFloat();
+        if (i < ModulationSettings::maxLfos) {
+            result.lfos[i] = lfo;
+        }
+    }
+
+    if (!fits(1, sizeof(int))) {
+        return false;
+    }
+    const int numEnvelopes = stream.readInt();
+    if (!fits(numEnvelopes, 4 * sizeof(float))) {
+        return false;
+    }
+    for (int i = 0; i < numEnvelopes; ++i) {
+        ModulationEnvelopeSettings envelope;
+        envelope.attack = stream.readFloat();
+        envelope.decay = stream.readFloat();
+        envelope.sustain = stream.readFloat();
+        envelope.release = stream.readFloat();
+        if (i < ModulationSettings::maxEnvelopes) {
+            result.envelopes[i] = envelope;
+        }
+    }
+
+    if (!fits(1, sizeof(int))) {
+        return false;
+    }
+    const int numRoutes = stream.readInt();
+    if (!fits(numRoutes, 4 * sizeof(int) + sizeof(float))) {
+        return false;
+    }
+    for (int i = 0; i < numRoutes; ++i) {
+        ModulationRoute route;
+        route.source = stream.readInt() == 1 ? ModulationSource::envelope : ModulationSource::lfo;
+        route.sourceIndex = stream.readInt();
+        const int target = stream.readInt();
+        route.target = target == 1 ? ModulationTarget::theta 
+            : (target == 2 ? ModulationTarget::harmonicGain : ModulationTarget::phi);
+        route.harmonic = stream.readInt();
+        route.depth = stream.readFloat();
+        result.addRoute(route);
+    }
+
+    result.validate();
+    modulation = result;
+    return true;
+}
+
+} // namespace
+
+std::unique_ptr<juce::XmlElement> SynthPreset::toXml() const {
+    auto xml = std::make_unique<juce::XmlElement>(presetTag);
+    xml->setAttribute("version", presetVersion);
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        xml->setAttribute(getHarmonicId(i), harmonicGains[i]);
+    }
+    xml->setAttribute("attack", attack);
+    xml->setAttribute("delay", decay);
+    xml->setAttribute("sustain", sustain);
+    xml->setAttribute("release", release);
+    xml->setAttribute("phi", phi);
+    xml->setAttribute("theta", theta);
+    xml->setAttribute("unitary", rotationMode == RotationMode::unitary);
+    xml->setAttribute("spin", spinDimension);
+    xml->setAttribute("baked", bakedWaveform);
+    xml->setAttribute("engine", engineNames[(int)oscillatorEngine]);
+    xml->setAttribute("interpolation", interpolationNames[(int)interpolation]);
+    xml->setAttribute("offlineInterpolation", interpolationNames[(int)offlineInterpolation]);
+    xml->setAttribute("tuning", tuningNames[(int)partials.tuning]);
+    xml->setAttribute("stretch", partials.stretch);
+    // the custom ratios as a list, e.g. "1 2.76 5.4"
+    if (partials.tuning == PartialTuning::custom) {
+        juce::StringArray ratios;
+        for (auto ratio : partials.custom) {
+            ratios.add(juce::String(ratio));
+        }
+        xml->setAttribute("ratios", ratios.joinIntoString(" "));
+    }
+    xml->setAttribute("unison", unisonVoices);
+    xml->setAttribute("detune", unisonDetune);
+    xml->setAttribute("spread", unisonSpread);
+    if (modulation.isActive()) {
+        xml->addChildElement(modulationToXml(modulation).release());
+    }
+    return xml;
+}
+
+bool SynthPreset::fromXml(const juce::XmlElement& xml) {
+    if (!xml.hasTagName(presetTag)) {
+        return false;
+    }
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        harmonicGains[i] = (float)xml.getDoubleAttribute(getHarmonicId(i), harmonicGains[i]);
+    }
+    attack = (float)xml.getDoubleAttribute("attack", attack);
+    decay = (float)xml.getDoubleAttribute("delay", decay);
+    sustain = (float)xml.getDoubleAttribute("sustain", sustain);
+    release = (float)xml.getDoubleAttribute("release", release);
+    phi = (float)xml.getDoubleAttribute("phi", phi);
+    theta = (float)xml.getDoubleAttribute("theta", theta);
+    rotationMode = xml.getBoolAttribute("unitary", rotationMode == RotationMode::unitary) ? RotationMode::unitary
+        : RotationMode::generators;
+    spinDimension = xml.getIntAttribute("spin", spinDimension);
+    bakedWaveform = xml.getBoolAttribute("baked", bakedWaveform);
+    oscillatorEngine = (OscillatorEngine)juce::jmax(0, engineNames.indexOf(xml.getStringAttribute("engine",
+        engineNames[(int)oscillatorEngine])));
+    interpolation = (TableInterpolation)juce::jmax(0, interpolationNames.indexOf(xml.getStringAttribute(
+        "interpolation", interpolationNames[(int)interpolation])));
+    offlineInterpolation = (TableInterpolation)juce::jmax(0, interpolationNames.indexOf(xml.getStringAttribute(
+        "offlineInterpolation", interpolationNames[(int)offlineInterpolation])));
+    partials.tuning = (PartialTuning)juce::jmax(0, tuningNames.indexOf(xml.getStringAttribute("tuning", 
+        tuningNames[(int)partials.tuning])));
+    partials.stretch = (float)xml.getDoubleAttribute("stretch", partials.stretch);
+    if (xml.hasAttribute("ratios")) {
+        const auto ratios = juce::StringArray::fromTokens(xml.getStringAttribute("ratios"), false);
+        for (int i = 0; i < juce::jmin(ratios.size(), NO_ADDSYNTH_VOICES); ++i) {
+            partials.custom[i] = ratios[i].getFloatValue();
+        }
+    }
+    unisonVoices = xml.getIntAttribute("unison", unisonVoices);
+    unisonDetune = (float)xml.getDoubleAttribute("detune", unisonDetune);
+    unisonSpread = (float)xml.getDoubleAttribute("spread", unisonSpread);
+    if (auto* modulationXml = xml.getChildByName(modulationTag)) {
+        modulation = modulationFromXml(*modulationXml);
+    }
+    return true;
+}
+
+void SynthPreset::writeBinary(juce::OutputStream& stream) const {
+    auto writeChunkHeader = [&stream](int id, size_t sizeInBytes) {
+        stream.writeInt(id);
+        stream.writeInt((int)sizeInBytes);
+    };
+
+    stream.writeInt(binaryMagic);
+    stream.writeInt(binaryVersion);
+
+    writeChunkHeader(harmonicsChunk, sizeof(int) + harmonicGains.size() * sizeof(float));
+    stream.writeInt((int)harmonicGains.size());
+    for (auto gain : harmonicGains) {
+        stream.writeFloat(gain);
+    }
+
+    writeChunkHeader(envelopeChunk, 4 * sizeof(float));
+    stream.writeFloat(attack);
+    stream.writeFloat(decay);
+    stream.writeFloat(sustain);
+    stream.writeFloat(release);
+
+    // the mode and the dimension were added after the angles; older readers skip them
+    writeChunkHeader(rotationChunk, 2 * sizeof(float) + 2 * sizeof(int));
+    stream.writeFloat(phi);
+    stream.writeFloat(theta);
+    stream.writeInt(rotationMode == RotationMode::unitary ? 1 : 0);
+    stream.writeInt(spinDimension);
+
+    // the unison, the engine and the interpolations were added after the baked waveform; older readers skip them
+    writeChunkHeader(oscillatorChunk, 5 * sizeof(int) + 2 * sizeof(float));
+    stream.writeInt(bakedWaveform ? 1 : 0);
+    stream.writeInt(unisonVoices);
+    stream.writeFloat(unisonDetune);
+    stream.writeFloat(unisonSpread);
+    stream.writeInt((int)oscillatorEngine);
+    stream.writeInt((int)interpolation);
+    stream.writeInt((int)offlineInterpolation);
+
+    writeChunkHeader(partialsChunk, 2 * sizeof(int) + (1 + partials.custom.size()) * sizeof(float));
+    stream.writeInt((int)partials.tuning);
+    stream.writeFloat(partials.stretch);
+    stream.writeInt((int)partials.custom.size());
+    for (auto ratio : partials.custom) {
+        stream.writeFloat(ratio);
+    }
+
+    // the interval, then the LFOs, envelopes and routes, each preceded by their number
+    writeChunkHeader(modulationChunk, 4 * sizeof(int) + ModulationSettings::maxLfos * (sizeof(int) + 2 * sizeof(float))
+        + ModulationSettings::maxEnvelopes * 4 * sizeof(float) + modulation.numRoutes * (4 * sizeof(int) + sizeof(float)));
+    stream.writeInt(modulation.controlInterval);
+    stream.writeInt(ModulationSettings::maxLfos);
+    for (const auto& lfo : modulation.lfos) {
+        stream.writeInt((int)lfo.shape);
+        stream.writeFloat(lfo.rate);
+        stream.writeFloat(lfo.phase);
+    }
+    stream.writeInt(ModulationSettings::maxEnvelopes);
+    for (const auto& envelope : modulation.envelopes) {
+        stream.writeFloat(envelope.attack);
+        stream.writeFloat(envelope.decay);
+        stream.writeFloat(envelope.sustain);
+        stream.writeFloat(envelope.release);
+    }
+    stream.writeInt(modulation.numRoutes);
+    for (int i = 0; i < modulation.numRoutes; ++i) {
+        const auto& route = modulation.routes[i];
+        stream.writeInt((int)route.source);
+        stream.writeInt(route.sourceIndex);
+        stream.writeInt((int)route.target);
+        stream.writeInt(route.harmonic);
+        stream.writeFloat(route.depth);
+    }
+}
+
+bool SynthPreset::readBinary(const void* data, size_t sizeInBytes) {
+    juce::MemoryInputStream stream(data, sizeInBytes, false);
+    if (sizeInBytes < 2 * sizeof(int) || stream.readInt() != binaryMagic || stream.readInt() < 1) {
+        return false;
+    }
+
+    while (stream.getNumBytesRemaining() >= (juce::int64)(2 * sizeof(int))) {
+        const int id = stream.readInt();
+        const int chunkSize = stream.readInt();
+        const auto chunkEnd = stream.getPosition() + chunkSize;
+        if (chunkSize < 0 || chunkEnd > (juce::int64)sizeInBytes) {
+            return false;
+        }
+
+        if (id == harmonicsChunk) {
+            const int count = juce::jmin(stream.readInt(), (chunkSize - (int)sizeof(int)) / (int)sizeof(float));
+            for (int i = 0; i < count; ++i) {
+                const auto gain = stream.readFloat();
+                if (i < NO_ADDSYNTH_VOICES) {
+                    harmonicGains[i] = gain;
+                }
+            }
+        }
+        else if (id == envelopeChunk && chunkSize >= 4 * (int)sizeof(float)) {
+            attack = stream.readFloat();
+            decay = stream.readFloat();
+            sustain = stream.readFloat();
+            release = stream.readFloat();
+        }
+        else if (id == rotationChunk && chunkSize >= 2 * (int)sizeof(float)) {
+            phi = stream.readFloat();
+            theta = stream.readFloat();
+            if (chunkSize >= 2 * (int)sizeof(float) + (int)sizeof(int)) {
+                rotationMode = stream.readInt() != 0 ? RotationMode::unitary : RotationMode::generators;
+            }
+            if (chunkSize >= 2 * (int)sizeof(float) + 2 * (int)sizeof(int)) {
+                spinDimension = stream.readInt();
+            }
+        }
+        else if (id == oscillatorChunk && chunkSize >= (int)sizeof(int)) {
+            bakedWaveform = stream.readInt() != 0;
+            if (chunkSize >= 2 * (int)sizeof(int) + 2 * (int)sizeof(float)) {
+                unisonVoices = stream.readInt();
+                unisonDetune = stream.readFloat();
+                unisonSpread = stream.readFloat();
+            }
+            if (chunkSize >= 3 * (int)sizeof(int) + 2 * (int)sizeof(float)) {
+                oscillatorEngine = (OscillatorEngine)juce::jlimit(0, engineNames.size() - 1, stream.readInt());
+            }
+            if (chunkSize >= 5 * (int)sizeof(int) + 2 * (int)sizeof(float)) {
+                interpolation = (TableInterpolation)juce::jlimit(0, interpolationNames.size() - 1, stream.readInt());
+                offlineInterpolation = (TableInterpolation)juce::jlimit(0, interpolationNames.size() - 1, 
+                    stream.readInt());
+            }
+        }
+        else if (id == partialsChunk && chunkSize >= 2 * (int)sizeof(int) + (int)sizeof(float)) {
+            partials.tuning = (PartialTuning)juce::jlimit(0, tuningNames.size() - 1, stream.readInt());
+            partials.stretch = stream.readFloat();
+            const int count = juce::jmin(stream.readInt(), 
+                (chunkSize - 2 * (int)sizeof(int) - (int)sizeof(float)) / (int)sizeof(float));
+            for (int i = 0; i < count; ++i) {
+                const auto ratio = stream.readFloat();
+                if (i < NO_ADDSYNTH_VOICES) {
+                    partials.custom[i] = ratio;
+                }
+            }
+        }
+        else if (id == modulationChunk) {
+            if (!readModulation(stream, chunkEnd, modulation)) {
+                return false;
+            }
+        }
+        stream.setPosition(chunkEnd);
+    }
+    return true;
+}
+
+bool SynthPreset::saveToFile(const juce::File& file) const {
+    return toXml()->writeTo(file);
+}
+
+bool SynthPreset::loadFromFile(const juce::File& file) {
+    auto xml = juce::parseXML(file);
+    return xml != nullptr && fromXml(*xml);
+}
+
+void SynthPreset::applyTo(AdditiveSynth& synth, bool offline) const {
+    for (auto voice : synth.getVoices()) {
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            voice->getHarmProcessor()->setHarmGain(i, harmonicGains[i]);
+        }
+        voice->setAdsrParameters(attack, decay, sustain, release);
+        voice->setPhi(phi);
+        voice->setTheta(theta);
+        voice->setRotationMode(rotationMode);
+        voice->setSpinDimension(spinDimension);
+        voice->setUnison(unisonVoices, unisonDetune, unisonSpread);
+        voice->setPartialRatios(partials);
+        voice->setOscillatorEngine(oscillatorEngine);
+        voice->setInterpolation(offline ? offlineInterpolation : interpolation);
+    }
+    synth.setBakedWaveformEnabled(bakedWaveform);
+    synth.setModulation(modulation);
+}
+
+} // namespace cw::synth
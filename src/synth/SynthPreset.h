@@ -0,0 +1,79 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "AdditiveSynth.h"
+
+namespace cw::synth {
+
+/**
+ * The sound defining parameters of the synth, independent of the plugin and its parameter objects, so that a sound
+ * can be stored, loaded and applied to a synth running without a host. The defaults are the defaults of the plugin
+ * parameters; the XML attributes use the parameter IDs of the plugin.
+ */
+struct SynthPreset {
+    std::array<float, NO_ADDSYNTH_VOICES> harmonicGains{ 1.f };
+    float attack{ 0.f };
+    float decay{ 0.5f };
+    float sustain{ 0.5f };
+    float release{ 0.1f };
+    float phi{ 0.f };
+    float theta{ 0.f };
+    RotationMode rotationMode{ RotationMode::generators };
+    // the dimension of the spin rotation, or SelectableSpinRotation::classic
+    int spinDimension{ SelectableSpinRotation::classic };
+    // whether the harmonics are played as a baked waveform, see AdditiveSynth::setBakedWaveformEnabled
+    bool bakedWaveform{ false };
+    // how the partials are computed, see HarmonicSoundProcessor::setOscillatorEngine
+    OscillatorEngine oscillatorEngine{ OscillatorEngine::table };
+    // the interpolation of the sound while playing live and while rendering offline, see applyTo
+    TableInterpolation interpolation{ TableInterpolation::linear };
+    TableInterpolation offlineInterpolation{ TableInterpolation::linear };
+    // the frequencies of the partials, see HarmonicSoundProcessor::setPartialRatios
+    PartialRatios partials;
+    // the number of detuned copies of each note, their detune in cents and their spread, see AddSynthVoice::setUnison
+    int unisonVoices{ 1 };
+    float unisonDetune{ 15.f };
+    float unisonSpread{ 0.5f };
+    // LFOs and envelopes routed to the angles and harmonic gains, see AdditiveSynth::setModulation
+    ModulationSettings modulation;
+
+    std::unique_ptr<juce::XmlElement> toXml() const;
+    // Missing attributes keep their current values. Returns false if the element is not a preset.
+    bool fromXml(const juce::XmlElement& xml);
+
+    /*
+    * Compact binary format, as used for the plugin state: a magic number and version, followed by chunks with an ID
+    * and a size. Readers skip unknown chunks and keep the current values for missing ones, so that later versions
+    * can add chunks (e.g. partial tables) without breaking older states.
+    */
+    void writeBinary(juce::OutputStream& stream) const;
+    // Returns false if the data is not a preset or is truncated; the preset may then be partly updated.
+    bool readBinary(const void* data, size_t sizeInBytes);
+
+    bool saveToFile(const juce::File& file) const;
+    bool loadFromFile(const juce::File& file);
+
+    // Sets the parameters of all voices of the synth, for rendering offline or live.
+    void applyTo(AdditiveSynth& synth, bool offline = false) const;
+};
+
+} // namespace cw::synth
@@ -0,0 +1,323 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Batch renderer for sample libraries. Renders every combination of preset, MIDI note, velocity and duration given
+    in a JSON manifest into its own WAV file, with the silence at the start and the end trimmed. The jobs are
+    independent and are spread over a thread pool; each worker owns one synth instance, and all instances play the
+    same shared, read-only sound tables.
+
+    Manifest example:
+
+    {
+        "outputDir": "samples",
+        "sampleRate": 48000,
+        "bitsPerSample": 24,
+        "presets": [ { "name": "pad", "file": "pad.xml" }, { "name": "default" } ],
+        "notes": { "from": 36, "to": 96, "step": 3 },
+        "velocities": [ 0.5, 1.0 ],
+        "durations": [ 0.5, 2.0 ],
+        "maxTail": 4.0,
+        "silenceThreshold": -90
+    }
+
+    Notes may also be given as an array. Presets without a file use the default parameters; relative paths are
+    relative to the manifest. Durations are the times the key is held, in seconds; after that, the release is 
+    rendered until the voice has stopped, but at most for maxTail seconds.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <iostream>
+#include "../synth/AdditiveSynth.h"
+#include "../synth/SynthPreset.h"
+
+namespace {
+
+struct NamedPreset {
+    juce::String name;
+    cw::synth::SynthPreset preset;
+};
+
+struct Manifest {
+    juce::File outputDir;
+    double sampleRate{ 44100. };
+    int bitsPerSample{ 24 };
+    std::vector<NamedPreset> presets;
+    std::vector<int> notes;
+    std::vector<float> velocities{ 1.f };
+    std::vector<double> durations{ 1. };
+    double maxTail{ 4. };
+    double silenceThreshold{ -90. };
+};
+
+// One sample of the library.
+struct BatchJob {
+    const NamedPreset* preset;
+    int note;
+    float velocity;
+    double duration;
+};
+
+constexpr int blockSize = 512;
+
+bool parseManifest(const juce::File& file, Manifest& manifest, juce::String& error) {
+    const auto json = juce::JSON::parse(file.loadFileAsString());
+    if (!json.isObject()) {
+        error = "The manifest is not a JSON object.";
+        return false;
+    }
+    const auto baseDir = file.getParentDirectory();
+
+    manifest.outputDir = baseDir.getChildFile(json.getProperty("outputDir", "samples").toString());
+    manifest.sampleRate = json.getProperty("sampleRate", manifest.sampleRate);
+    manifest.bitsPerSample = json.getProperty("bitsPerSample", manifest.bitsPerSample);
+    manifest.maxTail = json.getProperty("maxTail", manifest.maxTail);
+    manifest.silenceThreshold = json.getProperty("silenceThreshold", manifest.silenceThreshold);
+
+    if (auto* presets = json.getProperty("presets", {}).getArray()) {
+        for (const auto& entry : *presets) {
+            NamedPreset preset{ entry.getProperty("name", "preset" + juce::String((int)manifest.presets.size()))
+                .toString(), {} };
+            const auto presetFile = entry.getProperty("file", {}).toString();
+            if (presetFile.isNotEmpty() && !preset.preset.loadFromFile(baseDir.getChildFile(presetFile))) {
+                error = "Could not read the preset " + presetFile;
+                return false;
+            }
+            manifest.presets.push_back(preset);
+        }
+    }
+    if (manifest.presets.empty()) {
+        manifest.presets.push_back({ "default", {} });
+    }
+
+    const auto notes = json.getProperty("notes", {});
+    if (auto* noteArray = notes.getArray()) {
+        for (const auto& note : *noteArray) {
+            manifest.notes.push_back((int)note);
+        }
+    }
+    else if (notes.isObject()) {
+        const int step = juce::jmax(1, (int)notes.getProperty("step", 1));
+        for (int note = notes.getProperty("from", 60); note <= (int)notes.getProperty("to", 60); note += step) {
+            manifest.notes.push_back(note);
+        }
+    }
+    if (auto* velocities = json.getProperty("velocities", {}).getArray()) {
+        manifest.velocities.clear();
+        for (const auto& velocity : *velocities) {
+            manifest.velocities.push_back((float)(double)velocity);
+        }
+    }
+    if (auto* durations = json.getProperty("durations", {}).getArray()) {
+        manifest.durations.clear();
+        for (const auto& duration : *durations) {
+            manifest.durations.push_back(duration);
+        }
+    }
+
+    if (manifest.notes.empty() || manifest.velocities.empty() || manifest.durations.empty()) {
+        error = "The manifest contains no notes, velocities or durations.";
+        return false;
+    }
+    if (manifest.sampleRate <= 0. || manifest.maxTail < 0. || (manifest.bitsPerSample != 16
+        && manifest.bitsPerSample != 24 && manifest.bitsPerSample != 32)) {
+        error = "Invalid sample rate, bits per sample or tail length.";
+        return false;
+    }
+    return true;
+}
+
+juce::String getFileName(const BatchJob& job) {
+    return job.preset->name + "_" + juce::String(job.note) + "_v" + juce::String(juce::roundToInt(job.velocity * 127))
+        + "_d" + juce::String(juce::roundToInt(job.duration * 1000)) + ".wav";
+}
+
+/*
+* Renders one note into the buffer, which is resized to the rendered length: until the voice has stopped after the
+* key was released, but at most maxTail seconds after that. Returns false if the baked waveform was not ready in time,
+* as the note would not sound like the preset.
+*/
+bool renderNote(cw::synth::AdditiveSynth& synth, const BatchJob& job, const Manifest& manifest,
+    juce::AudioBuffer<float>& buffer) {
+    synth.reset();
+    job.preset->preset.applyTo(synth, true);
+    if (job.preset->preset.bakedWaveform && !synth.waitForBakedWaveform(5000)) {
+        return false;
+    }
+
+    const auto noteOffPosition = (int)std::round(job.duration * manifest.sampleRate);
+    const auto maxLength = noteOffPosition + (int)std::ceil(manifest.maxTail * manifest.sampleRate);
+    buffer.setSize(2, maxLength, false, false, true);
+    buffer.clear();
+
+    juce::MidiBuffer blockEvents;
+    int length = 0;
+    while (length < maxLength) {
+        const int numSamples = juce::jmin(blockSize, maxLength - length);
+        blockEvents.clear();
+        if (length == 0) {
+            blockEvents.addEvent(juce::MidiMessage::noteOn(1, job.note, job.velocity), 0);
+        }
+        if (noteOffPosition >= length && noteOffPosition < length + numSamples) {
+            blockEvents.addEvent(juce::MidiMessage::noteOff(1, job.note), noteOffPosition - length);
+        }
+
+        synth.setMidiBuffer(blockEvents);
+        synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, length, numSamples));
+        length += numSamples;
+
+        const auto& voices = synth.getVoices();
+        const bool anyActive = std::any_of(voices.begin(), voices.end(),
+            [](const cw::synth::AddSynthVoice* voice) { return voice->isVoiceActive(); });
+        if (length > noteOffPosition && !anyActive) {
+            break;
+        }
+    }
+    buffer.setSize(2, length, true, false, true);
+    return true;
+}
+
+// Returns the range of the buffer between the first and the last sample above the threshold.
+juce::Range<int> findNonSilentRange(const juce::AudioBuffer<float>& buffer, float threshold) {
+    int first = buffer.getNumSamples();
+    int last = -1;
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+        const auto* data = buffer.getReadPointer(channel);
+        for (int i = 0; i < first; ++i) {
+            if (std::abs(data[i]) > threshold) {
+                first = i;
+                break;
+            }
+        }
+        for (int i = buffer.getNumSamples(); --i > last;) {
+            if (std::abs(data[i]) > threshold) {
+                last = i;
+                break;
+            }
+        }
+    }
+    return last >= first ? juce::Range<int>(first, last + 1) : juce::Range<int>();
+}
+
+bool writeWav(const juce::File& file, const juce::AudioBuffer<float>& buffer, juce::Range<int> range,
+    const Manifest& manifest) {
+    file.deleteFile();
+    auto outStream = file.createOutputStream();
+    if (outStream == nullptr) {
+        return false;
+    }
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(outStream.get(), manifest.sampleRate,
+        2, manifest.bitsPerSample, {}, 0));
+    if (writer == nullptr) {
+        return false;
+    }
+    // the writer owns the stream from now on
+    outStream.release();
+    return writer->writeFromAudioSampleBuffer(buffer, range.getStart(), range.getLength());
+}
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_Batch <manifest.json> [options]\n"
+        << "  --threads=<n>      number of threads (default: number of CPUs)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || args.size() == 0 || args[0].isOption()) {
+        printUsage();
+        return args.containsOption("--help|-h") ? 0 : 1;
+    }
+
+    const int numThreads = args.containsOption("--threads")
+        ? args.getValueForOption("--threads").getIntValue() : juce::SystemStats::getNumCpus();
+    if (numThreads <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    Manifest manifest;
+    juce::String error;
+    if (!parseManifest(args[0].resolveAsExistingFile(), manifest, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    if (!manifest.outputDir.createDirectory()) {
+        std::cerr << "Could not create " << manifest.outputDir.getFullPathName() << "\n";
+        return 1;
+    }
+
+    std::vector<BatchJob> jobs;
+    for (const auto& preset : manifest.presets) {
+        for (auto note : manifest.notes) {
+            for (auto velocity : manifest.velocities) {
+                for (auto duration : manifest.durations) {
+                    jobs.push_back({ &preset, note, velocity, duration });
+                }
+            }
+        }
+    }
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    const auto threshold = juce::Decibels::decibelsToGain((float)manifest.silenceThreshold);
+    std::atomic<size_t> nextJob{ 0 };
+    std::atomic<int> numFailed{ 0 };
+    {
+        // one job per worker, each with its own synth, which takes the samples from the list until it is empty
+        juce::ThreadPool pool(numThreads);
+        std::atomic<int> numRunning{ numThreads };
+        juce::WaitableEvent allDone;
+        for (int worker = 0; worker < numThreads; ++worker) {
+            pool.addJob([&]() {
+                cw::synth::AdditiveSynth synth;
+                synth.prepareToPlay(blockSize, manifest.sampleRate);
+                juce::AudioBuffer<float> buffer;
+
+                for (auto index = nextJob++; index < jobs.size(); index = nextJob++) {
+                    const auto& job = jobs[index];
+                    const auto file = manifest.outputDir.getChildFile(getFileName(job));
+                    if (!renderNote(synth, job, manifest, buffer)) {
+                        std::cerr << "Timed out baking the waveform for " << file.getFullPathName() << "\n";
+                        ++numFailed;
+                    }
+                    else if (!writeWav(file, buffer, findNonSilentRange(buffer, threshold), manifest)) {
+                        std::cerr << "Could not write " << file.getFullPathName() << "\n";
+                        ++numFailed;
+                    }
+                }
+                if (--numRunning == 0) {
+                    allDone.signal();
+                }
+            });
+        }
+        allDone.wait();
+    }
+    const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    std::cout << "Rendered " << (int)jobs.size() - numFailed << " of " << jobs.size() << " samples in " << seconds
+        << " s on " << numThreads << " threads to " << manifest.outputDir.getFullPathName() << "\n";
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <iostream>
+#include <vector>
+
+namespace cw::tools {
+
+/**
+ * Result of a single benchmark case. Times are wall clock times of one call of the benchmarked body.
+ */
+struct BenchResult {
+    juce::String name;
+    juce::int64 iterations;
+    double nanosPerIteration;
+    double itemsPerSecond;
+};
+
+/**
+ * A minimal benchmark harness. Each case is run repeatedly, with a growing number of iterations, until the measured
+ * time exceeds the minimum time. The results can be written as JSON in the format of Google Benchmark, so that its 
+ * comparison scripts can be used to compare results across commits.
+ */
+class BenchRunner {
+    public:
+        BenchRunner(double minSeconds, const juce::String& filter) : minSeconds(minSeconds), filter(filter) {}
+
+        /**
+         * Runs the body repeatedly and records the result under the given name. The body is expected to process 
+         * itemsPerCall items (samples, mostly) per call. Cases not matching the filter are skipped.
+         */
+        template <typename Body>
+        void run(const juce::String& name, juce::int64 itemsPerCall, Body&& body) {
+            if (filter.isNotEmpty() && !name.contains(filter)) {
+                return;
+            }
+
+            // warm-up, so that lazily allocated buffers and caches are in place
+            body();
+
+            juce::int64 iterations = 1;
+            double seconds = 0.;
+            for (;;) {
+                const auto startTicks = juce::Time::getHighResolutionTicks();
+                for (juce::int64 i = 0; i < iterations; ++i) {
+                    body();
+                }
+                seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+                if (seconds >= minSeconds || iterations >= maxIterations) {
+                    break;
+                }
+                // aim slightly above the minimum time, but never grow by more than a factor of 10 at once
+                const double factor = seconds > 0. ? minSeconds * 1.4 / seconds : 10.;
+                iterations = juce::jmin(maxIterations, (juce::int64)(iterations * juce::jlimit(2., 10., factor)));
+            }
+
+            BenchResult result{ name, iterations, seconds * 1e9 / iterations,
+                seconds > 0. ? itemsPerCall * iterations / seconds : 0. };
+            results.push_back(result);
+            printResult(result);
+        }
+
+        // Returns all results in the JSON format of Google Benchmark.
+        juce::String toJson() const {
+            auto* context = new juce::DynamicObject();
+            context->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+            context->setProperty("host_name", juce::SystemStats::getComputerName());
+            context->setProperty("num_cpus", juce::SystemStats::getNumCpus());
+            context->setProperty("mhz_per_cpu", juce::SystemStats::getCpuSpeedInMegahertz());
+            context->setProperty("cpu_model", juce::SystemStats::getCpuModel());
+           #if JUCE_DEBUG
+            context->setProperty("library_build_type", "debug");
+           #else
+            context->setProperty("library_build_type", "release");
+           #endif
+
+            juce::Array<juce::var> benchmarks;
+            for (const auto& result : results) {
+                auto* entry = new juce::DynamicObject();
+                entry->setProperty("name", result.name);
+                entry->setProperty("run_type", "iteration");
+                entry->setProperty("iterations", result.iterations);
+                entry->setProperty("real_time", result.nanosPerIteration);
+                entry->setProperty("cpu_time", result.nanosPerIteration);
+                entry->setProperty("time_unit", "ns");
+                entry->setProperty("items_per_second", result.itemsPerSecond);
+                benchmarks.add(juce::var(entry));
+            }
+
+            auto* root = new juce::DynamicObject();
+            root->setProperty("context", juce::var(context));
+            root->setProperty("benchmarks", benchmarks);
+            return juce::JSON::toString(juce::var(root));
+        }
+
+    private:
+        const juce::int64 maxIterations{ 1000000000 };
+        double minSeconds;
+        juce::String filter;
+        std::vector<BenchResult> results;
+
+        static void printResult(const BenchResult& result) {
+            std::cerr << result.name << ": " << result.nanosPerIteration << " ns/iteration, "
+                << result.itemsPerSecond << " items/s (" << result.iterations << " iterations)\n";
+        }
+};
+
+/**
+ * Keeps the compiler from optimizing away a computation whose result is otherwise unused.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    static volatile T sink;
+    sink = value;
+}
+
+} // namespace cw::tools
@@ -0,0 +1,280 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Golden render regression check. Renders a fixed set of scenarios through the synth core and compares each 
+    rendering with a stored reference rendering. For every scenario, the maximum absolute error, the RMS error and the
+    spectral difference are reported; the exit code is one if any scenario exceeds the tolerances. This makes it
+    possible to accept approximations of the DSP code, knowing how far they drift from the reference.
+
+    The references are written with --update, as 32 bit float WAV files.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "RenderComparison.h"
+#include "RenderScenario.h"
+
+namespace {
+
+/**
+ * A scenario of the regression check. Changing any of these invalidates the stored references.
+ */
+struct GoldenCase {
+    juce::String name;
+    cw::tools::RenderSettings settings;
+    float phi;
+    float theta;
+    cw::synth::RotationMode rotationMode{ cw::synth::RotationMode::generators };
+    int spinDimension{ cw::synth::SelectableSpinRotation::classic };
+    cw::synth::ModulationSettings modulation{};
+    cw::synth::PartialRatios partials{};
+    cw::synth::OscillatorEngine engine{ cw::synth::OscillatorEngine::table };
+    // voices, detune in cents and spread of the unison
+    int unisonVoices{ 1 };
+    float unisonDetune{ 0.f };
+    float unisonSpread{ 0.f };
+};
+
+std::vector<GoldenCase> createGoldenCases() {
+    using cw::tools::ScenarioType;
+
+    auto makeCase = [](const juce::String& name, ScenarioType scenario, double sampleRate, int blockSize,
+        int numPartials, float phi, float theta, bool baked = false) {
+        GoldenCase golden{ name, {}, phi, theta };
+        golden.settings.scenario = scenario;
+        golden.settings.sampleRate = sampleRate;
+        golden.settings.blockSize = blockSize;
+        golden.settings.lengthSeconds = 3.;
+        golden.settings.numPartials = numPartials;
+        golden.settings.bakedWaveform = baked;
+        return golden;
+    };
+
+    std::vector<GoldenCase> cases{
+        makeCase("chords", ScenarioType::chords, 44100., 512, NO_ADDSYNTH_VOICES, 0.f, 0.f),
+        makeCase("chords_rotated", ScenarioType::chords, 44100., 512, NO_ADDSYNTH_VOICES, 0.7f, 1.3f),
+        makeCase("arpeggio_small_blocks", ScenarioType::arpeggio, 48000., 37, NO_ADDSYNTH_VOICES, 2.1f, 0.4f),
+        makeCase("sweep_few_partials", ScenarioType::polyphonySweep, 96000., 1024, 4, 0.f, 0.f),
+        makeCase("sweep_single_partial", ScenarioType::polyphonySweep, 44100., 256, 1, 1.f, 2.f),
+        makeCase("chords_baked", ScenarioType::chords, 48000., 512, NO_ADDSYNTH_VOICES, 0.7f, 1.3f, true)
+    };
+
+    auto unitary = makeCase("chords_unitary", ScenarioType::chords, 44100., 512, NO_ADDSYNTH_VOICES, 0.7f, 1.3f);
+    unitary.rotationMode = cw::synth::RotationMode::unitary;
+    cases.push_back(unitary);
+
+    auto spin = makeCase("arpeggio_spin_5_2", ScenarioType::arpeggio, 48000., 512, NO_ADDSYNTH_VOICES, 2.1f, 0.4f);
+    spin.spinDimension = 6;
+    cases.push_back(spin);
+
+    // all kinds of sources and targets, with blocks which do not match the control interval
+    using namespace cw::synth;
+    auto modulated = makeCase("chords_modulated", ScenarioType::chords, 44100., 100, NO_ADDSYNTH_VOICES, 0.7f, 1.3f);
+    auto& modulation = modulated.modulation;
+    modulation.lfos[0] = { LfoShape::sine, 0.5f, 0.f };
+    modulation.lfos[1] = { LfoShape::triangle, 2.f, 0.25f };
+    modulation.lfos[2] = { LfoShape::square, 4.f, 0.f };
+    modulation.envelopes[0] = { 0.3f, 0.5f, 0.2f, 0.4f };
+    modulation.addRoute({ ModulationSource::lfo, 0, ModulationTarget::phi, 0, 0.8f });
+    modulation.addRoute({ ModulationSource::lfo, 1, ModulationTarget::theta, 0, 0.5f });
+    modulation.addRoute({ ModulationSource::lfo, 2, ModulationTarget::harmonicGain, 1, 0.3f });
+    modulation.addRoute({ ModulationSource::envelope, 0, ModulationTarget::harmonicGain, 2, 0.6f });
+    cases.push_back(modulated);
+
+    auto unison = makeCase("chords_unison", ScenarioType::chords, 44100., 512, NO_ADDSYNTH_VOICES, 0.7f, 1.3f);
+    unison.unisonVoices = 7;
+    unison.unisonDetune = 20.f;
+    unison.unisonSpread = 0.8f;
+    cases.push_back(unison);
+
+    auto hermite = makeCase("arpeggio_hermite", ScenarioType::arpeggio, 48000., 512, NO_ADDSYNTH_VOICES, 2.1f, 0.4f);
+    hermite.settings.interpolation = TableInterpolation::hermite;
+    cases.push_back(hermite);
+
+    auto lagrange = makeCase("sweep_lagrange", ScenarioType::polyphonySweep, 44100., 256, 4, 1.f, 2.f);
+    lagrange.settings.interpolation = TableInterpolation::lagrange;
+    cases.push_back(lagrange);
+
+    auto bell = makeCase("arpeggio_bell", ScenarioType::arpeggio, 48000., 512, NO_ADDSYNTH_VOICES, 0.f, 0.f);
+    bell.partials.tuning = PartialTuning::bell;
+    cases.push_back(bell);
+
+    auto polynomial = makeCase("chords_polynomial7", ScenarioType::chords, 44100., 512, NO_ADDSYNTH_VOICES, 0.7f, 1.3f);
+    polynomial.engine = OscillatorEngine::polynomial7;
+    cases.push_back(polynomial);
+
+    auto phasor = makeCase("arpeggio_phasor", ScenarioType::arpeggio, 48000., 37, NO_ADDSYNTH_VOICES, 2.1f, 0.4f);
+    phasor.engine = OscillatorEngine::phasor;
+    cases.push_back(phasor);
+
+    // a host looping at every block, rendered in whole chunks one chunk ahead
+    auto quantum = makeCase("chords_quantum32", ScenarioType::chords, 44100., 256, NO_ADDSYNTH_VOICES, 0.7f, 1.3f);
+    quantum.settings.quantum = 32;
+    quantum.settings.quantumBuffered = true;
+    quantum.settings.irregularBlocks = true;
+    cases.push_back(quantum);
+    return cases;
+}
+
+juce::AudioBuffer<float> renderCase(const GoldenCase& golden) {
+    cw::synth::AdditiveSynth synth;
+    cw::tools::applyDefaultParameters(synth, golden.settings.numPartials);
+    for (auto voice : synth.getVoices()) {
+        voice->setPhi(golden.phi);
+        voice->setTheta(golden.theta);
+        voice->setRotationMode(golden.rotationMode);
+        voice->setSpinDimension(golden.spinDimension);
+        voice->setUnison(golden.unisonVoices, golden.unisonDetune, golden.unisonSpread);
+        voice->setPartialRatios(golden.partials);
+        voice->setOscillatorEngine(golden.engine);
+    }
+    synth.setModulation(golden.modulation);
+
+    const auto totalSamples = (int)(golden.settings.lengthSeconds * golden.settings.sampleRate);
+    juce::AudioBuffer<float> result(2, totalSamples);
+    int position = 0;
+    cw::tools::renderScenario(synth, cw::tools::createScenario(golden.settings), golden.settings,
+        [&result, &position](const juce::AudioBuffer<float>& block, int numSamples) {
+            for (int channel = 0; channel < result.getNumChannels(); ++channel) {
+                result.copyFrom(channel, position, block, channel, 0, numSamples);
+            }
+            position += numSamples;
+        });
+    return result;
+}
+
+bool writeReference(const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate) {
+    file.deleteFile();
+    auto outStream = file.createOutputStream();
+    if (outStream == nullptr) {
+        return false;
+    }
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(outStream.get(), sampleRate,
+        (unsigned int)buffer.getNumChannels(), 32, {}, 0));
+    if (writer == nullptr) {
+        return false;
+    }
+    // the writer owns the stream from now on
+    outStream.release();
+    return writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+}
+
+bool readReference(const juce::File& file, juce::AudioBuffer<float>& buffer) {
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatReader> reader(wavFormat.createReaderFor(file.createInputStream().release(),
+        true));
+    if (reader == nullptr) {
+        return false;
+    }
+    buffer.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+    return reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
+}
+
+void printUsage() {
+    const cw::tools::RenderTolerances defaults;
+    std::cout << "Usage: Additive_Synth_Golden [options]\n"
+        << "  --refs=<dir>            directory of the reference renderings (default: golden)\n"
+        << "  --update                render the references instead of comparing with them\n"
+        << "  --filter=<text>         only use scenarios whose name contains the text\n"
+        << "  --max-abs=<value>       tolerance of the maximum absolute error (default: " << defaults.maxAbsError
+        << ")\n"
+        << "  --max-rms=<value>       tolerance of the RMS error (default: " << defaults.rmsError << ")\n"
+        << "  --max-spectral=<dB>     tolerance of the spectral difference (default: "
+        << defaults.spectralDifferenceDb << ")\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+
+    const auto refsDir = juce::File::getCurrentWorkingDirectory().getChildFile(args.containsOption("--refs")
+        ? args.getValueForOption("--refs") : "golden");
+    const bool update = args.containsOption("--update");
+    const auto filter = args.getValueForOption("--filter");
+
+    cw::tools::RenderTolerances tolerances;
+    if (args.containsOption("--max-abs")) {
+        tolerances.maxAbsError = args.getValueForOption("--max-abs").getDoubleValue();
+    }
+    if (args.containsOption("--max-rms")) {
+        tolerances.rmsError = args.getValueForOption("--max-rms").getDoubleValue();
+    }
+    if (args.containsOption("--max-spectral")) {
+        tolerances.spectralDifferenceDb = args.getValueForOption("--max-spectral").getDoubleValue();
+    }
+
+    if (update && !refsDir.createDirectory()) {
+        std::cerr << "Could not create " << refsDir.getFullPathName() << "\n";
+        return 1;
+    }
+
+    int numFailed = 0;
+    for (const auto& golden : createGoldenCases()) {
+        if (filter.isNotEmpty() && !golden.name.contains(filter)) {
+            continue;
+        }
+        const auto rendered = renderCase(golden);
+        const auto refFile = refsDir.getChildFile(golden.name + ".wav");
+
+        if (update) {
+            if (!writeReference(refFile, rendered, golden.settings.sampleRate)) {
+                std::cerr << "Could not write " << refFile.getFullPathName() << "\n";
+                return 1;
+            }
+            std::cout << golden.name << ": written\n";
+            continue;
+        }
+
+        juce::AudioBuffer<float> reference;
+        if (!readReference(refFile, reference)) {
+            std::cout << golden.name << ": FAILED (no reference at " << refFile.getFullPathName() << ")\n";
+            ++numFailed;
+            continue;
+        }
+
+        const auto difference = cw::tools::compareRenders(rendered, reference);
+        const bool passed = tolerances.accepts(difference);
+        numFailed += passed ? 0 : 1;
+        std::cout << golden.name << ": " << (passed ? "ok" : "FAILED");
+        if (difference.sizeMismatch) {
+            std::cout << " (length or channel count differs)\n";
+        }
+        else {
+            std::cout << " (max abs " << difference.maxAbsError << ", rms " << difference.rmsError
+                << ", spectral " << difference.spectralDifferenceDb << " dB)\n";
+        }
+    }
+
+    if (!update) {
+        std::cout << (numFailed == 0 ? "All scenarios within tolerance.\n"
+            : juce::String(numFailed) + " scenario(s) out of tolerance.\n");
+    }
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Harmonic analysis. Derives the harmonic gains of the synth from recordings: for each audio file, the pitch of
+    every frame is detected and the amplitudes of its first NO_ADDSYNTH_VOICES partials are measured in the spectrum.
+    The amplitudes, averaged over all pitched frames and so weighted by their level, are written as a preset, which the
+    other tools load with --preset and which the plugin loads as its state (--binary).
+
+    The files are read in segments of frames, and the segments of all files are spread over a thread pool, so that
+    a sample library keeps all cores busy, as does a single long file. Each worker streams its segment from the file
+    in batches of frames; memory use does not depend on the length of the files.
+
+    Per frame, one FFT of the Hann-windowed, zero-padded frame yields both the spectrum and, by transforming the power
+    spectrum back, the autocorrelation for the pitch detection.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <iostream>
+#include "../synth/SynthPreset.h"
+
+namespace {
+
+constexpr int fftOrder = 13;
+constexpr int fftSize = 1 << fftOrder;
+// frames are zero-padded to twice their length, so that the autocorrelation does not wrap around
+constexpr int frameSize = fftSize / 2;
+constexpr int hopSize = frameSize / 2;
+// frames read from the file at once, and frames per job of the thread pool
+constexpr int framesPerBatch = 64;
+constexpr int framesPerSegment = 1024;
+
+struct AnalysisSettings {
+    double minFrequency{ 40. };
+    double maxFrequency{ 2000. };
+    // frames below this RMS level in dB are skipped
+    double silenceThreshold{ -60. };
+    // frames with a lower normalized autocorrelation at the detected period are taken as unpitched and skipped
+    double minConfidence{ 0.6 };
+};
+
+struct SourceFile {
+    juce::File file;
+    double sampleRate;
+    juce::int64 length;
+    int numFrames;
+};
+
+// A range of frames of one file, analyzed by one job.
+struct SegmentJob {
+    int fileIndex;
+    int firstFrame;
+    int numFrames;
+};
+
+// The sums over the pitched frames of a segment or file.
+struct AnalysisResult {
+    // the sum of the RMS levels of the frames
+    double weight{ 0. };
+    std::array<double, NO_ADDSYNTH_VOICES> partials{};
+    // the detected pitch of each pitched frame with its RMS level
+    std::vector<std::pair<float, float>> pitches;
+
+    void add(const AnalysisResult& other) {
+        weight += other.weight;
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            partials[i] += other.partials[i];
+        }
+        pitches.insert(pitches.end(), other.pitches.begin(), other.pitches.end());
+    }
+
+    // The pitch below which half of the frames lie, weighted by their level.
+    float getMedianPitch() {
+        std::sort(pitches.begin(), pitches.end());
+        double sum = 0.;
+        for (const auto& pitch : pitches) {
+            sum += pitch.second;
+            if (sum >= 0.5 * weight) {
+                return pitch.first;
+            }
+        }
+        return pitches.empty() ? 0.f : pitches.back().first;
+    }
+};
+
+/**
+ * Detects the pitch of single frames and measures the amplitudes of their partials. Owns its working buffers, so
+ * each worker thread needs its own.
+ */
+class FrameAnalyzer {
+    public:
+        FrameAnalyzer(const AnalysisSettings& settings, double sampleRate) : settings(settings),
+            sampleRate(sampleRate), window((size_t)frameSize), windowCorrelation((size_t)frameSize),
+            buffer(2 * (size_t)fftSize), powerSpectrum(2 * (size_t)fftSize) {
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), (size_t)frameSize,
+                juce::dsp::WindowingFunction<float>::hann, false);
+
+            // the autocorrelation of the window, which scales down the autocorrelation of the frames with the lag
+            std::fill(buffer.begin(), buffer.end(), 0.f);
+            std::copy(window.begin(), window.end(), buffer.begin());
+            autocorrelate();
+            for (int lag = 0; lag < frameSize; ++lag) {
+                windowCorrelation[lag] = juce::jmax(buffer[lag], 1e-9f);
+            }
+        }
+
+        void analyze(const float* frame, AnalysisResult& result) {
+            double sumOfSquares = 0.;
+            for (int i = 0; i < frameSize; ++i) {
+                sumOfSquares += (double)frame[i] * frame[i];
+            }
+            const auto rms = std::sqrt(sumOfSquares / frameSize);
+            if (juce::Decibels::gainToDecibels((float)rms) < settings.silenceThreshold) {
+                return;
+            }
+
+            std::fill(buffer.begin(), buffer.end(), 0.f);
+            for (int i = 0; i < frameSize; ++i) {
+                buffer[i] = frame[i] * window[i];
+            }
+            fft.performRealOnlyForwardTransform(buffer.data(), true);
+            // keep the spectrum for the partials, the autocorrelation overwrites the buffer
+            std::copy(buffer.begin(), buffer.begin() + fftSize + 2, powerSpectrum.begin());
+            autocorrelateSpectrum();
+
+            float confidence;
+            const auto period = findPeriod(confidence);
+            if (period <= 0. || confidence < settings.minConfidence) {
+                return;
+            }
+
+            const auto pitch = sampleRate / period;
+            const auto binsPerHarmonic = pitch * fftSize / sampleRate;
+            for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                result.partials[harm] += findPeak(binsPerHarmonic * (harm + 1));
+            }
+            result.weight += rms;
+            result.pitches.push_back({ (float)pitch, (float)rms });
+        }
+
+    private:
+        const AnalysisSettings& settings;
+        const double sampleRate;
+        juce::dsp::FFT fft{ fftOrder };
+        std::vector<float> window;
+        std::vector<float> windowCorrelation;
+        std::vector<float> buffer;
+        // the spectrum of the current frame, as complex pairs
+        std::vector<float> powerSpectrum;
+
+        // Replaces the signal in the buffer by its autocorrelation.
+        void autocorrelate() {
+            fft.performRealOnlyForwardTransform(buffer.data(), true);
+            autocorrelateSpectrum();
+        }
+
+        // Replaces the spectrum in the buffer by the autocorrelation of the signal, via the power spectrum.
+        void autocorrelateSpectrum() {
+            for (int bin = 0; bin <= fftSize / 2; ++bin) {
+                const auto re = buffer[2 * (size_t)bin];
+                const auto im = buffer[2 * (size_t)bin + 1];
+                buffer[2 * (size_t)bin] = re * re + im * im;
+                buffer[2 * (size_t)bin + 1] = 0.f;
+            }
+            std::fill(buffer.begin() + fftSize + 2, buffer.end(), 0.f);
+            fft.performRealOnlyInverseTransform(buffer.data());
+        }
+
+        /*
+        * Returns the period in samples from the autocorrelation in the buffer, or 0. The shortest period whose peak 
+        * comes close to the highest one wins, which avoids detecting an octave too low.
+        */
+        double findPeriod(float& confidence) const {
+            const auto energy = buffer[0] / windowCorrelation[0];
+            confidence = 0.f;
+            if (energy <= 0.f) {
+                return 0.;
+            }
+            const auto normalized = [this, energy](int lag) {
+                return buffer[(size_t)lag] / windowCorrelation[(size_t)lag] / energy;
+            };
+
+            const int minLag = juce::jmax(2, (int)(sampleRate / settings.maxFrequency));
+            const int maxLag = juce::jmin(frameSize / 2, (int)(sampleRate / settings.minFrequency));
+            float highest = 0.f;
+            for (int lag = minLag; lag <= maxLag; ++lag) {
+                highest = juce::jmax(highest, normalized(lag));
+            }
+            for (int lag = minLag; lag <= maxLag; ++lag) {
+                const auto value = normalized(lag);
+                if (value >= 0.9f * highest && value >= normalized(lag - 1) && value >= normalized(lag + 1)) {
+                    // parabolic interpolation around the peak
+                    const auto left = normalized(lag - 1);
+                    const auto right = normalized(lag + 1);
+                    const auto curvature = left - 2.f * value + right;
+                    const auto offset = curvature < 0.f ? 0.5f * (left - right) / curvature : 0.f;
+                    confidence = value;
+                    return lag + offset;
+                }
+            }
+            return 0.;
+        }
+
+        // The highest magnitude within 2% around the given bin, allowing for slightly inharmonic partials.
+        float findPeak(double bin) const {
+            const int first = (int)std::floor(bin * 0.98);
+            const int last = (int)std::ceil(bin * 1.02);
+            float peak = 0.f;
+            for (int i = juce::jmax(first, 1); i <= juce::jmin(last, fftSize / 2); ++i) {
+                const auto re = powerSpectrum[2 * (size_t)i];
+                const auto im = powerSpectrum[2 * (size_t)i + 1];
+                peak = juce::jmax(peak, std::sqrt(re * re + im * im));
+            }
+            return peak;
+        }
+};
+
+// Streams the frames of the segment from the file in batches and analyzes them.
+bool analyzeSegment(const SourceFile& source, const SegmentJob& job, const AnalysisSettings& settings,
+    juce::AudioFormatManager& formatManager, AnalysisResult& result) {
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(source.file));
+    if (reader == nullptr) {
+        return false;
+    }
+    FrameAnalyzer analyzer(settings, source.sampleRate);
+
+    const int numChannels = (int)reader->numChannels;
+    const int batchLength = (framesPerBatch - 1) * hopSize + frameSize;
+    juce::AudioBuffer<float> batch(numChannels, batchLength);
+    std::vector<float> mono((size_t)batchLength);
+
+    for (int batchStart = 0; batchStart < job.numFrames; batchStart += framesPerBatch) {
+        const int numFrames = juce::jmin(framesPerBatch, job.numFrames - batchStart);
+        const auto startSample = (juce::int64)(job.firstFrame + batchStart) * hopSize;
+        // reading beyond the end of the file yields zeros
+        if (!reader->read(&batch, 0, batchLength, startSample, true, true)) {
+            return false;
+        }
+        std::fill(mono.begin(), mono.end(), 0.f);
+        for (int channel = 0; channel < numChannels; ++channel) {
+            const auto* data = batch.getReadPointer(channel);
+            for (int i = 0; i < batchLength; ++i) {
+                mono[(size_t)i] += data[i] / numChannels;
+            }
+        }
+        for (int frame = 0; frame < numFrames; ++frame) {
+            analyzer.analyze(mono.data() + (size_t)frame * hopSize, result);
+        }
+    }
+    return true;
+}
+
+void collectFiles(const juce::File& file, juce::AudioFormatManager& formatManager, std::vector<SourceFile>& files) {
+    if (file.isDirectory()) {
+        for (const auto& child : file.findChildFiles(juce::File::findFiles, true, "*.wav;*.aif;*.aiff;*.flac")) {
+            collectFiles(child, formatManager, files);
+        }
+        return;
+    }
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0) {
+        std::cerr << "Skipping " << file.getFullPathName() << ", not a readable audio file.\n";
+        return;
+    }
+    const auto numFrames = (int)juce::jmax((juce::int64)1, (reader->lengthInSamples - frameSize) / hopSize + 1);
+    files.push_back({ file, reader->sampleRate, reader->lengthInSamples, numFrames });
+}
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_Analyze <file or directory>... [options]\n"
+        << "  --out=<dir>           directory for the presets (default: next to each file)\n"
+        << "  --binary              write the binary plugin state instead of XML\n"
+        << "  --template=<file>     preset for all parameters but the harmonic gains\n"
+        << "  --min-freq=<Hz>       lowest pitch to detect (default: 40)\n"
+        << "  --max-freq=<Hz>       highest pitch to detect (default: 2000)\n"
+        << "  --threads=<n>         number of threads (default: number of CPUs)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || args.size() == 0 || args[0].isOption()) {
+        printUsage();
+        return args.containsOption("--help|-h") ? 0 : 1;
+    }
+
+    AnalysisSettings settings;
+    if (args.containsOption("--min-freq")) {
+        settings.minFrequency = args.getValueForOption("--min-freq").getDoubleValue();
+    }
+    if (args.containsOption("--max-freq")) {
+        settings.maxFrequency = args.getValueForOption("--max-freq").getDoubleValue();
+    }
+    const int numThreads = args.containsOption("--threads")
+        ? args.getValueForOption("--threads").getIntValue() : juce::SystemStats::getNumCpus();
+    const bool binary = args.containsOption("--binary");
+    if (numThreads <= 0 || settings.minFrequency <= 0. || settings.maxFrequency <= settings.minFrequency) {
+        printUsage();
+        return 1;
+    }
+
+    cw::synth::SynthPreset presetTemplate;
+    if (args.containsOption("--template")
+        && !presetTemplate.loadFromFile(args.getExistingFileForOption("--template"))) {
+        std::cerr << "Could not read the template preset.\n";
+        return 1;
+    }
+    const auto outDir = args.containsOption("--out")
+        ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--out")) : juce::File();
+    if (outDir != juce::File() && !outDir.createDirectory()) {
+        std::cerr << "Could not create " << outDir.getFullPathName() << "\n";
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::vector<SourceFile> files;
+    for (int i = 0; i < args.size(); ++i) {
+        if (!args[i].isOption()) {
+            collectFiles(args[i].resolveAsFile(), formatManager, files);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "No audio files to analyze.\n";
+        return 1;
+    }
+
+    std::vector<SegmentJob> jobs;
+    for (int fileIndex = 0; fileIndex < (int)files.size(); ++fileIndex) {
+        for (int frame = 0; frame < files[(size_t)fileIndex].numFrames; frame += framesPerSegment) {
+            jobs.push_back({ fileIndex, frame, juce::jmin(framesPerSegment, files[(size_t)fileIndex].numFrames - frame) });
+        }
+    }
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    std::vector<AnalysisResult> segmentResults(jobs.size());
+    std::vector<std::atomic<bool>> fileFailed(files.size());
+    std::atomic<size_t> nextJob{ 0 };
+    {
+        // one job per worker, each with its own readers, which takes the segments from the list until it is empty
+        juce::ThreadPool pool(numThreads);
+        std::atomic<int> numRunning{ numThreads };
+        juce::WaitableEvent allDone;
+        for (int worker = 0; worker < numThreads; ++worker) {
+            pool.addJob([&]() {
+                juce::AudioFormatManager workerFormatManager;
+                workerFormatManager.registerBasicFormats();
+
+                for (auto index = nextJob++; index < jobs.size(); index = nextJob++) {
+                    const auto& job = jobs[index];
+                    if (!analyzeSegment(files[(size_t)job.fileIndex], job, settings, workerFormatManager,
+                        segmentResults[index])) {
+                        fileFailed[(size_t)job.fileIndex] = true;
+                    }
+                }
+                if (--numRunning == 0) {
+                    allDone.signal();
+                }
+            });
+        }
+        allDone.wait();
+    }
+
+    // the segments of each file are consecutive in the list of jobs
+    std::vector<AnalysisResult> fileResults(files.size());
+    for (size_t index = 0; index < jobs.size(); ++index) {
+        fileResults[(size_t)jobs[index].fileIndex].add(segmentResults[index]);
+    }
+
+    int numFailed = 0;
+    juce::int64 totalSamples = 0;
+    for (size_t fileIndex = 0; fileIndex < files.size(); ++fileIndex) {
+        const auto& source = files[fileIndex];
+        auto& result = fileResults[fileIndex];
+        totalSamples += source.length;
+        if (fileFailed[fileIndex] || result.weight <= 0.) {
+            std::cerr << source.file.getFullPathName() << ": " << (fileFailed[fileIndex] ? "could not be read"
+                : "no pitched frames") << "\n";
+            ++numFailed;
+            continue;
+        }
+
+        // the strongest partial gets the full gain
+        const auto strongest = *std::max_element(result.partials.begin(), result.partials.end());
+        auto preset = presetTemplate;
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            preset.harmonicGains[i] = strongest > 0. ? (float)(result.partials[i] / strongest) : 0.f;
+        }
+
+        const auto dir = outDir != juce::File() ? outDir : source.file.getParentDirectory();
+        const auto presetFile = dir.getChildFile(source.file.getFileNameWithoutExtension()
+            + (binary ? ".bin" : ".xml"));
+        bool written;
+        if (binary) {
+            juce::MemoryOutputStream stream;
+            preset.writeBinary(stream);
+            written = presetFile.replaceWithData(stream.getData(), stream.getDataSize());
+        }
+        else {
+            written = preset.saveToFile(presetFile);
+        }
+        if (!written) {
+            std::cerr << "Could not write " << presetFile.getFullPathName() << "\n";
+            ++numFailed;
+            continue;
+        }
+
+        const auto pitch = result.getMedianPitch();
+        std::cout << source.file.getFileName() << ": " << pitch << " Hz (MIDI note "
+            << juce::roundToInt(69. + 12. * std::log2(pitch / 440.)) << "), gains";
+        for (auto gain : preset.harmonicGains) {
+            std::cout << " " << juce::String(gain, 3);
+        }
+        std::cout << "\n";
+    }
+    const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    std::cout << "Analyzed " << (int)files.size() - numFailed << " of " << files.size() << " files ("
+        << totalSamples << " samples) in " << seconds << " s on " << numThreads << " threads\n";
+    return numFailed == 0 ? 0 : 1;
+}
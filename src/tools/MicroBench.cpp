@@ -0,0 +1,587 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Microbenchmarks of the DSP hot paths. Each benchmark is parameterized by block size, number of partials, number
+    of voices and sample rate, wherever these apply. Results are printed while running and can be written as JSON
+    (Google Benchmark format) for comparisons across commits.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <array>
+#include <iostream>
+#include <memory>
+#include "BenchHarness.h"
+#include "../PluginProcessor.h"
+#include "../synth/AdditiveSynth.h"
+#include "../util/Interpolation.h"
+
+namespace {
+
+const std::vector<int> blockSizes{ 1, 4, 16, 64, 256, 1024, 4096 };
+const std::vector<int> partialCounts{ 1, 4, NO_ADDSYNTH_VOICES };
+const std::vector<int> voiceCounts{ 1, 4, ADDSYNTH_MAXPOLYPHONY };
+const std::vector<int> sampleRates{ 44100, 48000, 96000 };
+
+juce::String caseName(const juce::String& function, const juce::StringPairArray& params) {
+    auto name = function;
+    for (const auto& key : params.getAllKeys()) {
+        name << "/" << key << ":" << params[key];
+    }
+    return name;
+}
+
+void benchHarmonicSoundProcessor(cw::tools::BenchRunner& runner) {
+    for (auto sampleRate : sampleRates) {
+        for (auto numPartials : partialCounts) {
+            for (auto blockSize : blockSizes) {
+                cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+                cw::synth::HarmonicSoundProcessor processor{ generator.generate(), sampleRate };
+                for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+                    processor.setHarmGain(i, i < numPartials ? 1.f / (i + 1) : 0.f);
+                }
+
+                std::vector<float> output(blockSize);
+
+                juce::StringPairArray params;
+                params.set("block", juce::String(blockSize));
+                params.set("partials", juce::String(numPartials));
+                params.set("rate", juce::String(sampleRate));
+                runner.run(caseName("HarmonicSoundProcessor::process", params), blockSize, [&]() {
+                    processor.process(output.data(), blockSize, 1.f, 60);
+                    cw::tools::doNotOptimize(output[0]);
+                });
+            }
+        }
+    }
+}
+
+void benchOscillatorEngines(cw::tools::BenchRunner& runner) {
+    constexpr int sampleRate = 48000;
+    using cw::synth::OscillatorEngine;
+    const std::vector<std::pair<OscillatorEngine, juce::String>> engines{ { OscillatorEngine::table, "table" },
+        { OscillatorEngine::polynomial5, "poly5" }, { OscillatorEngine::polynomial7, "poly7" },
+        { OscillatorEngine::polynomial9, "poly9" }, { OscillatorEngine::phasor, "phasor" } };
+    for (const auto& [engine, engineName] : engines) {
+        for (auto blockSize : blockSizes) {
+            cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+            cw::synth::HarmonicSoundProcessor processor{ generator.generate(), sampleRate };
+            for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+                processor.setHarmGain(i, 1.f / (i + 1));
+            }
+            processor.setOscillatorEngine(engine);
+
+            std::vector<float> output(blockSize);
+
+            juce::StringPairArray params;
+            params.set("block", juce::String(blockSize));
+            params.set("engine", engineName);
+            params.set("rate", juce::String(sampleRate));
+            runner.run(caseName("HarmonicSoundProcessor::process", params), blockSize, [&]() {
+                processor.process(output.data(), blockSize, 1.f, 60);
+                cw::tools::doNotOptimize(output[0]);
+            });
+        }
+    }
+}
+
+void benchInterpolation(cw::tools::BenchRunner& runner) {
+    constexpr int sampleRate = 48000;
+    using cw::synth::TableInterpolation;
+    const std::vector<std::pair<TableInterpolation, juce::String>> interpolations{ 
+        { TableInterpolation::linear, "linear" }, { TableInterpolation::hermite, "hermite" },
+        { TableInterpolation::lagrange, "lagrange" } };
+    for (const auto& [interpolation, interpolationName] : interpolations) {
+        for (auto numPartials : partialCounts) {
+            for (auto blockSize : blockSizes) {
+                cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+                cw::synth::HarmonicSoundProcessor processor{ generator.generate(), sampleRate };
+                for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+                    processor.setHarmGain(i, i < numPartials ? 1.f / (i + 1) : 0.f);
+                }
+                processor.setInterpolation(interpolation);
+
+                std::vector<float> output(blockSize);
+
+                juce::StringPairArray params;
+                params.set("block", juce::String(blockSize));
+                params.set("interpolation", interpolationName);
+                params.set("partials", juce::String(numPartials));
+                params.set("rate", juce::String(sampleRate));
+                runner.run(caseName("HarmonicSoundProcessor::process", params), blockSize, [&]() {
+                    processor.process(output.data(), blockSize, 1.f, 60);
+                    cw::tools::doNotOptimize(output[0]);
+                });
+            }
+        }
+    }
+}
+
+/*
+* Adds the partials read from a padded table with the interpolator, in the loop of 
+* HarmonicSoundProcessor::processInterpolated: one partial after the other, with the increment reduced modulo the table
+* and one compare for the wrap. The tiers are thus compared in the same loop, without the costs of the processor.
+*/
+template <typename Interpolator>
+void renderKernel(const cw::synth::SoundTable& table, std::array<double, NO_ADDSYNTH_VOICES>& positions,
+    float* output, int noSamples, int numPartials, double baseIncrement, Interpolator interpolator) {
+    std::fill(output, output + noSamples, 0.f);
+    const float* data = table.data();
+    const auto tableSize = (ptrdiff_t)table.size();
+    for (int harm = 0; harm < numPartials; ++harm) {
+        const double increment = std::fmod(baseIncrement * (harm + 1), (double)tableSize);
+        const float gain = 1.f / (harm + 1);
+        double pos = positions[harm];
+        for (int samp = 0; samp < noSamples; ++samp) {
+            const auto index = (ptrdiff_t)pos;
+            output[samp] += interpolator(data + index, (float)(pos - index)) * gain;
+            pos += increment;
+            if (pos >= tableSize) {
+                pos -= tableSize;
+            }
+        }
+        positions[harm] = pos;
+    }
+}
+
+void benchInterpolationKernels(cw::tools::BenchRunner& runner) {
+    constexpr int sampleRate = 48000;
+    cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+    const cw::synth::SoundTable table{ generator.generate() };
+    // middle C, as in the other benchmarks
+    const double increment = (double)table.size() / sampleRate * 261.63 / 440.;
+
+    auto run = [&](const juce::String& interpolationName, auto interpolator) {
+        for (auto numPartials : partialCounts) {
+            for (auto blockSize : blockSizes) {
+                std::array<double, NO_ADDSYNTH_VOICES> positions{};
+                std::vector<float> output(blockSize);
+
+                juce::StringPairArray params;
+                params.set("block", juce::String(blockSize));
+                params.set("interpolation", interpolationName);
+                params.set("partials", juce::String(numPartials));
+                params.set("rate", juce::String(sampleRate));
+                runner.run(caseName("interpolation::kernel", params), blockSize, [&]() {
+                    renderKernel(table, positions, output.data(), blockSize, numPartials, increment, interpolator);
+                    cw::tools::doNotOptimize(output[0]);
+                });
+            }
+        }
+    };
+    run("linear", [](const float* y, float x) { return cw::synth::interpolation::linear(y, x); });
+    run("hermite", [](const float* y, float x) { return cw::synth::interpolation::hermite(y, x); });
+    run("lagrange", [](const float* y, float x) { return cw::synth::interpolation::lagrange(y, x); });
+}
+
+void benchPartialTunings(cw::tools::BenchRunner& runner) {
+    constexpr int sampleRate = 48000;
+    constexpr int blockSize = 512;
+    const juce::StringArray tuningNames{ "harmonic", "stretched", "bell", "bar" };
+    for (int tuning = 0; tuning < tuningNames.size(); ++tuning) {
+        cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+        cw::synth::HarmonicSoundProcessor processor{ generator.generate(), sampleRate };
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            processor.setHarmGain(i, 1.f / (i + 1));
+        }
+        cw::synth::PartialRatios ratios;
+        ratios.tuning = (cw::synth::PartialTuning)tuning;
+        processor.setPartialRatios(ratios);
+
+        std::vector<float> output(blockSize);
+
+        // a low note, so that all partials are played with every tuning
+        juce::StringPairArray params;
+        params.set("block", juce::String(blockSize));
+        params.set("tuning", tuningNames[tuning]);
+        params.set("rate", juce::String(sampleRate));
+        runner.run(caseName("HarmonicSoundProcessor::process", params), blockSize, [&]() {
+            processor.process(output.data(), blockSize, 1.f, 36);
+            cw::tools::doNotOptimize(output[0]);
+        });
+    }
+}
+
+void benchUnison(cw::tools::BenchRunner& runner) {
+    constexpr int sampleRate = 48000;
+    for (auto numLanes : { 1, 4, 8, cw::synth::HarmonicSoundProcessor::maxUnisonVoices }) {
+        for (auto blockSize : blockSizes) {
+            cw::synth::SineGenerator generator{ 44100, 1.0, 1.0 };
+            cw::synth::HarmonicSoundProcessor processor{ generator.generate(), sampleRate };
+            for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+                processor.setHarmGain(i, 1.f / (i + 1));
+            }
+            processor.setUnison(numLanes, 15.f, 0.5f);
+
+            std::vector<float> left(blockSize);
+            std::vector<float> right(blockSize);
+
+            // the throughput counts the samples of all copies
+            juce::StringPairArray params;
+            params.set("block", juce::String(blockSize));
+            params.set("lanes", juce::String(numLanes));
+            params.set("rate", juce::String(sampleRate));
+            runner.run(caseName("HarmonicSoundProcessor::process", params), (juce::int64)blockSize * numLanes, [&]() {
+                processor.process(left.data(), right.data(), blockSize, 1.f, 60);
+                cw::tools::doNotOptimize(left[0]);
+            });
+        }
+    }
+}
+
+void benchSpinRotation(cw::tools::BenchRunner& runner) {
+    using cw::synth::SelectableSpinRotation;
+    std::vector<int> dimensions{ SelectableSpinRotation::classic };
+    for (int dimension = SelectableSpinRotation::minDimension; dimension <= SelectableSpinRotation::maxDimension;
+        ++dimension) {
+        dimensions.push_back(dimension);
+    }
+
+    for (auto mode : { cw::synth::RotationMode::generators, cw::synth::RotationMode::unitary }) {
+        for (auto dimension : dimensions) {
+            for (auto blockSize : blockSizes) {
+                SelectableSpinRotation rotator;
+                rotator.setDimension(dimension);
+                rotator.setPhi(0.7f);
+                rotator.setTheta(1.3f);
+                rotator.setMode(mode);
+
+                cw::synth::SineGenerator generator{ 44100, 1.0, 440.0 };
+                auto sine = generator.generate();
+                sine.resize(blockSize);
+                std::array<std::vector<float>, 2> output{ std::vector<float>(blockSize),
+                    std::vector<float>(blockSize) };
+
+                juce::StringPairArray params;
+                params.set("mode", mode == cw::synth::RotationMode::unitary ? "unitary" : "generators");
+                params.set("dim", dimension == SelectableSpinRotation::classic ? "classic" : juce::String(dimension));
+                params.set("block", juce::String(blockSize));
+                runner.run(caseName("SpinRotation::spinRotate", params), blockSize, [&]() {
+                    rotator.spinRotate(sine.data(), sine.data(), output[0].data(), output[1].data(), blockSize);
+                    cw::tools::doNotOptimize(output[0][0]);
+                });
+            }
+        }
+    }
+}
+
+void benchSineGenerator(cw::tools::BenchRunner& runner) {
+    for (auto sampleRate : sampleRates) {
+        cw::synth::SineGenerator generator{ sampleRate, 1.0, 1.0 };
+
+        juce::StringPairArray params;
+        params.set("rate", juce::String(sampleRate));
+        runner.run(caseName("SineGenerator::generate", params), sampleRate, [&]() {
+            cw::tools::doNotOptimize(generator.generate()[0]);
+        });
+    }
+}
+
+void benchVoiceRendering(cw::tools::BenchRunner& runner) {
+    juce::SynthesiserSound::Ptr sound = new cw::synth::AddSynthSound();
+
+    std::array<float, NO_ADDSYNTH_VOICES> gains;
+    for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+        gains[harm] = 1.f / (harm + 1);
+    }
+    cw::synth::BakedWaveform bakedWaveform;
+    bakedWaveform.bake(*cw::synth::AddSynthVoice::getDefaultSound(), gains);
+
+    // two frames, a sine and a saw, played halfway between each other
+    const int frameSize = cw::synth::Wavetable::tableSize;
+    std::vector<float> frames(2 * frameSize);
+    for (int i = 0; i < frameSize; ++i) {
+        frames[i] = (float)std::sin(juce::MathConstants<double>::twoPi * i / frameSize);
+        frames[frameSize + i] = 2.f * i / frameSize - 1.f;
+    }
+    const auto wavetable = std::make_shared<const cw::synth::Wavetable>(frames, frameSize);
+
+    for (const juce::String osc : { "additive", "baked", "wavetable" }) {
+        const bool baked = osc == "baked";
+        for (auto sampleRate : sampleRates) {
+            for (auto numVoices : voiceCounts) {
+                for (auto blockSize : blockSizes) {
+                    std::vector<std::unique_ptr<cw::synth::AddSynthVoice>> voices;
+                    for (int i = 0; i < numVoices; ++i) {
+                        auto voice = std::make_unique<cw::synth::AddSynthVoice>();
+                        voice->setCurrentPlaybackSampleRate(sampleRate);
+                        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                            voice->getHarmProcessor()->setHarmGain(harm, gains[harm]);
+                        }
+                        voice->setAdsrParameters(0.f, 0.5f, 0.5f, 0.1f);
+                        voice->setPhi(0.7f);
+                        voice->setTheta(1.3f);
+                        voice->setBakedWaveform(baked ? &bakedWaveform : nullptr);
+                        if (osc == "wavetable") {
+                            voice->getHarmProcessor()->setWavetable(wavetable);
+                            voice->getHarmProcessor()->setMorph(0.5f);
+                        }
+                        voice->startNote(48 + 5 * i, 0.8f, sound.get(), 0);
+                        voices.push_back(std::move(voice));
+                    }
+                    juce::AudioBuffer<float> buffer(2, blockSize);
+                    juce::AudioBuffer<double> doubleBuffer(2, blockSize);
+
+                    juce::StringPairArray params;
+                    params.set("osc", osc);
+                    params.set("block", juce::String(blockSize));
+                    params.set("voices", juce::String(numVoices));
+                    params.set("rate", juce::String(sampleRate));
+                    runner.run(caseName("AddSynthVoice::renderNextBlock", params), (juce::int64)blockSize * numVoices,
+                        [&]() {
+                            buffer.clear();
+                            for (auto& voice : voices) {
+                                voice->renderNextBlock(buffer, 0, blockSize);
+                            }
+                            cw::tools::doNotOptimize(buffer.getSample(0, 0));
+                        });
+
+                    // the double kernels, for the additive oscillators
+                    if (osc == "additive") {
+                        params.set("precision", "double");
+                        runner.run(caseName("AddSynthVoice::renderNextBlock", params), 
+                            (juce::int64)blockSize * numVoices, [&]() {
+                                doubleBuffer.clear();
+                                for (auto& voice : voices) {
+                                    voice->renderNextBlock(doubleBuffer, 0, blockSize);
+                                }
+                                cw::tools::doNotOptimize(doubleBuffer.getSample(0, 0));
+                            });
+                    }
+                }
+            }
+        }
+    }
+}
+
+void benchModulation(cw::tools::BenchRunner& runner) {
+    constexpr int blockSize = 512;
+    for (auto numRoutes : { 0, 8, cw::synth::ModulationSettings::maxRoutes }) {
+        for (auto interval : { 16, 32, 64 }) {
+            // routes from all LFOs to all kinds of targets
+            cw::synth::ModulationSettings modulation;
+            modulation.controlInterval = interval;
+            for (int i = 0; i < cw::synth::ModulationSettings::maxLfos; ++i) {
+                modulation.lfos[i].rate = 0.5f + i;
+            }
+            for (int i = 0; i < numRoutes; ++i) {
+                const auto target = (cw::synth::ModulationTarget)(i % 3);
+                modulation.addRoute({ cw::synth::ModulationSource::lfo, i % cw::synth::ModulationSettings::maxLfos,
+                    target, i % NO_ADDSYNTH_VOICES, 0.1f });
+            }
+
+            cw::synth::AdditiveSynth synth;
+            for (auto voice : synth.getVoices()) {
+                for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                    voice->getHarmProcessor()->setHarmGain(harm, 1.f / (harm + 1));
+                }
+                voice->setAdsrParameters(0.f, 0.5f, 0.5f, 0.1f);
+            }
+            synth.setModulation(modulation);
+            synth.prepareToPlay(blockSize, 48000.);
+
+            // all voices are held
+            juce::AudioBuffer<float> buffer(2, blockSize);
+            juce::MidiBuffer notes;
+            for (int i = 0; i < ADDSYNTH_MAXPOLYPHONY; ++i) {
+                notes.addEvent(juce::MidiMessage::noteOn(1, 48 + 5 * i, 0.8f), 0);
+            }
+            synth.setMidiBuffer(notes);
+            synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+
+            juce::StringPairArray params;
+            params.set("routes", juce::String(numRoutes));
+            params.set("interval", juce::String(interval));
+            params.set("voices", juce::String(ADDSYNTH_MAXPOLYPHONY));
+            runner.run(caseName("AdditiveSynth::getNextAudioBlock", params), blockSize, [&]() {
+                synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+                cw::tools::doNotOptimize(buffer.getSample(0, 0));
+            });
+        }
+    }
+}
+
+void benchProcessingQuantum(cw::tools::BenchRunner& runner) {
+    constexpr int blockSize = 512;
+    // the blocks of the host within 512 samples: regular, or split like at a loop point
+    const std::vector<std::pair<juce::String, std::vector<int>>> hostBlocks{ 
+        { "regular", { blockSize } }, { "loop", { 1, 2, blockSize - 3 } } };
+
+    for (const auto& [hostName, lengths] : hostBlocks) {
+        for (auto quantum : { 0, 32, 64 }) {
+            for (auto buffered : { false, true }) {
+                if (quantum == 0 && buffered) {
+                    continue;
+                }
+                cw::synth::AdditiveSynth synth;
+                for (auto voice : synth.getVoices()) {
+                    for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                        voice->getHarmProcessor()->setHarmGain(harm, 1.f / (harm + 1));
+                    }
+                    voice->setAdsrParameters(0.f, 0.5f, 0.5f, 0.1f);
+                }
+                synth.setProcessingQuantum(quantum, buffered);
+                synth.prepareToPlay(blockSize, 48000.);
+
+                // all voices are held
+                juce::AudioBuffer<float> buffer(2, blockSize);
+                juce::MidiBuffer notes;
+                for (int i = 0; i < ADDSYNTH_MAXPOLYPHONY; ++i) {
+                    notes.addEvent(juce::MidiMessage::noteOn(1, 48 + 5 * i, 0.8f), 0);
+                }
+                synth.setMidiBuffer(notes);
+                synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+
+                juce::StringPairArray params;
+                params.set("host", hostName);
+                params.set("quantum", juce::String(quantum));
+                params.set("buffered", buffered ? "yes" : "no");
+                runner.run(caseName("AdditiveSynth::getNextAudioBlock", params), blockSize, [&]() {
+                    int startSample = 0;
+                    for (auto length : lengths) {
+                        synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, startSample, length));
+                        startSample += length;
+                    }
+                    cw::tools::doNotOptimize(buffer.getSample(0, 0));
+                });
+            }
+        }
+    }
+}
+
+/*
+* Held notes in small blocks, with and without rendering ahead, in one and in several synths, which share the worker
+* pool like instances of the plugin in one host. The loop runs faster than real time, so that the workers fall behind
+* now and then and the voices render themselves again; the result is an upper bound of the cost of the audio thread.
+*/
+void benchRenderAhead(cw::tools::BenchRunner& runner) {
+    constexpr int blockSize = 32;
+
+    for (auto instances : { 1, 4 }) {
+        for (auto renderAhead : { false, true }) {
+            std::vector<std::unique_ptr<cw::synth::AdditiveSynth>> synths;
+            juce::AudioBuffer<float> buffer(2, blockSize);
+            juce::MidiBuffer notes;
+            for (int i = 0; i < ADDSYNTH_MAXPOLYPHONY; ++i) {
+                notes.addEvent(juce::MidiMessage::noteOn(1, 48 + 5 * i, 0.8f), 0);
+            }
+            for (int i = 0; i < instances; ++i) {
+                auto& synth = *synths.emplace_back(std::make_unique<cw::synth::AdditiveSynth>());
+                for (auto voice : synth.getVoices()) {
+                    for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                        voice->getHarmProcessor()->setHarmGain(harm, 1.f / (harm + 1));
+                    }
+                    voice->setAdsrParameters(0.f, 0.5f, 0.5f, 0.1f);
+                }
+                synth.setRenderAhead(renderAhead);
+                synth.prepareToPlay(blockSize, 48000.);
+                synth.setMidiBuffer(notes);
+                synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+            }
+
+            juce::StringPairArray params;
+            params.set("block", juce::String(blockSize));
+            params.set("instances", juce::String(instances));
+            params.set("renderAhead", renderAhead ? "yes" : "no");
+            runner.run(caseName("AdditiveSynth::getNextAudioBlock", params), blockSize * instances, [&]() {
+                for (auto& synth : synths) {
+                    synth->getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+                }
+                cw::tools::doNotOptimize(buffer.getSample(0, 0));
+            });
+        }
+    }
+}
+
+void benchParameterSmoothing(cw::tools::BenchRunner& runner) {
+    NewProjectAudioProcessor processor;
+    processor.prepareToPlay(48000., 512);
+
+    // Alternate the targets between two values, so that the smoothing never converges.
+    bool upwards = true;
+    auto setTargets = [&processor](float value) {
+        for (auto& target : processor.paramHarmGainsTarget) {
+            target = value;
+        }
+        processor.paramATarget = value;
+        processor.paramDTarget = value;
+        processor.paramSTarget = value;
+        processor.paramRTarget = value;
+        processor.paramPhiTarget = value;
+        processor.paramThetaTarget = value;
+    };
+
+    juce::StringPairArray params;
+    params.set("voices", juce::String(ADDSYNTH_MAXPOLYPHONY));
+    runner.run(caseName("NewProjectAudioProcessor::updateParameters", params), 1, [&]() {
+        setTargets(upwards ? 1.f : 0.f);
+        upwards = !upwards;
+        processor.updateParameters();
+    });
+}
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_Bench [options]\n"
+        << "  --filter=<text>     only run benchmarks whose name contains the text\n"
+        << "  --min-time=<s>      minimum measuring time per benchmark (default: 0.1)\n"
+        << "  --out=<file>        write the results as JSON to the file\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+
+    const double minSeconds = args.containsOption("--min-time")
+        ? args.getValueForOption("--min-time").getDoubleValue() : 0.1;
+    cw::tools::BenchRunner runner(minSeconds, args.getValueForOption("--filter"));
+
+    benchSineGenerator(runner);
+    benchHarmonicSoundProcessor(runner);
+    benchOscillatorEngines(runner);
+    benchInterpolation(runner);
+    benchInterpolationKernels(runner);
+    benchPartialTunings(runner);
+    benchUnison(runner);
+    benchSpinRotation(runner);
+    benchVoiceRendering(runner);
+    benchModulation(runner);
+    benchProcessingQuantum(runner);
+    benchRenderAhead(runner);
+    benchParameterSmoothing(runner);
+
+    if (args.containsOption("--out")) {
+        auto outFile = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--out"));
+        if (!outFile.replaceWithText(runner.toJson())) {
+            std::cerr << "Could not write " << outFile.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,441 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Multi-core MIDI to WAV bounce. Renders a Standard MIDI File with a preset through the synth core, as fast as the
+    machine allows.
+
+    The timeline is split into segments at points where the synth is guaranteed to be silent: no key or sustain pedal
+    is held, and the release of the last note has ended. All voices are idle there, and a fresh synth starting at such
+    a point, with its LFOs advanced to it, produces exactly the same output as the synth which rendered everything
+    before it. The segments are
+    block aligned, so that the blocks are the same as in a serial render, and are rendered in parallel into temporary
+    files, which are then streamed into the output file in order. Memory use thus stays flat for long files.
+
+    The speedup depends on the silent gaps in the MIDI file; a file without any is rendered on a single core.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <iostream>
+#include "../synth/AdditiveSynth.h"
+#include "../synth/SynthPreset.h"
+
+namespace {
+
+struct BounceSettings {
+    double sampleRate{ 44100. };
+    int blockSize{ 512 };
+    int numThreads{ juce::SystemStats::getNumCpus() };
+    int bitsPerSample{ 24 };
+    // length of the rendering after the release of the last note
+    double tailSeconds{ 0.5 };
+};
+
+// A range of the timeline which can be rendered independently, in samples.
+struct Segment {
+    juce::int64 start;
+    juce::int64 end;
+    juce::File file;
+};
+
+/*
+* Reads all tracks of the MIDI file into one buffer, with the timestamps in samples. The events must be given as one
+* buffer, since the synth consumes MIDI block by block.
+*/
+bool readMidiFile(const juce::File& file, double sampleRate, juce::MidiMessageSequence& sequence) {
+    auto inStream = file.createInputStream();
+    juce::MidiFile midiFile;
+    if (inStream == nullptr || !midiFile.readFrom(*inStream)) {
+        return false;
+    }
+    midiFile.convertTimestampTicksToSeconds();
+
+    for (int track = 0; track < midiFile.getNumTracks(); ++track) {
+        sequence.addSequence(*midiFile.getTrack(track), 0.);
+    }
+    for (auto event : sequence) {
+        event->message.setTimeStamp(std::round(event->message.getTimeStamp() * sampleRate));
+    }
+    sequence.sort();
+    return true;
+}
+
+/*
+* Finds the block aligned points at which the synth is silent, and returns the segments in between. Segments shorter
+* than minLength are merged with the following ones, so that the number of segments stays reasonable.
+*/
+std::vector<Segment> planSegments(const juce::MidiMessageSequence& sequence, const cw::synth::SynthPreset& preset,
+    const BounceSettings& settings, juce::int64 totalLength, juce::int64 minLength) {
+    // the longest time a voice can sound after its key and the pedal have been released, plus the quantization of 
+    // note events within a block by the synth
+    const auto releaseSamples = (juce::int64)std::ceil(preset.release * settings.sampleRate)
+        + (juce::int64)(0.01 * settings.sampleRate) + settings.blockSize;
+
+    std::vector<juce::int64> splitPoints;
+    std::array<int, 16 * 128> heldKeys{};
+    std::array<bool, 16> sustainDown{};
+    int numHeld = 0;
+    const auto notSilent = std::numeric_limits<juce::int64>::max();
+    juce::int64 silentFrom = 0;
+
+    for (auto event : sequence) {
+        const auto& message = event->message;
+        const auto position = (juce::int64)message.getTimeStamp();
+        const int channel = juce::jlimit(1, 16, message.getChannel()) - 1;
+
+        if (message.isNoteOn()) {
+            if (silentFrom != notSilent) {
+                // the first block starting within the silence
+                const auto silentBlock = (silentFrom + settings.blockSize - 1) / settings.blockSize
+                    * settings.blockSize;
+                if (silentBlock > 0 && silentBlock <= position
+                    && (splitPoints.empty() || splitPoints.back() < silentBlock)) {
+                    splitPoints.push_back(silentBlock);
+                }
+            }
+            ++heldKeys[channel * 128 + message.getNoteNumber()];
+            ++numHeld;
+        }
+        else if (message.isNoteOff()) {
+            auto& held = heldKeys[channel * 128 + message.getNoteNumber()];
+            if (held > 0) {
+                --held;
+                --numHeld;
+            }
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff()) {
+            for (int note = 0; note < 128; ++note) {
+                numHeld -= heldKeys[channel * 128 + note];
+                heldKeys[channel * 128 + note] = 0;
+            }
+        }
+        else if (message.isSustainPedalOn()) {
+            sustainDown[channel] = true;
+        }
+        else if (message.isSustainPedalOff()) {
+            sustainDown[channel] = false;
+        }
+
+        // the synth is silent from the end of the release on, counted from the moment nothing is held any more
+        const bool anySustain = std::find(sustainDown.begin(), sustainDown.end(), true) != sustainDown.end();
+        if (numHeld > 0 || anySustain) {
+            silentFrom = notSilent;
+        }
+        else if (silentFrom == notSilent) {
+            silentFrom = position + releaseSamples;
+        }
+    }
+
+    std::vector<Segment> segments;
+    juce::int64 start = 0;
+    for (auto point : splitPoints) {
+        if (point - start >= minLength && point < totalLength) {
+            segments.push_back({ start, point, {} });
+            start = point;
+        }
+    }
+    segments.push_back({ start, totalLength, {} });
+    return segments;
+}
+
+std::unique_ptr<juce::AudioFormatWriter> createWavWriter(const juce::File& file, double sampleRate,
+    int bitsPerSample) {
+    file.deleteFile();
+    // large buffer, so that the file is written in big chunks
+    auto outStream = std::make_unique<juce::FileOutputStream>(file, 1 << 20);
+    if (outStream->failedToOpen()) {
+        return {};
+    }
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(outStream.get(), sampleRate, 2,
+        bitsPerSample, {}, 0));
+    if (writer != nullptr) {
+        // the writer owns the stream from now on
+        outStream.release();
+    }
+    return writer;
+}
+
+// Renders the segment with a fresh synth into its file, as 32 bit float. Returns false if the file can't be written.
+bool renderSegment(const Segment& segment, const juce::MidiMessageSequence& sequence,
+    const cw::synth::SynthPreset& preset, const BounceSettings& settings) {
+    auto writer = createWavWriter(segment.file, settings.sampleRate, 32);
+    if (writer == nullptr) {
+        return false;
+    }
+
+    cw::synth::AdditiveSynth synth;
+    synth.prepareToPlay(settings.blockSize, settings.sampleRate);
+    preset.applyTo(synth, true);
+    // the waveform has to be there from the start, and the LFOs and ticks of the modulation continue from where the
+    // previous segment ended, otherwise the segments would differ from a serial rendering
+    if (preset.bakedWaveform && !synth.waitForBakedWaveform(5000)) {
+        return false;
+    }
+    synth.advanceModulation(segment.start);
+
+    juce::AudioBuffer<float> block(2, settings.blockSize);
+    juce::MidiBuffer blockEvents;
+    int eventIndex = sequence.getNextIndexAtTime((double)segment.start);
+
+    for (auto pos = segment.start; pos < segment.end; pos += settings.blockSize) {
+        const int numSamples = (int)juce::jmin((juce::int64)settings.blockSize, segment.end - pos);
+        blockEvents.clear();
+        for (; eventIndex < sequence.getNumEvents(); ++eventIndex) {
+            const auto& message = sequence.getEventPointer(eventIndex)->message;
+            const auto position = (juce::int64)message.getTimeStamp();
+            if (position >= pos + numSamples) {
+                break;
+            }
+            blockEvents.addEvent(message, (int)(position - pos));
+        }
+
+        synth.setMidiBuffer(blockEvents);
+        synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, numSamples));
+        if (!writer->writeFromAudioSampleBuffer(block, 0, numSamples)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<juce::AudioFormatReader> createWavReader(const juce::File& file) {
+    juce::WavAudioFormat wavFormat;
+    return std::unique_ptr<juce::AudioFormatReader>(wavFormat.createReaderFor(file.createInputStream().release(),
+        true));
+}
+
+/*
+* Compares the rendered segments with a serial rendering of the whole timeline, chunk by chunk. Returns the maximum
+* absolute difference, or a negative value if the files can't be read.
+*/
+float compareWithSerial(const std::vector<Segment>& segments, const juce::File& serialFile) {
+    constexpr int chunkSize = 1 << 15;
+    auto serialReader = createWavReader(serialFile);
+    if (serialReader == nullptr) {
+        return -1.f;
+    }
+    juce::AudioBuffer<float> serialChunk(2, chunkSize);
+    juce::AudioBuffer<float> segmentChunk(2, chunkSize);
+    float maxDifference = 0.f;
+
+    for (const auto& segment : segments) {
+        auto segmentReader = createWavReader(segment.file);
+        if (segmentReader == nullptr) {
+            return -1.f;
+        }
+        for (juce::int64 pos = 0; pos < segmentReader->lengthInSamples; pos += chunkSize) {
+            const int numSamples = (int)juce::jmin((juce::int64)chunkSize, segmentReader->lengthInSamples - pos);
+            segmentReader->read(&segmentChunk, 0, numSamples, pos, true, true);
+            serialReader->read(&serialChunk, 0, numSamples, segment.start + pos, true, true);
+            for (int channel = 0; channel < 2; ++channel) {
+                for (int i = 0; i < numSamples; ++i) {
+                    maxDifference = juce::jmax(maxDifference,
+                        std::abs(segmentChunk.getSample(channel, i) - serialChunk.getSample(channel, i)));
+                }
+            }
+        }
+    }
+    return maxDifference;
+}
+
+// Renders all segments in parallel. Returns false if a file can't be written.
+bool renderSegments(const std::vector<Segment>& segments, const juce::MidiMessageSequence& sequence,
+    const cw::synth::SynthPreset& preset, const BounceSettings& settings) {
+    std::atomic<bool> failed{ false };
+    juce::ThreadPool pool(settings.numThreads);
+    std::atomic<int> numPending{ (int)segments.size() };
+    juce::WaitableEvent allDone;
+    for (const auto& segment : segments) {
+        pool.addJob([&segment, &sequence, &preset, &settings, &failed, &numPending, &allDone]() {
+            if (!renderSegment(segment, sequence, preset, settings)) {
+                failed = true;
+            }
+            if (--numPending == 0) {
+                allDone.signal();
+            }
+        });
+    }
+    allDone.wait();
+    return !failed;
+}
+
+/*
+* Renders the timeline serially and prints the difference to the rendered segments. Returns false if they differ or
+* the comparison fails.
+*/
+bool verifySegments(const std::vector<Segment>& segments, const juce::MidiMessageSequence& sequence,
+    const cw::synth::SynthPreset& preset, const BounceSettings& settings, const juce::File& serialFile,
+    const char* label) {
+    const Segment serial{ 0, segments.back().end, serialFile };
+    const auto difference = renderSegment(serial, sequence, preset, settings)
+        ? compareWithSerial(segments, serial.file) : -1.f;
+    if (difference < 0.f) {
+        std::cerr << "Could not render the serial comparison.\n";
+    }
+    else {
+        std::cout << label << difference << " (max abs)\n";
+    }
+    return difference == 0.f;
+}
+
+// The preset with LFOs and an envelope routed to the angles and a gain, at rates which do not fit the segments.
+cw::synth::SynthPreset withModulation(cw::synth::SynthPreset preset) {
+    auto& modulation = preset.modulation;
+    modulation.lfos[0] = { cw::synth::LfoShape::sine, 0.37f, 0.1f };
+    modulation.lfos[1] = { cw::synth::LfoShape::triangle, 5.3f, 0.f };
+    modulation.numRoutes = 0;
+    modulation.addRoute({ cw::synth::ModulationSource::lfo, 0, cw::synth::ModulationTarget::phi, 0, 1.f });
+    modulation.addRoute({ cw::synth::ModulationSource::lfo, 1, cw::synth::ModulationTarget::harmonicGain, 1, 0.5f });
+    modulation.addRoute({ cw::synth::ModulationSource::envelope, 0, cw::synth::ModulationTarget::theta, 0, 1.f });
+    return preset;
+}
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_Bounce <file.mid> [options]\n"
+        << "  --preset=<file>      preset XML file (default: the default parameters of the plugin)\n"
+        << "  --out=<file>         output WAV file (default: the MIDI file name with .wav)\n"
+        << "  --rate=<Hz>          sample rate (default: 44100)\n"
+        << "  --block=<samples>    block size (default: 512)\n"
+        << "  --bits=16|24|32      bits per sample of the output, 32 is float (default: 24)\n"
+        << "  --threads=<n>        number of threads (default: number of CPUs)\n"
+        << "  --tail=<s>           length after the release of the last note (default: 0.5)\n"
+        << "  --verify             also render serially and report the difference, with the preset and a\n"
+        << "                       modulated copy of it\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || args.size() == 0 || args[0].isOption()) {
+        printUsage();
+        return args.containsOption("--help|-h") ? 0 : 1;
+    }
+
+    BounceSettings settings;
+    if (args.containsOption("--rate")) {
+        settings.sampleRate = args.getValueForOption("--rate").getDoubleValue();
+    }
+    if (args.containsOption("--block")) {
+        settings.blockSize = args.getValueForOption("--block").getIntValue();
+    }
+    if (args.containsOption("--bits")) {
+        settings.bitsPerSample = args.getValueForOption("--bits").getIntValue();
+    }
+    if (args.containsOption("--threads")) {
+        settings.numThreads = args.getValueForOption("--threads").getIntValue();
+    }
+    if (args.containsOption("--tail")) {
+        settings.tailSeconds = args.getValueForOption("--tail").getDoubleValue();
+    }
+    if (settings.sampleRate <= 0. || settings.blockSize <= 0 || settings.numThreads <= 0
+        || settings.tailSeconds < 0. || (settings.bitsPerSample != 16 && settings.bitsPerSample != 24
+            && settings.bitsPerSample != 32)) {
+        std::cerr << "Invalid settings.\n";
+        printUsage();
+        return 1;
+    }
+
+    const auto midiFile = args[0].resolveAsExistingFile();
+    juce::MidiMessageSequence sequence;
+    if (!readMidiFile(midiFile, settings.sampleRate, sequence)) {
+        std::cerr << "Could not read " << midiFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    cw::synth::SynthPreset preset;
+    if (args.containsOption("--preset")) {
+        const auto presetFile = args.getExistingFileForOption("--preset");
+        if (!preset.loadFromFile(presetFile)) {
+            std::cerr << "Could not read the preset " << presetFile.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    const auto outFile = args.containsOption("--out")
+        ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--out"))
+        : midiFile.withFileExtension("wav");
+
+    const auto totalLength = (juce::int64)(sequence.getEndTime()
+        + (preset.release + settings.tailSeconds) * settings.sampleRate);
+    // a few segments per thread, for an even load, but not so short that the overhead matters
+    const auto minLength = juce::jmax((juce::int64)(2. * settings.sampleRate),
+        totalLength / (4 * settings.numThreads));
+    auto segments = planSegments(sequence, preset, settings, totalLength, minLength);
+
+    const auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getNonexistentChildFile("Additive_Synth_Bounce", {}, false);
+    tempDir.createDirectory();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        segments[i].file = tempDir.getChildFile("segment" + juce::String((int)i) + ".wav");
+    }
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    if (!renderSegments(segments, sequence, preset, settings)) {
+        std::cerr << "Could not write the temporary files to " << tempDir.getFullPathName() << "\n";
+        tempDir.deleteRecursively();
+        return 1;
+    }
+
+    auto writer = createWavWriter(outFile, settings.sampleRate, settings.bitsPerSample);
+    if (writer == nullptr) {
+        std::cerr << "Could not open " << outFile.getFullPathName() << " for writing.\n";
+        tempDir.deleteRecursively();
+        return 1;
+    }
+    for (const auto& segment : segments) {
+        auto reader = createWavReader(segment.file);
+        if (reader == nullptr || !writer->writeFromAudioReader(*reader, 0, -1)) {
+            std::cerr << "Could not write " << outFile.getFullPathName() << "\n";
+            tempDir.deleteRecursively();
+            return 1;
+        }
+    }
+    writer.reset();
+    const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    std::cout << "Rendered:          " << totalLength / settings.sampleRate << " s in " << segments.size()
+        << " segments on " << settings.numThreads << " threads\n"
+        << "Render time:       " << seconds << " s\n"
+        << "Real-time factor:  " << (seconds > 0. ? totalLength / settings.sampleRate / seconds : 0.) << "\n"
+        << "Output written to: " << outFile.getFullPathName() << "\n";
+
+    if (args.containsOption("--verify")) {
+        const auto serialFile = tempDir.getChildFile("serial.wav");
+        bool identical = verifySegments(segments, sequence, preset, settings, serialFile, "Serial difference: ");
+        // the segments of a modulated preset have to continue the LFOs and the ticks of the previous ones
+        if (!preset.modulation.isActive()) {
+            const auto modulated = withModulation(preset);
+            identical = renderSegments(segments, sequence, modulated, settings)
+                && verifySegments(segments, sequence, modulated, settings, serialFile, "Modulated difference: ")
+                && identical;
+        }
+        tempDir.deleteRecursively();
+        return identical ? 0 : 1;
+    }
+
+    tempDir.deleteRecursively();
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Headless offline renderer. Renders one of the MIDI scenarios of RenderScenario through the synth core, without
+    any host or editor, prints the timing statistics and writes the rendered audio to a WAV file.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "RenderScenario.h"
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_Render [options]\n"
+        << "  --scenario=chords|arpeggio|sweep   MIDI scenario to render (default: chords)\n"
+        << "  --rate=<Hz>                        sample rate (default: 44100)\n"
+        << "  --block=<samples>                  block size (default: 512)\n"
+        << "  --seconds=<s>                      length of the rendering (default: 10)\n"
+        << "  --partials=<n>                     number of sounding harmonics, 0-" << NO_ADDSYNTH_VOICES
+        << " (default: " << NO_ADDSYNTH_VOICES << ")\n"
+        << "  --baked                            play the harmonics as a baked waveform\n"
+        << "  --interpolation=<name>             linear, hermite or lagrange interpolation of the sound\n"
+        << "  --quantum=<samples>                render in fixed chunks of 16-256 samples (default: host blocks)\n"
+        << "  --buffered                         render whole chunks only, one chunk ahead of the output\n"
+        << "  --irregular                        deliver each block as blocks of 1, 2 and the remaining samples\n"
+        << "  --render-ahead                     render held notes ahead on a worker thread\n"
+        << "  --sound=<file>                     play an audio file, or raw floats (.f32), for each harmonic\n"
+        << "  --cache=<dir>                      cache for decoded sounds (default: temporary directory)\n"
+        << "  --wavetable=<file>                 play the frames of an audio file as a wavetable\n"
+        << "  --frame=<samples>                  frame size of the wavetable (default: 2048)\n"
+        << "  --morph=<0-1>                      position between the first and the last frame (default: 0)\n"
+        << "  --out=<file>                       output WAV file (default: render_<scenario>.wav)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+
+    cw::tools::RenderSettings settings;
+    if (args.containsOption("--scenario")
+        && !cw::tools::parseScenarioType(args.getValueForOption("--scenario"), settings.scenario)) {
+        std::cerr << "Unknown scenario: " << args.getValueForOption("--scenario") << "\n";
+        return 1;
+    }
+    if (args.containsOption("--rate")) {
+        settings.sampleRate = args.getValueForOption("--rate").getDoubleValue();
+    }
+    if (args.containsOption("--block")) {
+        settings.blockSize = args.getValueForOption("--block").getIntValue();
+    }
+    if (args.containsOption("--seconds")) {
+        settings.lengthSeconds = args.getValueForOption("--seconds").getDoubleValue();
+    }
+    if (args.containsOption("--partials")) {
+        settings.numPartials = args.getValueForOption("--partials").getIntValue();
+    }
+    settings.bakedWaveform = args.containsOption("--baked");
+    if (args.containsOption("--interpolation")
+        && !cw::tools::parseInterpolation(args.getValueForOption("--interpolation"), settings.interpolation)) {
+        std::cerr << "Unknown interpolation: " << args.getValueForOption("--interpolation") << "\n";
+        return 1;
+    }
+    if (args.containsOption("--quantum")) {
+        settings.quantum = args.getValueForOption("--quantum").getIntValue();
+    }
+    settings.quantumBuffered = args.containsOption("--buffered");
+    settings.irregularBlocks = args.containsOption("--irregular");
+    settings.renderAhead = args.containsOption("--render-ahead");
+    if (args.containsOption("--morph")) {
+        settings.wavetableMorph = args.getValueForOption("--morph").getFloatValue();
+    }
+    const int frameSize = args.containsOption("--frame") ? args.getValueForOption("--frame").getIntValue() : 2048;
+
+    if (settings.sampleRate <= 0. || settings.blockSize <= 0 || settings.lengthSeconds <= 0.
+        || settings.numPartials < 0 || settings.numPartials > NO_ADDSYNTH_VOICES || frameSize <= 0
+        || settings.quantum < 0 || settings.quantum > 256
+        || settings.wavetableMorph < 0.f || settings.wavetableMorph > 1.f) {
+        std::cerr << "Invalid settings.\n";
+        printUsage();
+        return 1;
+    }
+
+    auto outFile = juce::File::getCurrentWorkingDirectory().getChildFile(args.containsOption("--out")
+        ? args.getValueForOption("--out")
+        : "render_" + cw::tools::getScenarioName(settings.scenario) + ".wav");
+    outFile.deleteFile();
+
+    auto outStream = outFile.createOutputStream();
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    if (outStream != nullptr) {
+        writer.reset(wavFormat.createWriterFor(outStream.get(), settings.sampleRate, 2, 24, {}, 0));
+    }
+    if (writer == nullptr) {
+        std::cerr << "Could not open " << outFile.getFullPathName() << " for writing.\n";
+        return 1;
+    }
+    // the writer owns the stream from now on
+    outStream.release();
+
+    cw::synth::AdditiveSynth synth;
+    cw::tools::applyDefaultParameters(synth, settings.numPartials);
+    if (args.containsOption("--sound")) {
+        const auto soundFile = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--sound"));
+        const auto cacheDirectory = args.containsOption("--cache")
+            ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--cache"))
+            : juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("Additive Synth Cache");
+        auto sound = cw::synth::SoundTable::loadCached(soundFile, cacheDirectory);
+        if (sound == nullptr) {
+            std::cerr << "Could not read the sound " << soundFile.getFullPathName() << ".\n";
+            return 1;
+        }
+        std::cout << "Sound:             " << sound->size() << " samples, mapped\n";
+        synth.setSound(std::move(sound));
+    }
+    if (args.containsOption("--wavetable")) {
+        const auto wavetableFile = juce::File::getCurrentWorkingDirectory().getChildFile(
+            args.getValueForOption("--wavetable"));
+        auto wavetable = cw::synth::Wavetable::loadFromFile(wavetableFile, frameSize);
+        if (wavetable == nullptr) {
+            std::cerr << "Could not read the wavetable " << wavetableFile.getFullPathName() << ".\n";
+            return 1;
+        }
+        std::cout << "Wavetable:         " << wavetable->getNumFrames() << " frames of " << frameSize 
+            << " samples\n";
+        synth.setWavetable(std::move(wavetable));
+    }
+    const auto events = cw::tools::createScenario(settings);
+
+    const auto stats = cw::tools::renderScenario(synth, events, settings,
+        [&writer](const juce::AudioBuffer<float>& block, int numSamples) {
+            writer->writeFromAudioSampleBuffer(block, 0, numSamples);
+        });
+    writer.reset();
+
+    std::cout << "Scenario:          " << cw::tools::getScenarioName(settings.scenario) << ", "
+        << settings.sampleRate << " Hz, block size " << settings.blockSize << ", "
+        << settings.lengthSeconds << " s, " << settings.numPartials << " partials"
+        << (settings.bakedWaveform ? ", baked waveform" : "")
+        << (settings.renderAhead ? ", render ahead" : "")
+        << (settings.quantum > 0 ? ", quantum " + juce::String(synth.getProcessingQuantum()) : juce::String())
+        << (synth.getLatencySamples() > 0 ? ", latency " + juce::String(synth.getLatencySamples()) : juce::String())
+        << "\n"
+        << "Render time:       " << stats.renderSeconds << " s\n"
+        << "Samples/second:    " << stats.getSamplesPerSecond() << "\n"
+        << "Real-time factor:  " << stats.getRealTimeFactor() << "\n"
+        << "Cost per voice:    " << stats.getNanosPerVoiceSample() << " ns/sample\n"
+        << "Cost per partial:  " << stats.getNanosPerPartialSample() << " ns/sample\n"
+        << "Output written to: " << outFile.getFullPathName() << "\n";
+
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Realtime safety checker. Drives the plugin processor through scenarios which stress the audio path (note storms,
+    parameter sweeps, changing block sizes, loading presets and each of the optional features of the synth) while the
+    hooks of RealtimeSafetyHooks.cpp watch for allocations, locks, sleeping, memory mapping and file I/O within 
+    processBlock. Every violation is printed with a stack trace; the exit code is
+    one if there were any, so that the check can run as part of a regression suite.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../PluginProcessor.h"
+#include "../synth/SynthPreset.h"
+#include "../util/RealtimeSafety.h"
+
+namespace {
+
+constexpr double sampleRate = 48000.;
+
+struct CheckContext {
+    NewProjectAudioProcessor& processor;
+    juce::AudioBuffer<float>& buffer;
+    juce::MidiBuffer& midi;
+};
+
+// Calls processBlock for the given number of samples; the buffers are sized beforehand, outside the realtime section.
+void processBlock(CheckContext& context, int numSamples) {
+    context.buffer.setSize(2, numSamples, false, false, true);
+    context.processor.processBlock(context.buffer, context.midi);
+    context.midi.clear();
+}
+
+// Many notes per block, more than the synth has voices, so that voices are stolen all the time.
+void runNoteStorm(CheckContext& context) {
+    const int blockSize = 256;
+    for (int block = 0; block < 400; ++block) {
+        for (int i = 0; i < 12; ++i) {
+            const int note = 36 + (block * 7 + i * 5) % 60;
+            const int position = (i * blockSize) / 12;
+            if ((block + i) % 3 == 0) {
+                context.midi.addEvent(juce::MidiMessage::noteOff(1, note), position);
+            } else {
+                context.midi.addEvent(juce::MidiMessage::noteOn(1, note, 0.8f), position);
+            }
+        }
+        processBlock(context, blockSize);
+    }
+    context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+    processBlock(context, blockSize);
+}
+
+// Moves all parameter targets back and forth while notes are playing, so that the smoothing is always active.
+void runParameterSweep(CheckContext& context) {
+    auto& processor = context.processor;
+    const int blockSize = 128;
+
+    for (int note = 48; note < 48 + ADDSYNTH_MAXPOLYPHONY; ++note) {
+        context.midi.addEvent(juce::MidiMessage::noteOn(1, note, 0.8f), 0);
+    }
+    for (int block = 0; block < 400; ++block) {
+        const float value = (block / 20) % 2 == 0 ? 1.f : 0.f;
+        for (auto& target : processor.paramHarmGainsTarget) {
+            target = value;
+        }
+        processor.paramATarget = value;
+        processor.paramDTarget = value;
+        processor.paramSTarget = value;
+        processor.paramRTarget = value;
+        processor.paramPhiTarget = 6.f * value;
+        processor.paramThetaTarget = 3.f * value;
+        processBlock(context, blockSize);
+    }
+    context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+    processBlock(context, blockSize);
+}
+
+// Block sizes from one sample up to more than was prepared, and re-preparing with different sizes in between.
+void runBlockSizeChanges(CheckContext& context) {
+    for (auto preparedSize : { 64, 480, 1024 }) {
+        context.processor.prepareToPlay(sampleRate, preparedSize);
+        context.midi.addEvent(juce::MidiMessage::noteOn(1, 60, 0.8f), 0);
+        context.midi.addEvent(juce::MidiMessage::noteOn(1, 64, 0.8f), 0);
+
+        for (int blockSize = 1; blockSize <= 2048; blockSize *= 2) {
+            processBlock(context, blockSize);
+            processBlock(context, blockSize + 1);
+        }
+        context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+        processBlock(context, preparedSize);
+    }
+}
+
+// Plays a chord and keeps it held for the given number of blocks, with block sizes which vary a little.
+void playHeldChord(CheckContext& context, int numBlocks) {
+    for (int note = 48; note < 48 + ADDSYNTH_MAXPOLYPHONY; ++note) {
+        context.midi.addEvent(juce::MidiMessage::noteOn(1, note + (note % 2) * 7, 0.8f), 0);
+    }
+    for (int block = 0; block < numBlocks; ++block) {
+        processBlock(context, 96 + (block % 5) * 16);
+    }
+    context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+    processBlock(context, 256);
+}
+
+// A preset which uses modulation, unison, an inharmonic tuning and a spin rotation of higher dimension.
+cw::synth::SynthPreset createBusyPreset() {
+    cw::synth::SynthPreset preset;
+    for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+        preset.harmonicGains[(size_t)i] = 1.f / (i + 1);
+    }
+    preset.phi = 1.f;
+    preset.theta = 0.5f;
+    preset.spinDimension = 3;
+    preset.oscillatorEngine = cw::synth::OscillatorEngine::polynomial7;
+    preset.partials.tuning = cw::synth::PartialTuning::stretched;
+    preset.unisonVoices = 5;
+
+    auto& modulation = preset.modulation;
+    modulation.lfos[0] = { cw::synth::LfoShape::sine, 3.f, 0.f };
+    modulation.lfos[1] = { cw::synth::LfoShape::square, 7.f, 0.25f };
+    modulation.routes[0] = { cw::synth::ModulationSource::lfo, 0, cw::synth::ModulationTarget::phi, 0, 1.f };
+    modulation.routes[1] = { cw::synth::ModulationSource::lfo, 1, cw::synth::ModulationTarget::harmonicGain, 1, 0.5f };
+    modulation.routes[2] = { cw::synth::ModulationSource::envelope, 0, cw::synth::ModulationTarget::theta, 0, 2.f };
+    modulation.numRoutes = 3;
+    return preset;
+}
+
+/*
+* Loads the preset the way a host does, through setStateInformation, and gives the loader a moment to decode it; the 
+* audio thread picks it up at the start of one of the next blocks. The previous preset is taken over into the 
+* parameters first, which the timer of the processor does in a plugin.
+*/
+void loadPreset(CheckContext& context, const cw::synth::SynthPreset& preset) {
+    context.processor.handlePendingChanges();
+    juce::MemoryOutputStream stream;
+    preset.writeBinary(stream);
+    context.processor.setStateInformation(stream.getData(), (int)stream.getDataSize());
+    juce::Thread::sleep(20);
+}
+
+// Switches between a plain and a busy preset while notes are held, as a host does when the user browses presets.
+void runPresetLoading(CheckContext& context) {
+    const auto busy = createBusyPreset();
+    const cw::synth::SynthPreset plain;
+    for (int note = 48; note < 48 + ADDSYNTH_MAXPOLYPHONY; ++note) {
+        context.midi.addEvent(juce::MidiMessage::noteOn(1, note, 0.8f), 0);
+    }
+    for (int load = 0; load < 10; ++load) {
+        loadPreset(context, load % 2 == 0 ? busy : plain);
+        for (int block = 0; block < 40; ++block) {
+            processBlock(context, 128);
+        }
+    }
+    context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+    processBlock(context, 128);
+    loadPreset(context, plain);
+    processBlock(context, 128);
+}
+
+// LFOs and envelopes routed to the angles and gains, with notes starting and stopping all the time.
+void runModulation(CheckContext& context) {
+    loadPreset(context, createBusyPreset());
+    runNoteStorm(context);
+    playHeldChord(context, 200);
+    loadPreset(context, {});
+    processBlock(context, 128);
+}
+
+// The harmonics played as a baked waveform, re-baked while the gains glide.
+void runBakedWaveform(CheckContext& context) {
+    auto& processor = context.processor;
+    *processor.paramBaked = true;
+    for (int i = 0; i < 4; ++i) {
+        for (auto& target : processor.paramHarmGainsTarget) {
+            target = (float)(i % 2);
+        }
+        playHeldChord(context, 60);
+    }
+    *processor.paramBaked = false;
+    processBlock(context, 128);
+}
+
+// Unison with up to the maximum of copies, while the detune and the spread change.
+void runUnison(CheckContext& context) {
+    auto& processor = context.processor;
+    for (auto voices : { 2, 7, cw::synth::HarmonicSoundProcessor::maxUnisonVoices }) {
+        *processor.paramUnison = voices;
+        for (int i = 0; i < 4; ++i) {
+            *processor.paramDetune = 25.f * i;
+            *processor.paramSpread = 0.3f * i;
+            playHeldChord(context, 20);
+        }
+    }
+    *processor.paramUnison = 1;
+    processBlock(context, 128);
+}
+
+// Each oscillator engine, and each interpolation of the table engine.
+void runOscillatorEngines(CheckContext& context) {
+    auto& processor = context.processor;
+    for (int engine = 0; engine < processor.paramEngine->choices.size(); ++engine) {
+        *processor.paramEngine = engine;
+        for (int interpolation = 0; interpolation < processor.paramInterpolation->choices.size(); ++interpolation) {
+            *processor.paramInterpolation = interpolation;
+            playHeldChord(context, 20);
+        }
+    }
+    *processor.paramEngine = 0;
+    *processor.paramInterpolation = 0;
+    processBlock(context, 128);
+}
+
+// Each processing quantum, with and without buffering, with notes in blocks of irregular sizes.
+void runQuantumModes(CheckContext& context) {
+    auto& processor = context.processor;
+    for (int quantum = 0; quantum < processor.paramQuantum->choices.size(); ++quantum) {
+        for (auto buffered : { false, true }) {
+            *processor.paramQuantum = quantum;
+            *processor.paramQuantumBuffered = buffered;
+            context.midi.addEvent(juce::MidiMessage::noteOn(1, 60, 0.8f), 0);
+            for (int block = 0; block < 60; ++block) {
+                const int blockSize = 1 + (block * 37) % 300;
+                context.midi.addEvent(juce::MidiMessage::noteOn(1, 48 + block % 24, 0.8f), blockSize / 2);
+                processBlock(context, blockSize);
+            }
+            context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+            processBlock(context, 128);
+        }
+    }
+    *processor.paramQuantum = 0;
+    *processor.paramQuantumBuffered = false;
+    processBlock(context, 128);
+}
+
+/*
+* Held notes rendered ahead by the workers, with notes, parameter changes and releases which bring the voices back to 
+* rendering themselves. The blocks are paced, so that the workers keep up now and then.
+*/
+void runRenderAhead(CheckContext& context) {
+    auto& processor = context.processor;
+    *processor.paramRenderAhead = true;
+    for (int round = 0; round < 4; ++round) {
+        for (int note = 48; note < 48 + ADDSYNTH_MAXPOLYPHONY; ++note) {
+            context.midi.addEvent(juce::MidiMessage::noteOn(1, note, 0.8f), 0);
+        }
+        for (int block = 0; block < 100; ++block) {
+            if (block % 25 == 0) {
+                processor.paramPhiTarget = 0.5f * (block / 25);
+            }
+            processBlock(context, 64);
+            juce::Thread::sleep(1);
+        }
+        context.midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+        processBlock(context, 128);
+    }
+    *processor.paramRenderAhead = false;
+    processBlock(context, 128);
+}
+
+void printUsage() {
+    std::cout << "Usage: Additive_Synth_RtCheck [options]\n"
+        << "  --abort      abort at the first violation, e.g. to inspect it in a debugger\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+    cw::synth::rtsafety::setAbortOnViolation(args.containsOption("--abort"));
+
+    NewProjectAudioProcessor processor;
+    processor.prepareToPlay(sampleRate, 512);
+
+    // allocated with the largest size once, so that resizing within the scenarios does not allocate
+    juce::AudioBuffer<float> buffer(2, 4096);
+    juce::MidiBuffer midi;
+    midi.ensureSize(4096);
+    CheckContext context{ processor, buffer, midi };
+
+    const std::vector<std::pair<const char*, void (*)(CheckContext&)>> scenarios{
+        { "note storm", runNoteStorm },
+        { "parameter sweep", runParameterSweep },
+        { "block size changes", runBlockSizeChanges },
+        { "preset loading", runPresetLoading },
+        { "modulation", runModulation },
+        { "baked waveform", runBakedWaveform },
+        { "unison", runUnison },
+        { "oscillator engines", runOscillatorEngines },
+        { "quantum modes", runQuantumModes },
+        { "render ahead", runRenderAhead }
+    };
+
+    int totalViolations = 0;
+    for (const auto& [name, run] : scenarios) {
+        cw::synth::rtsafety::resetViolations();
+        run(context);
+        const auto numViolations = cw::synth::rtsafety::getNumViolations();
+        std::cout << name << ": " << (numViolations == 0 ? "ok" : "FAILED") << " (" << numViolations
+            << " violations)\n";
+        totalViolations += numViolations;
+    }
+    processor.releaseResources();
+
+    return totalViolations == 0 ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+  ==============================================================================
+
+    Interposers for the operations which are not realtime safe. Linked into the realtime safety checker, they replace
+    the functions of the C library and the C++ runtime for the whole process; each of them reports a violation when
+    it is called within a realtime section and then forwards to the original function. Linux (glibc) only.
+
+  ==============================================================================
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <new>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "../util/RealtimeSafety.h"
+
+using cw::synth::rtsafety::reportViolation;
+
+// glibc's implementations of the malloc family, which do not go through the dynamic linker
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* ptr);
+}
+
+namespace {
+
+/*
+* Looks up the next definition of a function after this one, once, and caches it. dlsym may allocate itself, which
+* is fine since the malloc family does not use this.
+*/
+void* getNext(std::atomic<void*>& cache, const char* name) {
+    auto function = cache.load(std::memory_order_acquire);
+    if (function == nullptr) {
+        function = dlsym(RTLD_NEXT, name);
+        cache.store(function, std::memory_order_release);
+    }
+    return function;
+}
+
+#define ADDSYNTH_NEXT(name) \
+    static std::atomic<void*> next_##name{ nullptr }; \
+    auto real_##name = reinterpret_cast<decltype(&::name)>(getNext(next_##name, #name))
+
+} // namespace
+
+//==============================================================================
+// allocation
+
+extern "C" {
+
+void* malloc(size_t size) {
+    reportViolation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    reportViolation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    reportViolation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) {
+    reportViolation("posix_memalign");
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    auto ptr = __libc_memalign(alignment, size);
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *result = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    reportViolation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr) {
+    if (ptr != nullptr) {
+        reportViolation("free");
+    }
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+void* operator new(std::size_t size) {
+    reportViolation("operator new");
+    if (auto ptr = __libc_malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    reportViolation("operator new");
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    reportViolation("operator new");
+    if (auto ptr = __libc_memalign(static_cast<size_t>(alignment), size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        reportViolation("operator delete");
+    }
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+//==============================================================================
+// locking, waiting and sleeping
+
+extern "C" {
+
+/*
+* Every lock is reported, whether it blocks right now or not: a lock which is free in a single-threaded check may be 
+* held by another thread in a host. Only the locks which no other thread takes are left out, see ignoreLock.
+*/
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (!cw::synth::rtsafety::isIgnoredLock(mutex)) {
+        reportViolation("pthread_mutex_lock");
+    }
+    ADDSYNTH_NEXT(pthread_mutex_lock);
+    return real_pthread_mutex_lock(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    reportViolation("pthread_rwlock_rdlock");
+    ADDSYNTH_NEXT(pthread_rwlock_rdlock);
+    return real_pthread_rwlock_rdlock(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    reportViolation("pthread_rwlock_wrlock");
+    ADDSYNTH_NEXT(pthread_rwlock_wrlock);
+    return real_pthread_rwlock_wrlock(lock);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    reportViolation("pthread_cond_wait");
+    ADDSYNTH_NEXT(pthread_cond_wait);
+    return real_pthread_cond_wait(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+    reportViolation("pthread_cond_timedwait");
+    ADDSYNTH_NEXT(pthread_cond_timedwait);
+    return real_pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+int pthread_join(pthread_t thread, void** result) {
+    reportViolation("pthread_join");
+    ADDSYNTH_NEXT(pthread_join);
+    return real_pthread_join(thread, result);
+}
+
+int sem_wait(sem_t* semaphore) {
+    reportViolation("sem_wait");
+    ADDSYNTH_NEXT(sem_wait);
+    return real_sem_wait(semaphore);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    reportViolation("nanosleep");
+    ADDSYNTH_NEXT(nanosleep);
+    return real_nanosleep(duration, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+    reportViolation("usleep");
+    ADDSYNTH_NEXT(usleep);
+    return real_usleep(microseconds);
+}
+
+unsigned int sleep(unsigned int seconds) {
+    reportViolation("sleep");
+    ADDSYNTH_NEXT(sleep);
+    return real_sleep(seconds);
+}
+
+//==============================================================================
+// memory mapping, which enters the kernel and may wait for page faults or for the lock of the address space
+
+void* mmap(void* address, size_t length, int protection, int flags, int fd, off_t offset) {
+    reportViolation("mmap");
+    ADDSYNTH_NEXT(mmap);
+    return real_mmap(address, length, protection, flags, fd, offset);
+}
+
+int munmap(void* address, size_t length) {
+    reportViolation("munmap");
+    ADDSYNTH_NEXT(munmap);
+    return real_munmap(address, length);
+}
+
+int madvise(void* address, size_t length, int advice) {
+    reportViolation("madvise");
+    ADDSYNTH_NEXT(madvise);
+    return real_madvise(address, length, advice);
+}
+
+int mprotect(void* address, size_t length, int protection) {
+    reportViolation("mprotect");
+    ADDSYNTH_NEXT(mprotect);
+    return real_mprotect(address, length, protection);
+}
+
+//==============================================================================
+// file I/O
+
+ssize_t read(int fd, void* buffer, size_t count) {
+    reportViolation("read");
+    ADDSYNTH_NEXT(read);
+    return real_read(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void* buffer, size_t count) {
+    reportViolation("write");
+    ADDSYNTH_NEXT(write);
+    return real_write(fd, buffer, count);
+}
+
+int fsync(int fd) {
+    reportViolation("fsync");
+    ADDSYNTH_NEXT(fsync);
+    return real_fsync(fd);
+}
+
+} // extern "C"
@@ -0,0 +1,98 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "RenderComparison.h"
+#include <cmath>
+
+namespace cw::tools {
+
+namespace {
+
+constexpr int fftOrder = 12;
+constexpr int fftSize = 1 << fftOrder;
+constexpr int hopSize = fftSize / 2;
+
+/*
+* Adds the energy of the difference of the magnitude spectra of both channels, and the energy of the reference 
+* magnitude spectrum, over all frames with a Hann window.
+*/
+void addSpectralEnergies(const float* rendered, const float* reference, int numSamples, double& differenceEnergy,
+    double& referenceEnergy) {
+    juce::dsp::FFT fft(fftOrder);
+    juce::dsp::WindowingFunction<float> window(fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    std::vector<float> renderedFrame(2 * fftSize);
+    std::vector<float> referenceFrame(2 * fftSize);
+
+    for (int start = 0; start < numSamples; start += hopSize) {
+        const int frameLength = juce::jmin(fftSize, numSamples - start);
+        std::fill(renderedFrame.begin(), renderedFrame.end(), 0.f);
+        std::fill(referenceFrame.begin(), referenceFrame.end(), 0.f);
+        std::copy(rendered + start, rendered + start + frameLength, renderedFrame.begin());
+        std::copy(reference + start, reference + start + frameLength, referenceFrame.begin());
+
+        window.multiplyWithWindowingTable(renderedFrame.data(), fftSize);
+        window.multiplyWithWindowingTable(referenceFrame.data(), fftSize);
+        fft.performFrequencyOnlyForwardTransform(renderedFrame.data());
+        fft.performFrequencyOnlyForwardTransform(referenceFrame.data());
+
+        for (int bin = 0; bin <= fftSize / 2; ++bin) {
+            const double difference = renderedFrame[bin] - referenceFrame[bin];
+            differenceEnergy += difference * difference;
+            referenceEnergy += (double)referenceFrame[bin] * referenceFrame[bin];
+        }
+    }
+}
+
+} // namespace
+
+RenderDifference compareRenders(const juce::AudioBuffer<float>& rendered, const juce::AudioBuffer<float>& reference) {
+    RenderDifference result;
+    if (rendered.getNumChannels() != reference.getNumChannels()
+        || rendered.getNumSamples() != reference.getNumSamples()) {
+        result.sizeMismatch = true;
+        return result;
+    }
+
+    const int numChannels = reference.getNumChannels();
+    const int numSamples = reference.getNumSamples();
+    double squaredError = 0.;
+    double differenceEnergy = 0.;
+    double referenceEnergy = 0.;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const auto* renderedData = rendered.getReadPointer(channel);
+        const auto* referenceData = reference.getReadPointer(channel);
+        for (int i = 0; i < numSamples; ++i) {
+            const double error = renderedData[i] - referenceData[i];
+            result.maxAbsError = juce::jmax(result.maxAbsError, std::abs(error));
+            squaredError += error * error;
+        }
+        addSpectralEnergies(renderedData, referenceData, numSamples, differenceEnergy, referenceEnergy);
+    }
+
+    const auto totalSamples = (double)numChannels * numSamples;
+    result.rmsError = totalSamples > 0. ? std::sqrt(squaredError / totalSamples) : 0.;
+    if (differenceEnergy > 0.) {
+        // a silent reference only matches a silent rendering
+        result.spectralDifferenceDb = referenceEnergy > 0.
+            ? 10. * std::log10(differenceEnergy / referenceEnergy) : std::numeric_limits<double>::infinity();
+    }
+    return result;
+}
+
+} // namespace cw::tools
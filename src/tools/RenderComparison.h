@@ -0,0 +1,52 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace cw::tools {
+
+/**
+ * Differences between a rendering and its reference. The spectral difference compares the magnitude spectra only, so
+ * that it stays meaningful for approximations whose phase drifts: it is the energy of the difference of the short 
+ * time magnitude spectra relative to the energy of the reference spectra, in dB.
+ */
+struct RenderDifference {
+    double maxAbsError{ 0. };
+    double rmsError{ 0. };
+    double spectralDifferenceDb{ -std::numeric_limits<double>::infinity() };
+    // set if the renderings differ in the number of channels or samples, the errors are meaningless then
+    bool sizeMismatch{ false };
+};
+
+// Upper limits for the differences, above which a rendering fails the comparison.
+struct RenderTolerances {
+    double maxAbsError{ 1e-3 };
+    double rmsError{ 1e-4 };
+    double spectralDifferenceDb{ -60. };
+
+    bool accepts(const RenderDifference& difference) const {
+        return !difference.sizeMismatch && difference.maxAbsError <= maxAbsError && difference.rmsError <= rmsError
+            && difference.spectralDifferenceDb <= spectralDifferenceDb;
+    }
+};
+
+RenderDifference compareRenders(const juce::AudioBuffer<float>& rendered, const juce::AudioBuffer<float>& reference);
+
+} // namespace cw::tools
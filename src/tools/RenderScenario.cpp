@@ -0,0 +1,230 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "RenderScenario.h"
+
+namespace cw::tools {
+
+namespace {
+    // velocity used for all scenario notes
+    const float noteVelocity = 0.8f;
+    // upper limit for the time to bake a waveform, which normally takes a few milliseconds
+    constexpr int bakeTimeoutMs = 5000;
+
+    void addNote(juce::MidiBuffer& buffer, int noteNumber, double startSeconds, double lengthSeconds,
+        double sampleRate) {
+        buffer.addEvent(juce::MidiMessage::noteOn(1, noteNumber, noteVelocity), (int)(startSeconds * sampleRate));
+        buffer.addEvent(juce::MidiMessage::noteOff(1, noteNumber),
+            (int)((startSeconds + lengthSeconds) * sampleRate));
+    }
+
+    // Four-note chords, each held for 1.5 s, followed by 0.5 s for the release.
+    void createChords(juce::MidiBuffer& buffer, const RenderSettings& settings) {
+        const int progression[4][4] = { {60, 64, 67, 71}, {65, 69, 72, 76}, {67, 71, 74, 77}, {57, 60, 64, 69} };
+        const double chordPeriod = 2.;
+        const double chordLength = 1.5;
+
+        int chordNo = 0;
+        for (double start = 0.; start + chordLength < settings.lengthSeconds; start += chordPeriod) {
+            for (auto note : progression[chordNo % 4]) {
+                addNote(buffer, note, start, chordLength, settings.sampleRate);
+            }
+            ++chordNo;
+        }
+    }
+
+    // Sixteenth notes at 120 bpm, up and down two octaves of a minor chord.
+    void createArpeggio(juce::MidiBuffer& buffer, const RenderSettings& settings) {
+        const int pattern[] = { 48, 51, 55, 60, 63, 67, 72, 67, 63, 60, 55, 51 };
+        const double notePeriod = 0.125;
+        const double noteLength = 0.1;
+
+        int noteNo = 0;
+        for (double start = 0.; start + noteLength < settings.lengthSeconds; start += notePeriod) {
+            addNote(buffer, pattern[noteNo % 12], start, noteLength, settings.sampleRate);
+            ++noteNo;
+        }
+    }
+
+    // Holds 1, 2, ..., ADDSYNTH_MAXPOLYPHONY notes at once, each step taking an equal share of the length.
+    void createPolyphonySweep(juce::MidiBuffer& buffer, const RenderSettings& settings) {
+        const double stepLength = settings.lengthSeconds / ADDSYNTH_MAXPOLYPHONY;
+        const double releaseGap = juce::jmin(0.5, stepLength * 0.25);
+
+        for (int step = 0; step < ADDSYNTH_MAXPOLYPHONY; ++step) {
+            for (int voice = 0; voice <= step; ++voice) {
+                addNote(buffer, 36 + 7 * voice, step * stepLength, stepLength - releaseGap, settings.sampleRate);
+            }
+        }
+    }
+} // namespace
+
+double RenderStats::getSamplesPerSecond() const {
+    return renderSeconds > 0. ? samplesRendered / renderSeconds : 0.;
+}
+
+double RenderStats::getRealTimeFactor() const {
+    return renderSeconds > 0. ? (samplesRendered / sampleRate) / renderSeconds : 0.;
+}
+
+double RenderStats::getNanosPerVoiceSample() const {
+    return voiceSamples > 0 ? renderSeconds * 1e9 / voiceSamples : 0.;
+}
+
+double RenderStats::getNanosPerPartialSample() const {
+    return numPartials > 0 ? getNanosPerVoiceSample() / numPartials : 0.;
+}
+
+bool parseScenarioType(const juce::String& name, ScenarioType& type) {
+    if (name == "chords") {
+        type = ScenarioType::chords;
+    }
+    else if (name == "arpeggio") {
+        type = ScenarioType::arpeggio;
+    }
+    else if (name == "sweep") {
+        type = ScenarioType::polyphonySweep;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+juce::String getScenarioName(ScenarioType type) {
+    switch (type) {
+        case ScenarioType::chords: return "chords";
+        case ScenarioType::arpeggio: return "arpeggio";
+        case ScenarioType::polyphonySweep: return "sweep";
+    }
+    return {};
+}
+
+bool parseInterpolation(const juce::String& name, cw::synth::TableInterpolation& interpolation) {
+    if (name == "linear") {
+        interpolation = cw::synth::TableInterpolation::linear;
+    }
+    else if (name == "hermite") {
+        interpolation = cw::synth::TableInterpolation::hermite;
+    }
+    else if (name == "lagrange") {
+        interpolation = cw::synth::TableInterpolation::lagrange;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+juce::MidiBuffer createScenario(const RenderSettings& settings) {
+    juce::MidiBuffer buffer;
+    switch (settings.scenario) {
+        case ScenarioType::chords: createChords(buffer, settings); break;
+        case ScenarioType::arpeggio: createArpeggio(buffer, settings); break;
+        case ScenarioType::polyphonySweep: createPolyphonySweep(buffer, settings); break;
+    }
+    return buffer;
+}
+
+void applyDefaultParameters(cw::synth::AdditiveSynth& synth, int numPartials) {
+    for (auto voice : synth.getVoices()) {
+        for (int i = 0; i < NO_ADDSYNTH_VOICES; ++i) {
+            voice->getHarmProcessor()->setHarmGain(i, i < numPartials ? 1.f / (i + 1) : 0.f);
+        }
+        // same defaults as the parameters of the plugin
+        voice->setAdsrParameters(0.f, 0.5f, 0.5f, 0.1f);
+        voice->setPhi(0.f);
+        voice->setTheta(0.f);
+    }
+}
+
+namespace {
+    // Renders the block as blocks of 1, 2 and the remaining samples, each with its own events.
+    void renderIrregularBlocks(cw::synth::AdditiveSynth& synth, const juce::MidiBuffer& events, 
+        juce::MidiBuffer& partEvents, juce::AudioBuffer<float>& block, int numSamples) {
+        int startSample = 0;
+        for (auto length : { 1, 2, numSamples }) {
+            length = juce::jmin(length, numSamples - startSample);
+            if (length <= 0) {
+                break;
+            }
+            partEvents.clear();
+            partEvents.addEvents(events, startSample, length, 0);
+            synth.setMidiBuffer(partEvents);
+            synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&block, startSample, length));
+            startSample += length;
+        }
+    }
+} // namespace
+
+RenderStats renderScenario(cw::synth::AdditiveSynth& synth, const juce::MidiBuffer& events,
+    const RenderSettings& settings,
+    const std::function<void(const juce::AudioBuffer<float>&, int)>& onBlockRendered) {
+
+    RenderStats stats;
+    stats.sampleRate = settings.sampleRate;
+    stats.numPartials = juce::jlimit(0, NO_ADDSYNTH_VOICES, settings.numPartials);
+
+    synth.prepareToPlay(settings.blockSize, settings.sampleRate);
+    synth.setBakedWaveformEnabled(settings.bakedWaveform);
+    synth.setWavetableMorph(settings.wavetableMorph);
+    synth.setProcessingQuantum(settings.quantum, settings.quantumBuffered);
+    synth.setRenderAhead(settings.renderAhead);
+    for (auto voice : synth.getVoices()) {
+        voice->setInterpolation(settings.interpolation);
+    }
+    if (settings.bakedWaveform) {
+        synth.waitForBakedWaveform(bakeTimeoutMs);
+    }
+
+    const auto totalSamples = (juce::int64)(settings.lengthSeconds * settings.sampleRate);
+    const auto& voices = synth.getVoices();
+    juce::AudioBuffer<float> block(2, settings.blockSize);
+    juce::MidiBuffer blockEvents;
+    juce::MidiBuffer partEvents;
+
+    for (juce::int64 pos = 0; pos < totalSamples; pos += settings.blockSize) {
+        const int numSamples = (int)juce::jmin((juce::int64)settings.blockSize, totalSamples - pos);
+        blockEvents.clear();
+        blockEvents.addEvents(events, (int)pos, numSamples, -(int)pos);
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        if (settings.irregularBlocks) {
+            renderIrregularBlocks(synth, blockEvents, partEvents, block, numSamples);
+        }
+        else {
+            synth.setMidiBuffer(blockEvents);
+            synth.getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, numSamples));
+        }
+        stats.renderSeconds += juce::Time::highResolutionTicksToSeconds(
+            juce::Time::getHighResolutionTicks() - startTicks);
+
+        for (auto voice : voices) {
+            if (voice->isVoiceActive()) {
+                stats.voiceSamples += numSamples;
+            }
+        }
+        stats.samplesRendered += numSamples;
+
+        onBlockRendered(block, numSamples);
+    }
+
+    return stats;
+}
+
+} // namespace cw::tools
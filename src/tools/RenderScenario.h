@@ -0,0 +1,111 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include "../synth/AdditiveSynth.h"
+
+namespace cw::tools {
+
+enum class ScenarioType {
+    chords,
+    arpeggio,
+    polyphonySweep
+};
+
+/**
+ * Settings describing an offline rendering run. Every tool which drives the synth core without a host uses these, so
+ * that measurements taken with different tools are comparable.
+ */
+struct RenderSettings {
+    ScenarioType scenario{ ScenarioType::chords };
+    double sampleRate{ 44100. };
+    int blockSize{ 512 };
+    double lengthSeconds{ 10. };
+    // number of harmonics with a non-zero gain, the remaining ones are muted
+    int numPartials{ NO_ADDSYNTH_VOICES };
+    // play the harmonics as a baked waveform
+    bool bakedWaveform{ false };
+    // position between the first and the last frame of the wavetable, if the synth plays one
+    float wavetableMorph{ 0.f };
+    // interpolation of the sound table
+    cw::synth::TableInterpolation interpolation{ cw::synth::TableInterpolation::linear };
+    // processing quantum of the synth, 0 for none, and whether it is buffered, see AdditiveSynth::setProcessingQuantum
+    int quantum{ 0 };
+    bool quantumBuffered{ false };
+    // deliver each block as blocks of 1, 2 and the remaining samples, like a host looping at every block
+    bool irregularBlocks{ false };
+    // let a worker thread render the held notes ahead, see AdditiveSynth::setRenderAhead
+    bool renderAhead{ false };
+};
+
+/**
+ * Timing results of an offline rendering run. The render time only covers the synth itself, not the generation of
+ * the scenario or writing the output.
+ */
+struct RenderStats {
+    juce::int64 samplesRendered{ 0 };
+    // sum over all blocks of the number of active voices times the block length
+    juce::int64 voiceSamples{ 0 };
+    double renderSeconds{ 0. };
+    double sampleRate{ 44100. };
+    // the number of sounding partials of each voice
+    int numPartials{ NO_ADDSYNTH_VOICES };
+
+    double getSamplesPerSecond() const;
+    double getRealTimeFactor() const;
+    // nanoseconds spent per sample of one sounding voice
+    double getNanosPerVoiceSample() const;
+    // nanoseconds spent per sample of one partial of a sounding voice
+    double getNanosPerPartialSample() const;
+};
+
+/**
+ * Parses the scenario name as given on the command line ("chords", "arpeggio", "sweep"). Returns false if the name is
+ * unknown.
+ */
+bool parseScenarioType(const juce::String& name, ScenarioType& type);
+juce::String getScenarioName(ScenarioType type);
+
+// Parses the interpolation as given on the command line ("linear", "hermite", "lagrange").
+bool parseInterpolation(const juce::String& name, cw::synth::TableInterpolation& interpolation);
+
+/**
+ * Creates the MIDI events of the given scenario for the whole length of the rendering run. The timestamps of the
+ * buffer are sample positions relative to the start of the run.
+ */
+juce::MidiBuffer createScenario(const RenderSettings& settings);
+
+/**
+ * Sets the harmonic gains and envelope of all voices to the defaults of the plugin, with the first numPartials
+ * harmonics falling off as 1/n.
+ */
+void applyDefaultParameters(cw::synth::AdditiveSynth& synth, int numPartials);
+
+/**
+ * Renders the given MIDI events block by block through the synth. After each block, the callback receives the
+ * rendered audio together with the number of valid samples in it. Only the time spent inside the synth is counted
+ * for the returned statistics. A buffered processing quantum delays the audio by its latency.
+ */
+RenderStats renderScenario(cw::synth::AdditiveSynth& synth, const juce::MidiBuffer& events,
+    const RenderSettings& settings,
+    const std::function<void(const juce::AudioBuffer<float>&, int)>& onBlockRendered);
+
+} // namespace cw::tools
@@ -0,0 +1,35 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "Arena.h"
+#include <cstring>
+
+namespace cw::synth {
+
+void Arena::allocate(size_t sizeInBytes) {
+    if (sizeInBytes > size) {
+        memory.reset(static_cast<std::byte*>(::operator new[](sizeInBytes, std::align_val_t(alignment))));
+        size = sizeInBytes;
+    }
+    if (size > 0) {
+        std::memset(memory.get(), 0, size);
+    }
+    used = 0;
+}
+
+} // namespace cw::synth
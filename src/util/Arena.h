@@ -0,0 +1,78 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace cw::synth {
+
+/**
+ * One contiguous, cache-aligned block of memory, which is handed out in slices, e.g. for the working buffers of all 
+ * voices of a synth, so that they lie next to each other instead of being scattered over the heap. The memory is 
+ * allocated once, outside the audio thread; taking slices never allocates.
+ */
+class Arena {
+    public:
+        static constexpr size_t alignment = 64;
+
+        // The number of bytes which a slice of the given number of elements takes, including its alignment.
+        template <typename T>
+        static constexpr size_t getSliceSize(size_t count) {
+            return (count * sizeof(T) + alignment - 1) / alignment * alignment;
+        }
+
+        /*
+        * Allocates zeroed memory of the given size, if the current memory is smaller, and hands out slices from its 
+        * start again. All slices taken before become invalid.
+        */
+        void allocate(size_t sizeInBytes);
+
+        /*
+        * Takes a slice of the given number of elements, aligned to the cache lines. The elements are neither 
+        * constructed nor cleared. Returns null if the arena is exhausted.
+        */
+        template <typename T>
+        T* take(size_t count) {
+            const auto sliceSize = getSliceSize<T>(count);
+            if (used + sliceSize > size) {
+                return nullptr;
+            }
+            auto* slice = reinterpret_cast<T*>(memory.get() + used);
+            used += sliceSize;
+            return slice;
+        }
+
+        size_t getSize() const { return size; }
+        size_t getUsed() const { return used; }
+
+    private:
+        struct AlignedDelete {
+            void operator()(std::byte* block) const {
+                ::operator delete[](block, std::align_val_t(alignment));
+            }
+        };
+
+        std::unique_ptr<std::byte[], AlignedDelete> memory;
+        size_t size{ 0 };
+        size_t used{ 0 };
+};
+
+} // namespace cw::synth
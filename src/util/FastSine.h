@@ -0,0 +1,66 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <cmath>
+
+namespace cw::synth::fastsine {
+
+/*
+ * Minimax coefficients of odd polynomials for sin(2 pi x) on [-1/4, 1/4], i.e. the coefficients of x, x^3, x^5 etc.
+ * The maximum errors are 6.8e-5 (5th degree), 5.9e-7 (7th degree) and 3.3e-9 (9th degree).
+ */
+template <int Degree>
+struct Coefficients;
+
+template <>
+struct Coefficients<5> {
+    static constexpr double c[] = { 6.28128007662239049, -41.0952426871437340, 73.5855147350246459 };
+};
+
+template <>
+struct Coefficients<7> {
+    static constexpr double c[] = { 6.28316404430247247, -41.3371423711002458, 81.3407688876673973,
+        -70.9934332720955086 };
+};
+
+template <>
+struct Coefficients<9> {
+    static constexpr double c[] = { 6.28318516008947755, -41.3416550314163046, 81.6010040732634811,
+        -76.5497822936347782, 39.5367060660182837 };
+};
+
+/*
+ * sin(2 pi phase), for a phase in periods. The phase is folded onto [-1/4, 1/4] without branches, where the 
+ * polynomial is evaluated in the precision of the samples, so that loops over it can be vectorized.
+ */
+template <int Degree, typename SampleType>
+inline SampleType sine(double phase) {
+    const double shifted = phase + 0.25;
+    const auto x = (SampleType)(0.25 - std::abs(shifted - std::floor(shifted) - 0.5));
+    const auto x2 = x * x;
+    constexpr auto& c = Coefficients<Degree>::c;
+    auto result = (SampleType)c[Degree / 2];
+    for (int k = Degree / 2 - 1; k >= 0; --k) {
+        result = result * x2 + (SampleType)c[k];
+    }
+    return result * x;
+}
+
+} // namespace cw::synth::fastsine
@@ -0,0 +1,71 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+namespace cw::synth::interpolation {
+
+/*
+ * Interpolators between the samples y[0] and y[1] at the fraction x. They read the neighbours around, from y[-1] to 
+ * y[2] (Hermite) or from y[-2] to y[3] (Lagrange), which padded tables provide without wrapping.
+ */
+
+template <typename SampleType>
+inline SampleType linear(const float* y, SampleType x) {
+    return y[0] + x * (y[1] - y[0]);
+}
+
+// 4-point, 3rd-order Hermite (Catmull-Rom)
+template <typename SampleType>
+inline SampleType hermite(const float* y, SampleType x) {
+    const SampleType c1 = (SampleType)0.5 * (y[1] - y[-1]);
+    const SampleType c2 = y[-1] - (SampleType)2.5 * y[0] + (SampleType)2 * y[1] - (SampleType)0.5 * y[2];
+    const SampleType c3 = (SampleType)0.5 * (y[2] - y[-1]) + (SampleType)1.5 * (y[0] - y[1]);
+    return ((c3 * x + c2) * x + c1) * x + y[0];
+}
+
+// 6-point, 5th-order Lagrange, through the samples y[-2] to y[3]
+template <typename SampleType>
+inline SampleType lagrange(const float* y, SampleType x) {
+    // the distances to the six points
+    const SampleType d0 = x + 2;
+    const SampleType d1 = x + 1;
+    const SampleType d2 = x;
+    const SampleType d3 = x - 1;
+    const SampleType d4 = x - 2;
+    const SampleType d5 = x - 3;
+    // the products of the distances to all points below and above each point
+    const SampleType below1 = d0;
+    const SampleType below2 = below1 * d1;
+    const SampleType below3 = below2 * d2;
+    const SampleType below4 = below3 * d3;
+    const SampleType below5 = below4 * d4;
+    const SampleType above4 = d5;
+    const SampleType above3 = above4 * d4;
+    const SampleType above2 = above3 * d3;
+    const SampleType above1 = above2 * d2;
+    const SampleType above0 = above1 * d1;
+    return (SampleType)(-1. / 120.) * y[-2] * above0
+        + (SampleType)(1. / 24.) * y[-1] * below1 * above1
+        + (SampleType)(-1. / 12.) * y[0] * below2 * above2
+        + (SampleType)(1. / 12.) * y[1] * below3 * above3
+        + (SampleType)(-1. / 24.) * y[2] * below4 * above4
+        + (SampleType)(1. / 120.) * y[3] * below5;
+}
+
+} // namespace cw::synth::interpolation
@@ -0,0 +1,111 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "RealtimeSafety.h"
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+namespace cw::synth::rtsafety {
+
+namespace {
+
+// Nesting depth of the realtime sections of the current thread.
+thread_local int sectionDepth = 0;
+// Set while the current thread reports a violation, so that the allocations of the report are not reported again.
+thread_local bool isReporting = false;
+
+std::atomic<int> numViolations{ 0 };
+std::atomic<bool> abortOnViolation{ false };
+// the locks left out of the reports, empty slots are null
+std::array<std::atomic<const void*>, maxIgnoredLocks> ignoredLocks{};
+
+} // namespace
+
+ScopedRealtimeSection::ScopedRealtimeSection() {
+    ++sectionDepth;
+}
+
+ScopedRealtimeSection::~ScopedRealtimeSection() {
+    --sectionDepth;
+}
+
+bool isInRealtimeSection() noexcept {
+    return sectionDepth > 0 && !isReporting;
+}
+
+void reportViolation(const char* operation) {
+    if (!isInRealtimeSection()) {
+        return;
+    }
+    isReporting = true;
+
+    numViolations.fetch_add(1);
+    // stdio instead of the JUCE logger, which locks
+    std::fprintf(stderr, "Realtime safety violation: %s\n%s\n", operation,
+        juce::SystemStats::getStackBacktrace().toRawUTF8());
+    std::fflush(stderr);
+
+    if (abortOnViolation.load()) {
+        std::abort();
+    }
+    isReporting = false;
+}
+
+void ignoreLock(const void* lock) noexcept {
+    for (auto& slot : ignoredLocks) {
+        const void* empty = nullptr;
+        if (slot.compare_exchange_strong(empty, lock)) {
+            return;
+        }
+    }
+    jassertfalse;
+}
+
+void stopIgnoringLock(const void* lock) noexcept {
+    for (auto& slot : ignoredLocks) {
+        const void* expected = lock;
+        if (slot.compare_exchange_strong(expected, nullptr)) {
+            return;
+        }
+    }
+}
+
+bool isIgnoredLock(const void* lock) noexcept {
+    for (const auto& slot : ignoredLocks) {
+        if (slot.load(std::memory_order_relaxed) == lock) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int getNumViolations() noexcept {
+    return numViolations.load();
+}
+
+void resetViolations() noexcept {
+    numViolations.store(0);
+}
+
+void setAbortOnViolation(bool shouldAbort) noexcept {
+    abortOnViolation.store(shouldAbort);
+}
+
+} // namespace cw::synth::rtsafety
@@ -0,0 +1,73 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Detection of operations which are not realtime safe (allocations, locks, sleeping, memory mapping, file I/O) while the
+ * audio thread is processing. The code paths which have to be realtime safe are marked with ADDSYNTH_REALTIME_SECTION.
+ * The marking costs nothing unless ADDSYNTH_RT_SAFETY_CHECKS is defined; the detection itself is done by hooks which
+ * intercept the operations in question and call reportViolation() (see tools/RealtimeSafetyHooks.cpp).
+ */
+namespace cw::synth::rtsafety {
+
+/**
+ * Marks the current thread as being in a realtime section for the lifetime of the object. Sections may be nested.
+ */
+class ScopedRealtimeSection {
+    public:
+        ScopedRealtimeSection();
+        ~ScopedRealtimeSection();
+
+        ScopedRealtimeSection(const ScopedRealtimeSection&) = delete;
+        ScopedRealtimeSection& operator=(const ScopedRealtimeSection&) = delete;
+};
+
+// Whether the current thread is in a realtime section and is not reporting a violation right now.
+bool isInRealtimeSection() noexcept;
+
+/*
+* Reports an operation which is not realtime safe, if the current thread is in a realtime section: prints the
+* operation together with a stack trace and counts it. Aborts if setAbortOnViolation(true) was called. The realtime
+* section is suspended while reporting, so the report itself is free to allocate.
+*/
+void reportViolation(const char* operation);
+
+/*
+* Leaves a lock out of the reports, for locks which nothing but the audio thread takes while it processes, e.g. the 
+* lock which juce::Synthesiser takes around each block and each MIDI event. Takes the address of the 
+* juce::CriticalSection, which holds nothing but its mutex on POSIX. Up to maxIgnoredLocks at a time.
+*/
+constexpr int maxIgnoredLocks = 64;
+void ignoreLock(const void* lock) noexcept;
+void stopIgnoringLock(const void* lock) noexcept;
+bool isIgnoredLock(const void* lock) noexcept;
+
+int getNumViolations() noexcept;
+void resetViolations() noexcept;
+void setAbortOnViolation(bool shouldAbort) noexcept;
+
+} // namespace cw::synth::rtsafety
+
+#if ADDSYNTH_RT_SAFETY_CHECKS
+ #define ADDSYNTH_REALTIME_SECTION const cw::synth::rtsafety::ScopedRealtimeSection JUCE_JOIN_MACRO(rtSection_, __LINE__)
+#else
+ #define ADDSYNTH_REALTIME_SECTION
+#endif
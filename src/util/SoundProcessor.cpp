@@ -19,12 +19,55 @@
 #include "SoundProcessor.h"
 #include <memory>
 #include <cmath>
+#include <algorithm>
 
 namespace cw::synth {
+    std::array<double, NO_ADDSYNTH_VOICES> PartialRatios::getRatios() const {
+        std::array<double, NO_ADDSYNTH_VOICES> ratios;
+        switch (tuning) {
+            case PartialTuning::stretched: {
+                // relative to the first partial, which is stretched as well
+                const double b = juce::jmax(0.f, stretch);
+                for (int n = 1; n <= NO_ADDSYNTH_VOICES; ++n) {
+                    ratios[n - 1] = n * std::sqrt((1. + b * n * n) / (1. + b));
+                }
+                break;
+            }
+            case PartialTuning::bell: {
+                // hum, prime, tierce, quint, nominal and the upper partials of a church bell
+                constexpr std::array<double, NO_ADDSYNTH_VOICES> bell{ 0.5, 1., 1.183, 1.506, 2., 2.514, 2.662, 3.011,
+                    4.166, 5.433, 6.796, 8.215, 9.681, 11.187, 12.728, 14.298 };
+                ratios = bell;
+                break;
+            }
+            case PartialTuning::bar: {
+                // the bending modes of a bar with free ends, which go with the square of the roots of cos x cosh x = 1
+                constexpr std::array<double, 4> roots{ 4.7300408, 7.8532046, 10.9956078, 14.1371655 };
+                for (int n = 0; n < NO_ADDSYNTH_VOICES; ++n) {
+                    const double root = n < (int)roots.size() ? roots[n] 
+                        : (n + 1.5) * juce::MathConstants<double>::pi;
+                    ratios[n] = root * root / (roots[0] * roots[0]);
+                }
+                break;
+            }
+            case PartialTuning::custom:
+                for (int n = 0; n < NO_ADDSYNTH_VOICES; ++n) {
+                    ratios[n] = juce::jmax(0.f, custom[n]);
+                }
+                break;
+            default:
+                for (int n = 0; n < NO_ADDSYNTH_VOICES; ++n) {
+                    ratios[n] = n + 1;
+                }
+                break;
+        }
+        return ratios;
+    }
+
     std::vector<float> HarmonicSoundProcessor::process(int noSamples, float refFrequency, int midiNoteNumber) {
-        // A4: midi no. 69, pitch 440 Hz
-        float midiFreq = 440. * std::pow(2., (midiNoteNumber - 69.)/12.);
-        return process(noSamples, midiFreq, refFrequency);
+        auto result = std::vector<float>(noSamples);
+        process(result.data(), noSamples, refFrequency, midiNoteNumber);
+        return result;
     }
     std::vector<float> HarmonicSoundProcessor::process(int noSamples, float frequency, float refFreq) {
         return process(noSamples, frequency/refFreq);
@@ -32,34 +75,587 @@ namespace cw::synth {
     }
     std::vector<float> HarmonicSoundProcessor::process(int noSamples, float playingFactor) {
         auto result = std::vector<float>(noSamples);
-        float a_0, a_1; // linear interpolation: y_f = a_1*x_f + a_0
-        int pos_0, pos_1;
+        process(result.data(), noSamples, playingFactor);
+        return result;
+    }
+
+    void HarmonicSoundProcessor::process(float* output, int noSamples, float refFrequency, int midiNoteNumber) {
+        // A4: midi no. 69, pitch 440 Hz
+        float midiFreq = 440. * std::pow(2., (midiNoteNumber - 69.)/12.);
+        process(output, noSamples, midiFreq / refFrequency);
+    }
+
+    void HarmonicSoundProcessor::process(double* output, int noSamples, double refFrequency, int midiNoteNumber) {
+        const double midiFreq = 440. * std::pow(2., (midiNoteNumber - 69.) / 12.);
+        process(output, noSamples, midiFreq / refFrequency);
+    }
+
+    void HarmonicSoundProcessor::process(float* output, int noSamples, float playingFactor) {
+        processSamples(output, noSamples, playingFactor);
+    }
+
+    void HarmonicSoundProcessor::process(double* output, int noSamples, double playingFactor) {
+        processSamples(output, noSamples, playingFactor);
+    }
+
+    void HarmonicSoundProcessor::process(float* left, float* right, int noSamples, float refFrequency, 
+        int midiNoteNumber) {
+        if (unisonVoices == 1) {
+            process(left, noSamples, refFrequency, midiNoteNumber);
+            std::copy(left, left + noSamples, right);
+            return;
+        }
+        const float midiFreq = 440. * std::pow(2., (midiNoteNumber - 69.) / 12.);
+        processUnison(left, right, noSamples, midiFreq / refFrequency);
+    }
+
+    void HarmonicSoundProcessor::process(double* left, double* right, int noSamples, double refFrequency, 
+        int midiNoteNumber) {
+        if (unisonVoices == 1) {
+            process(left, noSamples, refFrequency, midiNoteNumber);
+            std::copy(left, left + noSamples, right);
+            return;
+        }
+        const double midiFreq = 440. * std::pow(2., (midiNoteNumber - 69.) / 12.);
+        processUnison(left, right, noSamples, midiFreq / refFrequency);
+    }
+
+    void HarmonicSoundProcessor::setUnison(int voices, float detuneCents, float spread) {
+        voices = juce::jlimit(1, maxUnisonVoices, voices);
+        detuneCents = juce::jmax(0.f, detuneCents);
+        spread = juce::jlimit(0.f, 1.f, spread);
+        if (voices == unisonVoices && detuneCents == unisonDetune && spread == unisonSpread) {
+            return;
+        }
+        unisonVoices = voices;
+        unisonDetune = detuneCents;
+        unisonSpread = spread;
+        updateUnisonLanes();
+        ++parameterVersion;
+    }
+
+    void HarmonicSoundProcessor::updateUnisonLanes() {
+        const int voices = unisonVoices;
+        // the copies are spaced evenly from -detune to +detune and from left to right, and their sum keeps the level
+        const float norm = 1.f / std::sqrt((float)voices);
+        for (int lane = 0; lane < maxUnisonVoices; ++lane) {
+            const float position = voices > 1 && lane < voices ? 2.f * lane / (voices - 1) - 1.f : 0.f;
+            unisonRatio[lane] = std::pow(2., unisonDetune * position / 1200.);
+            const float pan = unisonSpread * position;
+            unisonLeft[lane] = lane < voices ? norm * (pan <= 0.f ? 1.f : 1.f - pan) : 0.f;
+            unisonRight[lane] = lane < voices ? norm * (pan >= 0.f ? 1.f : 1.f + pan) : 0.f;
+        }
+    }
+
+    template <typename SampleType>
+    void HarmonicSoundProcessor::processSamples(SampleType* output, int noSamples, SampleType playingFactor) {
+        if (wavetable != nullptr) {
+            processWavetable(output, noSamples, playingFactor);
+            return;
+        }
+        if (engine == OscillatorEngine::phasor) {
+            processPhasors(output, noSamples, playingFactor);
+            return;
+        }
+        if (engine != OscillatorEngine::table) {
+            visitSineDegree([&](auto degree) {
+                processSines<decltype(degree)::value>(output, noSamples, playingFactor);
+            });
+            return;
+        }
+
+        const float* table = sound->data();
+        const size_t tableSize = sound->size();
+        const double increment = (double)tableSize / sampleRate * playingFactor;
+        updatePartialIncrements(increment);
+        if (sound->isMapped()) {
+            prefetch(increment, noSamples);
+        }
+        if (interpolation == TableInterpolation::hermite) {
+            processInterpolated(output, noSamples, [](const float* y, SampleType x) {
+                return interpolation::hermite(y, x);
+            });
+            return;
+        }
+        if (interpolation == TableInterpolation::lagrange) {
+            processInterpolated(output, noSamples, [](const float* y, SampleType x) {
+                return interpolation::lagrange(y, x);
+            });
+            return;
+        }
 
         for (int samp = 0; samp < noSamples; ++samp) {
-            result[samp] = 0;
+            output[samp] = 0;
             
             for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
-                // determine interpolation values
-                pos_0 = (int)continuousPos[harm] % sound.size();
-                pos_1 = (pos_0 + 1) % sound.size();
-                a_1 = sound.at(pos_1) - sound.at(pos_0);
-                a_0 = (float)pos_0 * (sound.at(pos_0) - sound.at(pos_1)) + sound.at(pos_0);
+                // linear interpolation between the neighbouring samples
+                const auto pos_0 = (size_t)continuousPos[harm] % tableSize;
+                const auto pos_1 = (pos_0 + 1) % tableSize;
+                const auto frac = (SampleType)(continuousPos[harm] - std::floor(continuousPos[harm]));
 
                 // add the interpolated value of the current harmonic times its gain
-                result[samp] += (a_1 * continuousPos[harm] + a_0) * params.harmonicGain[harm];
+                output[samp] += (table[pos_0] + frac * (table[pos_1] - table[pos_0])) * getModulatedGain(harm) 
+                    * partialAudible[harm];
 
                 // increase the position pointer according to the speed and harmonic
-                continuousPos[harm] += sound.size() / sampleRate * playingFactor * (harm + 1);
-                continuousPos[harm] = std::fmod(continuousPos[harm], (float)sound.size());
+                continuousPos[harm] += partialIncrement[harm];
+                continuousPos[harm] = std::fmod(continuousPos[harm], (double)tableSize);
             } 
-            result[samp] /= NO_ADDSYNTH_VOICES;
+            output[samp] /= NO_ADDSYNTH_VOICES;
+            if (gainGlideSamples > 0) {
+                advanceGainModulation(1);
+            }
         }
+    }
 
-        return result;
+    template <typename SampleType, typename Interpolator>
+    void HarmonicSoundProcessor::processInterpolated(SampleType* output, int noSamples, Interpolator interpolator) {
+        std::fill(output, output + noSamples, SampleType(0));
+        const float* table = sound->data();
+        const auto tableSize = (ptrdiff_t)sound->size();
+
+        // one harmonic after the other, so that each loop reads from one region of the table
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            // the increment modulo the table, so that the position wraps around with one subtraction at most
+            const double increment = std::fmod(partialIncrement[harm], (double)tableSize);
+            if (isSilent(harm) || partialAudible[harm] == 0.f) {
+                continuousPos[harm] = std::fmod(continuousPos[harm] + increment * noSamples, (double)tableSize);
+                continue;
+            }
+            // the gain glides along with the offset, as in processWavetable
+            auto gain = getModulatedGain(harm);
+            auto offset = gainOffset[harm];
+            int glideSamples = gainGlideSamples;
+
+            auto renderHarmonic = [&](auto read) {
+                double pos = continuousPos[harm];
+                for (int samp = 0; samp < noSamples; ++samp) {
+                    const auto index = (ptrdiff_t)pos;
+                    output[samp] += read(index, (SampleType)(pos - index)) * gain;
+                    if (glideSamples > 0) {
+                        offset = --glideSamples == 0 ? gainOffsetTarget[harm] : offset + gainOffsetStep[harm];
+                        gain = std::max(0.f, params.harmonicGain[harm] + offset);
+                    }
+                    pos += increment;
+                    if (pos >= tableSize) {
+                        pos -= tableSize;
+                    }
+                }
+                continuousPos[harm] = pos;
+            };
+            if (sound->isPadded()) {
+                // the padding continues the table, the neighbours are read directly
+                renderHarmonic([table, interpolator](ptrdiff_t index, SampleType frac) {
+                    return interpolator(table + index, frac);
+                });
+            }
+            else {
+                // mapped tables are gathered around the position, wrapping around the ends
+                renderHarmonic([table, tableSize, interpolator](ptrdiff_t index, SampleType frac) {
+                    float taps[6];
+                    for (ptrdiff_t tap = 0; tap < 6; ++tap) {
+                        taps[tap] = table[(index + tap - 2 + tableSize) % tableSize];
+                    }
+                    return interpolator(taps + 2, frac);
+                });
+            }
+        }
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            output[samp] /= NO_ADDSYNTH_VOICES;
+        }
+        if (gainGlideSamples > 0) {
+            advanceGainModulation(noSamples);
+        }
+    }
+
+    void HarmonicSoundProcessor::prefetch(double increment, int noSamples) {
+        const size_t tableSize = sound->size();
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            if (params.harmonicGain[harm] == 0.f && !gainModulated) {
+                continue;
+            }
+            // a harmonic which skips through the table by large steps reads at random, so the whole table is paged in
+            const auto span = (size_t)(increment * partialRatio[harm] * noSamples) + 1;
+            if (span > maxPrefetchSpan) {
+                sound->requestPrefetchAll();
+                continue;
+            }
+
+            // the window ahead is renewed when the position comes within one block of its end, or has left it
+            const auto window = juce::jmax(prefetchWindow, 2 * span);
+            const auto pos = (size_t)continuousPos[harm] % tableSize;
+            const auto ahead = (prefetchEnd[harm] + tableSize - pos) % tableSize;
+            if (ahead < span || ahead > window) {
+                const auto start = ahead > window ? pos : prefetchEnd[harm];
+                sound->requestPrefetch(start, window);
+                prefetchEnd[harm] = (start + window) % tableSize;
+            }
+        }
+    }
+
+    template <typename SampleType>
+    void HarmonicSoundProcessor::processWavetable(SampleType* output, int noSamples, SampleType playingFactor) {
+        constexpr auto tableSize = (SampleType)Wavetable::tableSize;
+        std::fill(output, output + noSamples, SampleType(0));
+
+        // the two frames around the morph position
+        const auto framePos = morph * (wavetable->getNumFrames() - 1);
+        const int frame0 = (int)framePos;
+        const int frame1 = juce::jmin(frame0 + 1, wavetable->getNumFrames() - 1);
+        const auto frameBlend = (SampleType)(framePos - frame0);
+
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            const auto periodsPerSample = (double)playingFactor * partialRatio[harm] / sampleRate;
+            // harmonics above the Nyquist frequency are left out, as well as those which stay silent in this block
+            if (isSilent(harm) || periodsPerSample >= 0.5) {
+                continue;
+            }
+            // the gain glides along with the offset, as in the per-sample loop of process
+            auto gain = getModulatedGain(harm);
+            auto offset = gainOffset[harm];
+            int glideSamples = gainGlideSamples;
+
+            // the two levels around the level position, both free of aliasing
+            const auto levelPos = Wavetable::getLevelPosition(periodsPerSample);
+            const int level0 = (int)levelPos;
+            const int level1 = juce::jmin(level0 + 1, Wavetable::numLevels - 1);
+            const auto levelBlend = (SampleType)(levelPos - level0);
+            const float* table00 = wavetable->getTable(frame0, level0);
+            const float* table01 = wavetable->getTable(frame0, level1);
+            const float* table10 = wavetable->getTable(frame1, level0);
+            const float* table11 = wavetable->getTable(frame1, level1);
+
+            const auto increment = (SampleType)(tableSize * periodsPerSample);
+            // the position may still stem from the sound, which has a different length
+            auto pos = (SampleType)std::fmod(continuousPos[harm], (double)tableSize);
+            for (int samp = 0; samp < noSamples; ++samp) {
+                const int pos_0 = (int)pos;
+                const SampleType frac = pos - pos_0;
+                const auto lookup = [pos_0, frac](const float* table) {
+                    return table[pos_0] + frac * (table[pos_0 + 1] - table[pos_0]);
+                };
+                const auto value0 = lookup(table00) + levelBlend * (lookup(table01) - lookup(table00));
+                auto value = value0;
+                if (frameBlend > 0) {
+                    const auto value1 = lookup(table10) + levelBlend * (lookup(table11) - lookup(table10));
+                    value += frameBlend * (value1 - value0);
+                }
+                output[samp] += value * gain;
+                if (glideSamples > 0) {
+                    offset = --glideSamples == 0 ? gainOffsetTarget[harm] : offset + gainOffsetStep[harm];
+                    gain = std::max(0.f, params.harmonicGain[harm] + offset);
+                }
+
+                pos += increment;
+                if (pos >= tableSize) {
+                    pos -= tableSize;
+                }
+            }
+            continuousPos[harm] = pos;
+        }
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            output[samp] /= NO_ADDSYNTH_VOICES;
+        }
+        if (gainGlideSamples > 0) {
+            advanceGainModulation(noSamples);
+        }
+    }
+
+    template <int Degree, typename SampleType>
+    void HarmonicSoundProcessor::processSines(SampleType* output, int noSamples, SampleType playingFactor) {
+        std::fill(output, output + noSamples, SampleType(0));
+        // the positions stay in samples of the sound, so that the engine can be switched while playing
+        const double tableSize = (double)sound->size();
+        updatePartialIncrements(tableSize / sampleRate * playingFactor);
+
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            if (isSilent(harm) || partialAudible[harm] == 0.f) {
+                continue;
+            }
+            const double phase = continuousPos[harm] / tableSize;
+            const double increment = partialIncrement[harm] / tableSize;
+            // the gain glides along with the offset, as in processWavetable
+            auto gain = getModulatedGain(harm);
+            auto offset = gainOffset[harm];
+            int glideSamples = gainGlideSamples;
+
+            int samp = 0;
+            for (; samp < noSamples && glideSamples > 0; ++samp) {
+                output[samp] += fastsine::sine<Degree, SampleType>(phase + samp * increment) * gain;
+                offset = --glideSamples == 0 ? gainOffsetTarget[harm] : offset + gainOffsetStep[harm];
+                gain = std::max(0.f, params.harmonicGain[harm] + offset);
+            }
+            // with a constant gain, the samples are independent of each other
+            for (; samp < noSamples; ++samp) {
+                output[samp] += fastsine::sine<Degree, SampleType>(phase + samp * increment) * gain;
+            }
+            continuousPos[harm] = std::fmod(continuousPos[harm] + partialIncrement[harm] * noSamples, tableSize);
+        }
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            output[samp] /= NO_ADDSYNTH_VOICES;
+        }
+        if (gainGlideSamples > 0) {
+            advanceGainModulation(noSamples);
+        }
+    }
+
+    template <typename SampleType>
+    void HarmonicSoundProcessor::processPhasors(SampleType* output, int noSamples, SampleType playingFactor) {
+        constexpr double twoPi = juce::MathConstants<double>::twoPi;
+        // the number of samples after which the phasors are brought back to unit length
+        constexpr int renormalizeInterval = 64;
+        const double tableSize = (double)sound->size();
+        updatePartialIncrements(tableSize / sampleRate * playingFactor);
+
+        /*
+        * The phasors and their rotations per sample, one lane per partial. The phasors start from the positions at the
+        * beginning of each block, so that their phase does not drift beyond a block, and the positions stay valid for 
+        * the other engines.
+        */
+        alignas(64) std::array<SampleType, NO_ADDSYNTH_VOICES> re;
+        alignas(64) std::array<SampleType, NO_ADDSYNTH_VOICES> im;
+        alignas(64) std::array<SampleType, NO_ADDSYNTH_VOICES> rotationRe;
+        alignas(64) std::array<SampleType, NO_ADDSYNTH_VOICES> rotationIm;
+        alignas(64) std::array<float, NO_ADDSYNTH_VOICES> gain;
+        alignas(64) std::array<float, NO_ADDSYNTH_VOICES> offset;
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            const double phase = twoPi * continuousPos[harm] / tableSize;
+            const double step = twoPi * partialIncrement[harm] / tableSize;
+            re[harm] = (SampleType)std::cos(phase);
+            im[harm] = (SampleType)std::sin(phase);
+            rotationRe[harm] = (SampleType)std::cos(step);
+            rotationIm[harm] = (SampleType)std::sin(step);
+            gain[harm] = getModulatedGain(harm) * partialAudible[harm];
+            offset[harm] = gainOffset[harm];
+        }
+        int glideSamples = gainGlideSamples;
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            SampleType sum = 0;
+            for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                sum += im[harm] * gain[harm];
+                const auto nextRe = re[harm] * rotationRe[harm] - im[harm] * rotationIm[harm];
+                im[harm] = re[harm] * rotationIm[harm] + im[harm] * rotationRe[harm];
+                re[harm] = nextRe;
+            }
+            output[samp] = sum / NO_ADDSYNTH_VOICES;
+
+            // the gain glides along with the offset, as in processWavetable
+            if (glideSamples > 0) {
+                const bool lastStep = --glideSamples == 0;
+                for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                    offset[harm] = lastStep ? gainOffsetTarget[harm] : offset[harm] + gainOffsetStep[harm];
+                    gain[harm] = std::max(0.f, params.harmonicGain[harm] + offset[harm]) * partialAudible[harm];
+                }
+            }
+            // one Newton step towards unit length, which suffices for the small drift within the interval
+            if ((samp + 1) % renormalizeInterval == 0) {
+                for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                    const auto norm = (SampleType)1.5 - (SampleType)0.5 * (re[harm] * re[harm] + im[harm] * im[harm]);
+                    re[harm] *= norm;
+                    im[harm] *= norm;
+                }
+            }
+        }
+
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            continuousPos[harm] = std::fmod(continuousPos[harm] + partialIncrement[harm] * noSamples, tableSize);
+        }
+        if (gainGlideSamples > 0) {
+            advanceGainModulation(noSamples);
+        }
+    }
+
+    template <typename SampleType>
+    void HarmonicSoundProcessor::processUnison(SampleType* left, SampleType* right, int noSamples, 
+        SampleType playingFactor) {
+        std::fill(left, left + noSamples, SampleType(0));
+        std::fill(right, right + noSamples, SampleType(0));
+
+        if (wavetable != nullptr) {
+            constexpr auto tableSize = (double)Wavetable::tableSize;
+            const auto framePos = morph * (wavetable->getNumFrames() - 1);
+            const int frame0 = (int)framePos;
+            const int frame1 = juce::jmin(frame0 + 1, wavetable->getNumFrames() - 1);
+            const auto frameBlend = (SampleType)(framePos - frame0);
+
+            for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                const auto periodsPerSample = (double)playingFactor * partialRatio[harm] / sampleRate;
+                // the copy with the highest frequency decides on the level and on leaving the harmonic out
+                const auto highest = periodsPerSample * unisonRatio[unisonVoices - 1];
+                if (isSilent(harm) || highest >= 0.5) {
+                    continue;
+                }
+                const auto levelPos = Wavetable::getLevelPosition(highest);
+                const int level0 = (int)levelPos;
+                const int level1 = juce::jmin(level0 + 1, Wavetable::numLevels - 1);
+                const auto levelBlend = (SampleType)(levelPos - level0);
+                const float* table00 = wavetable->getTable(frame0, level0);
+                const float* table01 = wavetable->getTable(frame0, level1);
+                const float* table10 = wavetable->getTable(frame1, level0);
+                const float* table11 = wavetable->getTable(frame1, level1);
+
+                addUnisonHarmonic(left, right, noSamples, harm, periodsPerSample, [=](double phase) {
+                    const auto pos = phase * tableSize;
+                    const int pos_0 = (int)pos;
+                    const auto frac = (SampleType)(pos - pos_0);
+                    const auto lookup = [pos_0, frac](const float* table) {
+                        return table[pos_0] + frac * (table[pos_0 + 1] - table[pos_0]);
+                    };
+                    const auto value0 = lookup(table00) + levelBlend * (lookup(table01) - lookup(table00));
+                    if (frameBlend == 0) {
+                        return value0;
+                    }
+                    const auto value1 = lookup(table10) + levelBlend * (lookup(table11) - lookup(table10));
+                    return value0 + frameBlend * (value1 - value0);
+                });
+            }
+        }
+        else if (engine != OscillatorEngine::table) {
+            visitSineDegree([&](auto degree) {
+                for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                    if (isSilent(harm)) {
+                        continue;
+                    }
+                    const auto periodsPerSample = (double)playingFactor * partialRatio[harm] / sampleRate;
+                    addUnisonHarmonic(left, right, noSamples, harm, periodsPerSample, [](double phase) {
+                        return fastsine::sine<decltype(degree)::value, SampleType>(phase);
+                    });
+                }
+            });
+        }
+        else {
+            const float* table = sound->data();
+            const size_t tableSize = sound->size();
+            for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+                if (isSilent(harm)) {
+                    continue;
+                }
+                const auto periodsPerSample = (double)playingFactor * partialRatio[harm] / sampleRate;
+                addUnisonHarmonic(left, right, noSamples, harm, periodsPerSample, [=](double phase) {
+                    const auto pos = phase * tableSize;
+                    const auto pos_0 = juce::jmin((size_t)pos, tableSize - 1);
+                    const auto pos_1 = (pos_0 + 1) % tableSize;
+                    const auto frac = (SampleType)(pos - pos_0);
+                    return table[pos_0] + frac * (table[pos_1] - table[pos_0]);
+                });
+            }
+        }
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            left[samp] /= NO_ADDSYNTH_VOICES;
+            right[samp] /= NO_ADDSYNTH_VOICES;
+        }
+        if (gainGlideSamples > 0) {
+            advanceGainModulation(noSamples);
+        }
+    }
+
+    template <typename SampleType, typename Lookup>
+    void HarmonicSoundProcessor::addUnisonHarmonic(SampleType* left, SampleType* right, int noSamples, int harm,
+        double periodsPerSample, Lookup lookup) {
+        const int lanes = unisonVoices;
+        auto& phases = unisonPhase[harm];
+        std::array<double, maxUnisonVoices> increments;
+        double highest = 0.;
+        for (int lane = 0; lane < lanes; ++lane) {
+            increments[lane] = periodsPerSample * unisonRatio[lane];
+            highest = std::max(highest, increments[lane]);
+        }
+        // a copy at or above the Nyquist frequency would alias
+        if (highest >= 0.5) {
+            return;
+        }
+        // the gain glides along with the offset, as in processWavetable
+        auto gain = getModulatedGain(harm);
+        auto offset = gainOffset[harm];
+        int glideSamples = gainGlideSamples;
+
+        for (int samp = 0; samp < noSamples; ++samp) {
+            SampleType sumLeft = 0;
+            SampleType sumRight = 0;
+            for (int lane = 0; lane < lanes; ++lane) {
+                const SampleType value = lookup(phases[lane]);
+                sumLeft += value * unisonLeft[lane];
+                sumRight += value * unisonRight[lane];
+                phases[lane] += increments[lane];
+                phases[lane] -= std::floor(phases[lane]);
+            }
+            left[samp] += sumLeft * gain;
+            right[samp] += sumRight * gain;
+            if (glideSamples > 0) {
+                offset = --glideSamples == 0 ? gainOffsetTarget[harm] : offset + gainOffsetStep[harm];
+                gain = std::max(0.f, params.harmonicGain[harm] + offset);
+            }
+        }
+    }
+
+    void HarmonicSoundProcessor::setGainModulation(const std::array<float, NO_ADDSYNTH_VOICES>& offsets, 
+        int numSamples) {
+        gainOffsetTarget = offsets;
+        gainGlideSamples = std::max(1, numSamples);
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            gainOffsetStep[harm] = (gainOffsetTarget[harm] - gainOffset[harm]) / gainGlideSamples;
+        }
+        gainModulated = true;
+        ++parameterVersion;
+    }
+
+    void HarmonicSoundProcessor::clearGainModulation() {
+        gainOffset.fill(0.f);
+        gainOffsetTarget.fill(0.f);
+        gainGlideSamples = 0;
+        gainModulated = false;
+        ++parameterVersion;
+    }
+
+    void HarmonicSoundProcessor::advanceGainModulation(int noSamples) {
+        if (noSamples >= gainGlideSamples) {
+            gainOffset = gainOffsetTarget;
+            gainGlideSamples = 0;
+            return;
+        }
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            gainOffset[harm] += gainOffsetStep[harm] * noSamples;
+        }
+        gainGlideSamples -= noSamples;
+    }
+
+    void HarmonicSoundProcessor::setPartialRatios(const PartialRatios& ratios) {
+        if (ratios == partials) {
+            return;
+        }
+        partials = ratios;
+        partialRatio = partials.getRatios();
+        harmonicPartials = true;
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            harmonicPartials = harmonicPartials && partialRatio[harm] == harm + 1;
+        }
+        partialIncrementBase = -1.;
+        ++parameterVersion;
+    }
+
+    void HarmonicSoundProcessor::updatePartialIncrements(double increment) {
+        if (increment == partialIncrementBase) {
+            return;
+        }
+        partialIncrementBase = increment;
+        const double tableSize = (double)sound->size();
+        for (int harm = 0; harm < NO_ADDSYNTH_VOICES; ++harm) {
+            partialIncrement[harm] = increment * partialRatio[harm];
+            // the harmonics are played up to the end as ever, only the others are kept below the Nyquist frequency
+            partialAudible[harm] = harmonicPartials || partialIncrement[harm] < 0.5 * tableSize ? 1.f : 0.f;
+        }
     }
 
     void HarmonicSoundProcessor::setHarmGain(int noHarmonic, float value) {
         // TODO: error catching!
-        params.harmonicGain[noHarmonic] = value;
+        if (params.harmonicGain[noHarmonic] != value) {
+            params.harmonicGain[noHarmonic] = value;
+            ++parameterVersion;
+        }
     }
 } // namespace cw::synth
\ No newline at end of file
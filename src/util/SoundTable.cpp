@@ -0,0 +1,258 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "SoundTable.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+namespace cw::synth {
+
+namespace {
+    // number of samples decoded at once when an audio file is written to the cache
+    constexpr int decodeBlockSize = 1 << 16;
+
+    // Tables mapped from files, by their full path, so that all synth instances of the process share one mapping.
+    std::mutex registryMutex;
+    std::map<std::string, std::weak_ptr<const SoundTable>> mappedTables;
+
+    // the bits of a prefetch request which hold the start of the range
+    constexpr int prefetchStartBits = 40;
+    constexpr juce::uint64 prefetchStartMask = ((juce::uint64)1 << prefetchStartBits) - 1;
+    constexpr size_t maxPrefetchCount = ((size_t)1 << (64 - prefetchStartBits)) - 1;
+
+    // Decodes the first channel of the audio file into a file of raw floats. The file only appears when it is complete.
+    bool decodeToRawFile(const juce::File& file, const juce::File& rawFile) {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0) {
+            return false;
+        }
+
+        const auto partFile = rawFile.getSiblingFile(rawFile.getFileName() + ".part");
+        partFile.deleteFile();
+        {
+            auto out = partFile.createOutputStream();
+            if (out == nullptr) {
+                return false;
+            }
+            juce::AudioBuffer<float> buffer(1, decodeBlockSize);
+            for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += decodeBlockSize) {
+                const int numSamples = (int)juce::jmin((juce::int64)decodeBlockSize, reader->lengthInSamples - pos);
+                if (!reader->read(&buffer, 0, numSamples, pos, true, false)
+                    || !out->write(buffer.getReadPointer(0), (size_t)numSamples * sizeof(float))) {
+                    out.reset();
+                    partFile.deleteFile();
+                    return false;
+                }
+            }
+        }
+        return partFile.moveFileTo(rawFile);
+    }
+} // namespace
+
+/**
+ * The thread which pages in the ranges requested from all mapped tables of the process. It looks for requests a few 
+ * times per block of a typical host, which is soon enough, as the ranges are requested long before they are read.
+ */
+class SoundPrefetcher : private juce::Thread {
+    public:
+        SoundPrefetcher() : juce::Thread("Sound Prefetch") {
+            startThread();
+        }
+        ~SoundPrefetcher() override {
+            stopThread(1000);
+        }
+
+        void add(const SoundTable& table) {
+            const juce::ScopedLock sl(lock);
+            tables.push_back(&table);
+        }
+        // Waits until the table is not paged in any more.
+        void remove(const SoundTable& table) {
+            const juce::ScopedLock sl(lock);
+            tables.erase(std::remove(tables.begin(), tables.end(), &table), tables.end());
+        }
+
+    private:
+        static constexpr int pollIntervalMs = 2;
+
+        juce::CriticalSection lock;
+        std::vector<const SoundTable*> tables;
+
+        void run() override {
+            while (!threadShouldExit()) {
+                {
+                    const juce::ScopedLock sl(lock);
+                    for (auto table : tables) {
+                        table->takePrefetchRequests();
+                    }
+                }
+                wait(pollIntervalMs);
+            }
+        }
+};
+
+SoundTable::SoundTable(std::vector<float> source) : samples(source.size() + 2 * padding), 
+    samplesData(samples.data() + padding), numSamples(source.size()) {
+    if (numSamples == 0) {
+        return;
+    }
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = source[(i + numSamples * padding - padding) % numSamples];
+    }
+}
+
+SoundTable::SoundTable(std::unique_ptr<juce::MemoryMappedFile> mappedFile) : mapping(std::move(mappedFile)),
+    samplesData(static_cast<const float*>(mapping->getData())), numSamples(mapping->getSize() / sizeof(float)),
+    prefetcher(std::make_unique<juce::SharedResourcePointer<SoundPrefetcher>>()) {
+    (*prefetcher)->add(*this);
+}
+
+SoundTable::~SoundTable() {
+    if (prefetcher != nullptr) {
+        (*prefetcher)->remove(*this);
+    }
+}
+
+std::shared_ptr<const SoundTable> SoundTable::mapRawFile(const juce::File& file) {
+    const std::lock_guard<std::mutex> lock(registryMutex);
+    // the tables which are not used any more leave the registry
+    for (auto it = mappedTables.begin(); it != mappedTables.end();) {
+        it = it->second.expired() ? mappedTables.erase(it) : std::next(it);
+    }
+    const auto key = file.getFullPathName().toStdString();
+    const auto found = mappedTables.find(key);
+    if (found != mappedTables.end()) {
+        // the last user may have let go of it since
+        if (auto table = found->second.lock()) {
+            return table;
+        }
+    }
+
+    auto mappedFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly, false);
+    if (mappedFile->getData() == nullptr || mappedFile->getSize() < sizeof(float)) {
+        return nullptr;
+    }
+    auto table = std::shared_ptr<const SoundTable>(new SoundTable(std::move(mappedFile)));
+    mappedTables[key] = table;
+    return table;
+}
+
+std::shared_ptr<const SoundTable> SoundTable::loadCached(const juce::File& file, const juce::File& cacheDirectory) {
+    if (file.hasFileExtension("f32")) {
+        return mapRawFile(file);
+    }
+
+    // the name of the cache file changes with the path, size and modification time of the source
+    const auto key = file.getFullPathName().hashCode64() ^ file.getSize()
+        ^ file.getLastModificationTime().toMilliseconds();
+    const auto rawFile = cacheDirectory.getChildFile(file.getFileNameWithoutExtension() + "_"
+        + juce::String::toHexString(key) + ".f32");
+    {
+        // one decoder at a time, so that two instances loading the same file do not write the same cache file
+        static std::mutex decodeMutex;
+        const std::lock_guard<std::mutex> lock(decodeMutex);
+        if (!rawFile.existsAsFile() && !(cacheDirectory.createDirectory() && decodeToRawFile(file, rawFile))) {
+            return nullptr;
+        }
+    }
+    return mapRawFile(rawFile);
+}
+
+void SoundTable::requestPrefetch(size_t start, size_t count) const {
+    if (mapping == nullptr || numSamples == 0) {
+        return;
+    }
+    const auto number = prefetchRequested.fetch_add(1, std::memory_order_relaxed);
+    auto& request = prefetchRequests[number % numPrefetchRequests];
+    request.range.store((start % numSamples) | ((juce::uint64)juce::jmin(count, maxPrefetchCount) << prefetchStartBits),
+        std::memory_order_relaxed);
+    request.sequence.store(number + 1, std::memory_order_release);
+}
+
+void SoundTable::requestPrefetchAll() const {
+    if (mapping != nullptr && !prefetchAllRequested.load(std::memory_order_relaxed)) {
+        prefetchAllRequested.store(true, std::memory_order_release);
+    }
+}
+
+void SoundTable::takePrefetchRequests() const {
+    if (!prefetchedAll && prefetchAllRequested.load(std::memory_order_acquire)) {
+        prefetchedAll = true;
+        prefetch(0, numSamples);
+    }
+    const auto requested = prefetchRequested.load(std::memory_order_relaxed);
+    // the oldest requests have been overwritten if the thread has fallen behind by more than the queue holds
+    if (requested - prefetchTaken > (juce::uint32)numPrefetchRequests) {
+        prefetchTaken = requested - numPrefetchRequests;
+    }
+    for (; prefetchTaken != requested; ++prefetchTaken) {
+        const auto& request = prefetchRequests[prefetchTaken % numPrefetchRequests];
+        const auto sequence = request.sequence.load(std::memory_order_acquire);
+        // still being written, it is taken next time
+        if ((juce::int32)(sequence - (prefetchTaken + 1)) < 0) {
+            break;
+        }
+        // overwritten by a newer request, which comes later
+        if (sequence != prefetchTaken + 1) {
+            continue;
+        }
+        const auto range = request.range.load(std::memory_order_relaxed);
+        prefetch((size_t)(range & prefetchStartMask), (size_t)(range >> prefetchStartBits));
+    }
+}
+
+void SoundTable::prefetch(size_t start, size_t count) const {
+    if (count == 0) {
+        return;
+    }
+    start %= numSamples;
+    count = juce::jmin(count, numSamples);
+    if (start + count > numSamples) {
+        prefetch(0, start + count - numSamples);
+        count = numSamples - start;
+    }
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    // madvise takes whole pages
+    static const auto pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const auto begin = reinterpret_cast<std::uintptr_t>(samplesData + start) & ~(std::uintptr_t)(pageSize - 1);
+    const auto end = reinterpret_cast<std::uintptr_t>(samplesData + start + count);
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#else
+    constexpr size_t pageSize = 4096;
+#endif
+
+    // reading one sample of each page waits until it is in memory, here instead of on the audio thread
+    const size_t samplesPerPage = juce::jmax((size_t)1, pageSize / sizeof(float));
+    float sum = 0.f;
+    for (size_t i = 0; i < count; i += samplesPerPage) {
+        sum += static_cast<const volatile float*>(samplesData)[start + i];
+    }
+    sum += static_cast<const volatile float*>(samplesData)[start + count - 1];
+    juce::ignoreUnused(sum);
+}
+
+} // namespace cw::synth
@@ -0,0 +1,123 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace cw::synth {
+
+class SoundPrefetcher;
+
+/**
+ * An immutable table of samples, e.g. one period of a waveform, which the sound processors read from. Tables are
+ * shared through std::shared_ptr<const SoundTable> between all voices and all synth instances which play the same
+ * sound, and are safe to read from any number of threads.
+ *
+ * The samples are either held in memory or, for large recorded sources, mapped read-only from a file of raw 32-bit 
+ * floats. A mapped table costs no time to load and no memory of its own; the operating system pages it in on demand
+ * and shares the pages between all mappings of the file.
+ *
+ * Destroying a mapped table waits until the prefetch thread has left it, which may be paging in from the disk, and
+ * destroying the last one stops that thread. The last reference to a table must therefore not be dropped on the audio
+ * thread.
+ */
+class SoundTable {
+    public:
+        explicit SoundTable(std::vector<float> samples);
+        ~SoundTable();
+
+        /*
+        * The number of samples before and after the table in memory which continue it periodically, so that the 
+        * interpolation can read the neighbours of any sample without wrapping around.
+        */
+        static constexpr size_t padding = 4;
+
+        /*
+        * Maps a file of raw, mono, 32-bit floats in native byte order. Tables mapped from the same file are shared 
+        * within the process. Returns null if the file cannot be mapped.
+        */
+        static std::shared_ptr<const SoundTable> mapRawFile(const juce::File& file);
+
+        /*
+        * Maps an audio file which any of the basic formats of JUCE can read. The first channel is decoded once into a
+        * file of raw floats in the given cache directory, which is mapped from then on; files with the extension 
+        * ".f32" are taken as raw floats and mapped directly. Returns null if the file cannot be read.
+        */
+        static std::shared_ptr<const SoundTable> loadCached(const juce::File& file, const juce::File& cacheDirectory);
+
+        const float* data() const { return samplesData; }
+        size_t size() const { return numSamples; }
+        bool isMapped() const { return mapping != nullptr; }
+        // Whether the table is padded, see padding. Mapped tables are not.
+        bool isPadded() const { return mapping == nullptr; }
+
+        /*
+        * Asks for the given range of samples to be paged in, so that reading it later does not block on the disk. The
+        * range is queued wait-free; a background thread shared by all mapped tables advises the operating system and
+        * touches the pages. The range wraps around the end of the table. Does nothing for tables in memory. For the
+        * audio thread.
+        */
+        void requestPrefetch(size_t start, size_t count) const;
+        /*
+        * Asks for the whole table to be paged in once, for playback which skips through it too fast to prefetch the 
+        * range ahead. Only the first request counts: pages which the operating system evicts later, e.g. when the 
+        * table does not fit into memory, are read on demand again. Does nothing for tables in memory. For the audio 
+        * thread.
+        */
+        void requestPrefetchAll() const;
+
+    private:
+        friend class SoundPrefetcher;
+
+        // A range queued by requestPrefetch: the start in the low 40 bits and the length in the high 24 bits, and the
+        // number of the request plus one, once the range has been written.
+        struct PrefetchRequest {
+            std::atomic<juce::uint64> range;
+            std::atomic<juce::uint32> sequence;
+        };
+        static constexpr int numPrefetchRequests = 256;
+
+        explicit SoundTable(std::unique_ptr<juce::MemoryMappedFile> mapping);
+
+        // Pages in the queued ranges. For the prefetch thread.
+        void takePrefetchRequests() const;
+        // Pages in the range at once, which may block on the disk. For the prefetch thread.
+        void prefetch(size_t start, size_t count) const;
+
+        std::vector<float> samples;
+        std::unique_ptr<juce::MemoryMappedFile> mapping;
+        const float* samplesData;
+        size_t numSamples;
+
+        // the queued ranges, the requests made and the requests taken by the prefetch thread, which only mapped tables
+        // use
+        mutable std::array<PrefetchRequest, numPrefetchRequests> prefetchRequests{};
+        mutable std::atomic<juce::uint32> prefetchRequested{ 0 };
+        mutable juce::uint32 prefetchTaken{ 0 };
+        // whether the whole table has been requested, and whether the prefetch thread has paged it in
+        mutable std::atomic<bool> prefetchAllRequested{ false };
+        mutable bool prefetchedAll{ false };
+        std::unique_ptr<juce::SharedResourcePointer<SoundPrefetcher>> prefetcher;
+};
+
+} // namespace cw::synth
@@ -0,0 +1,213 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "Telemetry.h"
+
+namespace cw::synth {
+
+juce::String getTelemetryStageName(int stage) {
+    switch (stage) {
+        case stageParameters: return "parameters";
+        case stageOscillators: return "oscillators";
+        case stageRotation: return "rotation";
+        case stageEnvelope: return "envelope";
+        case stageMix: return "mix";
+        case stageModulation: return "modulation";
+        default: return {};
+    }
+}
+
+//===================================================================================
+
+void TelemetryRecorder::beginBlock() {
+    current = BlockTelemetry{};
+    blockStartTicks = enabled ? juce::Time::getHighResolutionTicks() : 0;
+}
+
+void TelemetryRecorder::endBlock(int numSamples) {
+    if (blockStartTicks == 0) {
+        return;
+    }
+    current.totalTicks = juce::Time::getHighResolutionTicks() - blockStartTicks;
+    current.numSamples = numSamples;
+    current.sampleRate = sampleRate;
+
+    if (fifo.getFreeSpace() < 1) {
+        ++droppedRecords;
+        return;
+    }
+    const auto scope = fifo.write(1);
+    records[(size_t)(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = current;
+}
+
+void TelemetryRecorder::popRecords(std::vector<BlockTelemetry>& destination) {
+    const auto scope = fifo.read(fifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i) {
+        destination.push_back(records[(size_t)(scope.startIndex1 + i)]);
+    }
+    for (int i = 0; i < scope.blockSize2; ++i) {
+        destination.push_back(records[(size_t)(scope.startIndex2 + i)]);
+    }
+}
+
+//===================================================================================
+
+TelemetryCollector::TelemetryCollector(TelemetryRecorder& recorder) : juce::Thread("Telemetry Collector"),
+    recorder(recorder) {
+    history.reserve(historySize);
+    incoming.reserve(1024);
+}
+
+TelemetryCollector::~TelemetryCollector() {
+    stop();
+}
+
+void TelemetryCollector::start() {
+    if (!isThreadRunning()) {
+        startThread();
+    }
+}
+
+void TelemetryCollector::stop() {
+    stopThread(1000);
+}
+
+void TelemetryCollector::run() {
+    while (!threadShouldExit()) {
+        incoming.clear();
+        recorder.popRecords(incoming);
+
+        {
+            // only while adding, so that the message thread does not wait for the sleep
+            const juce::ScopedLock sl(lock);
+            for (const auto& record : incoming) {
+                addRecord(record);
+            }
+            summary.droppedRecords = recorder.getNumDroppedRecords() - droppedAtReset;
+        }
+
+        wait(pollIntervalMs);
+    }
+}
+
+void TelemetryCollector::addRecord(const BlockTelemetry& record) {
+    ++summary.numBlocks;
+    if (record.getLoad() > 1.) {
+        ++summary.blocksOverBudget;
+    }
+    if (record.getLoad() > summary.worstBlock.getLoad()) {
+        summary.worstBlock = record;
+    }
+
+    const double micros = record.getTotalSeconds() * 1e6;
+    int bucket = 0;
+    while (bucket < TelemetrySummary::numHistogramBuckets - 1
+        && micros >= TelemetrySummary::getBucketLimitMicros(bucket)) {
+        ++bucket;
+    }
+    ++summary.histogram[(size_t)bucket];
+
+    for (int stage = 0; stage < numTelemetryStages; ++stage) {
+        summary.stageSeconds[(size_t)stage] += record.getStageSeconds(stage);
+    }
+    summary.totalSeconds += record.getTotalSeconds();
+
+    if ((int)history.size() < historySize) {
+        history.push_back(record);
+    }
+    else {
+        history[(size_t)historyPos] = record;
+    }
+    historyPos = (historyPos + 1) % historySize;
+}
+
+TelemetrySummary TelemetryCollector::getSummary() const {
+    const juce::ScopedLock sl(lock);
+    return summary;
+}
+
+void TelemetryCollector::reset() {
+    const juce::ScopedLock sl(lock);
+    summary = TelemetrySummary{};
+    droppedAtReset = recorder.getNumDroppedRecords();
+    history.clear();
+    historyPos = 0;
+}
+
+bool TelemetryCollector::writeJson(const juce::File& file) const {
+    const auto current = getSummary();
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("blocks", current.numBlocks);
+    root->setProperty("blocksOverBudget", current.blocksOverBudget);
+    root->setProperty("droppedRecords", current.droppedRecords);
+    root->setProperty("totalMicros", current.totalSeconds * 1e6);
+
+    auto* stages = new juce::DynamicObject();
+    for (int stage = 0; stage < numTelemetryStages; ++stage) {
+        stages->setProperty(getTelemetryStageName(stage), current.stageSeconds[(size_t)stage] * 1e6);
+    }
+    root->setProperty("stageMicros", juce::var(stages));
+
+    juce::Array<juce::var> histogram;
+    for (int bucket = 0; bucket < TelemetrySummary::numHistogramBuckets; ++bucket) {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("belowMicros", bucket < TelemetrySummary::numHistogramBuckets - 1
+            ? juce::var(TelemetrySummary::getBucketLimitMicros(bucket)) : juce::var("inf"));
+        entry->setProperty("blocks", current.histogram[(size_t)bucket]);
+        histogram.add(juce::var(entry));
+    }
+    root->setProperty("histogram", histogram);
+
+    auto* worst = new juce::DynamicObject();
+    worst->setProperty("load", current.worstBlock.getLoad());
+    worst->setProperty("numSamples", current.worstBlock.numSamples);
+    worst->setProperty("budgetMicros", current.worstBlock.getBudgetSeconds() * 1e6);
+    worst->setProperty("totalMicros", current.worstBlock.getTotalSeconds() * 1e6);
+    for (int stage = 0; stage < numTelemetryStages; ++stage) {
+        worst->setProperty(getTelemetryStageName(stage) + "Micros", current.worstBlock.getStageSeconds(stage) * 1e6);
+    }
+    root->setProperty("worstBlock", juce::var(worst));
+
+    return file.replaceWithText(juce::JSON::toString(juce::var(root)));
+}
+
+bool TelemetryCollector::writeCsv(const juce::File& file) const {
+    juce::String csv{ "numSamples,budgetMicros,totalMicros" };
+    for (int stage = 0; stage < numTelemetryStages; ++stage) {
+        csv << "," << getTelemetryStageName(stage) << "Micros";
+    }
+    csv << "\n";
+
+    const juce::ScopedLock sl(lock);
+    // oldest record first: once the ring is full, that is the one at the current write position
+    const int count = (int)history.size();
+    const int first = count < historySize ? 0 : historyPos;
+    for (int i = 0; i < count; ++i) {
+        const auto& record = history[(size_t)((first + i) % count)];
+        csv << record.numSamples << "," << record.getBudgetSeconds() * 1e6 << "," << record.getTotalSeconds() * 1e6;
+        for (int stage = 0; stage < numTelemetryStages; ++stage) {
+            csv << "," << record.getStageSeconds(stage) * 1e6;
+        }
+        csv << "\n";
+    }
+
+    return file.replaceWithText(csv);
+}
+
+} // namespace cw::synth
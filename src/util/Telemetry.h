@@ -0,0 +1,175 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace cw::synth {
+
+/**
+ * The stages of the processing of one block, for which the time is measured separately. The stages within the voices
+ * (oscillators, rotation, envelope, mix) are summed up over all voices.
+ */
+enum TelemetryStage {
+    stageParameters = 0,
+    stageOscillators,
+    stageRotation,
+    stageEnvelope,
+    stageMix,
+    stageModulation,
+    numTelemetryStages
+};
+
+// Returns a short name of the stage, as used in the editor and in the exported files.
+juce::String getTelemetryStageName(int stage);
+
+/**
+ * The timing record of one processed block, in high resolution ticks.
+ */
+struct BlockTelemetry {
+    std::array<juce::int64, numTelemetryStages> stageTicks{};
+    juce::int64 totalTicks{ 0 };
+    int numSamples{ 0 };
+    double sampleRate{ 0. };
+
+    // the time which was available for processing this block, in seconds
+    double getBudgetSeconds() const { return sampleRate > 0. ? numSamples / sampleRate : 0.; }
+    double getTotalSeconds() const { return juce::Time::highResolutionTicksToSeconds(totalTicks); }
+    double getStageSeconds(int stage) const { return juce::Time::highResolutionTicksToSeconds(stageTicks[stage]); }
+    // ratio of processing time to budget, values above one mean that the block missed its deadline
+    double getLoad() const { return getBudgetSeconds() > 0. ? getTotalSeconds() / getBudgetSeconds() : 0.; }
+};
+
+/**
+ * Records the timing of each processed block on the audio thread. The records are passed on through a wait-free 
+ * single producer/single consumer FIFO; if the FIFO is full, the record is dropped and counted, so the audio thread 
+ * never waits. All methods except popRecords() and getNumDroppedRecords() must only be called from the audio thread.
+ */
+class TelemetryRecorder {
+    public:
+        /**
+         * Measures the time of one stage for the lifetime of the object and adds it to the current block. Does 
+         * nothing if the recorder is null or disabled.
+         */
+        class ScopedStage {
+            public:
+                ScopedStage(TelemetryRecorder* recorder, int stage) : recorder(recorder), stage(stage),
+                    startTicks(recorder != nullptr && recorder->isEnabled() ? juce::Time::getHighResolutionTicks() : 0) {}
+                ~ScopedStage() {
+                    if (startTicks != 0) {
+                        recorder->addStageTicks(stage, juce::Time::getHighResolutionTicks() - startTicks);
+                    }
+                }
+
+            private:
+                TelemetryRecorder* recorder;
+                int stage;
+                juce::int64 startTicks;
+        };
+
+        TelemetryRecorder() : fifo(fifoSize) {}
+
+        void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+        bool isEnabled() const { return enabled; }
+        void setSampleRate(double newSampleRate) { sampleRate = newSampleRate; }
+
+        // Starts the measurement of a new block.
+        void beginBlock();
+        // Adds the given time to a stage of the current block.
+        void addStageTicks(int stage, juce::int64 ticks) { current.stageTicks[stage] += ticks; }
+        // Finishes the measurement of the current block and pushes its record into the FIFO.
+        void endBlock(int numSamples);
+
+        // Reads all available records from the FIFO into the given vector. Call from a single reader thread only.
+        void popRecords(std::vector<BlockTelemetry>& destination);
+        juce::int64 getNumDroppedRecords() const { return droppedRecords; }
+
+    private:
+        static constexpr int fifoSize = 1024;
+
+        std::atomic<bool> enabled{ true };
+        double sampleRate{ 44100. };
+        BlockTelemetry current;
+        juce::int64 blockStartTicks{ 0 };
+
+        juce::AbstractFifo fifo;
+        std::array<BlockTelemetry, fifoSize> records;
+        std::atomic<juce::int64> droppedRecords{ 0 };
+};
+
+/**
+ * Aggregated statistics over all blocks since the last reset.
+ */
+struct TelemetrySummary {
+    // bucket i counts the blocks which took less than 2^i microseconds, the last bucket counts all longer blocks
+    static constexpr int numHistogramBuckets = 18;
+
+    juce::int64 numBlocks{ 0 };
+    juce::int64 blocksOverBudget{ 0 };
+    juce::int64 droppedRecords{ 0 };
+    std::array<juce::int64, numHistogramBuckets> histogram{};
+    std::array<double, numTelemetryStages> stageSeconds{};
+    double totalSeconds{ 0. };
+    // the block with the highest load, together with its timing per stage
+    BlockTelemetry worstBlock;
+
+    static double getBucketLimitMicros(int bucket) { return (double)(1 << bucket); }
+};
+
+/**
+ * Collects the records of a TelemetryRecorder on a background thread and aggregates them. The summary and the most
+ * recent records can be read from any other thread, and can be exported as JSON or CSV.
+ */
+class TelemetryCollector : private juce::Thread {
+    public:
+        TelemetryCollector(TelemetryRecorder& recorder);
+        ~TelemetryCollector() override;
+
+        void start();
+        void stop();
+
+        TelemetrySummary getSummary() const;
+        void reset();
+
+        // Writes the summary as JSON.
+        bool writeJson(const juce::File& file) const;
+        // Writes the most recent block records as CSV, one line per block, times in microseconds.
+        bool writeCsv(const juce::File& file) const;
+
+    private:
+        static constexpr int historySize = 4096;
+        static constexpr int pollIntervalMs = 50;
+
+        TelemetryRecorder& recorder;
+        juce::CriticalSection lock;
+        TelemetrySummary summary;
+        // ring of the most recent records, historyPos is the next position to write
+        std::vector<BlockTelemetry> history;
+        int historyPos{ 0 };
+        juce::int64 droppedAtReset{ 0 };
+        std::vector<BlockTelemetry> incoming;
+
+        void run() override;
+        void addRecord(const BlockTelemetry& record);
+};
+
+} // namespace cw::synth
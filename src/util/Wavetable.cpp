@@ -0,0 +1,97 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "Wavetable.h"
+#include <cmath>
+
+namespace cw::synth {
+
+Wavetable::Wavetable(const std::vector<float>& samples, int frameSize) {
+    const auto numSamples = (int)samples.size();
+    frameSize = juce::jmax(1, juce::jmin(frameSize, numSamples));
+    numFrames = juce::jlimit(1, maxFrames, numSamples / frameSize);
+
+    tables.resize((size_t)numFrames * numLevels * (tableSize + 1));
+    for (int frame = 0; frame < numFrames; ++frame) {
+        addFrame(frame, samples.data() + (size_t)frame * frameSize, numSamples > 0 ? frameSize : 0);
+    }
+}
+
+std::shared_ptr<const Wavetable> Wavetable::loadFromFile(const juce::File& file, int frameSize) {
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || frameSize <= 0) {
+        return nullptr;
+    }
+
+    const auto numSamples = (int)juce::jmin(reader->lengthInSamples, (juce::int64)maxFrames * frameSize);
+    juce::AudioBuffer<float> buffer(1, numSamples);
+    if (!reader->read(&buffer, 0, numSamples, 0, true, false)) {
+        return nullptr;
+    }
+    const auto* channel = buffer.getReadPointer(0);
+    return std::make_shared<const Wavetable>(std::vector<float>(channel, channel + numSamples), frameSize);
+}
+
+float Wavetable::getLevelPosition(double periodsPerSample) {
+    // level k is free of aliasing from log2(tableSize * periodsPerSample) on; one level higher, so is the next one
+    if (periodsPerSample <= 0.) {
+        return 0.f;
+    }
+    const auto position = std::log2(tableSize * periodsPerSample) + 1.;
+    return (float)juce::jlimit(0., (double)(numLevels - 1), position);
+}
+
+void Wavetable::addFrame(int frame, const float* samples, int numSamples) {
+    // the frame is resampled to a power of two of at least tableSize samples, so that no harmonic is lost before the
+    // band-limiting
+    int order = tableOrder;
+    while ((1 << order) < numSamples) {
+        ++order;
+    }
+    const int size = 1 << order;
+    std::vector<float> spectrum(2 * (size_t)size, 0.f);
+    for (int i = 0; i < size && numSamples > 0; ++i) {
+        const auto pos = (double)i * numSamples / size;
+        const auto pos0 = (int)pos;
+        const auto pos1 = (pos0 + 1) % numSamples;
+        const auto frac = (float)(pos - pos0);
+        spectrum[i] = samples[pos0] + frac * (samples[pos1] - samples[pos0]);
+    }
+    juce::dsp::FFT(order).performRealOnlyForwardTransform(spectrum.data(), true);
+
+    // each level keeps the bins up to its limit, rescaled from the size of the frame to the size of the table
+    juce::dsp::FFT tableFft(tableOrder);
+    std::vector<float> levelSpectrum(2 * tableSize);
+    const auto scale = (float)tableSize / size;
+    for (int level = 0; level < numLevels; ++level) {
+        const int maxBin = (tableSize / 2) >> level;
+        std::fill(levelSpectrum.begin(), levelSpectrum.end(), 0.f);
+        for (int i = 0; i < 2 * (maxBin + 1); ++i) {
+            levelSpectrum[i] = spectrum[i] * scale;
+        }
+        tableFft.performRealOnlyInverseTransform(levelSpectrum.data());
+
+        auto* table = tables.data() + ((size_t)frame * numLevels + level) * (tableSize + 1);
+        std::copy(levelSpectrum.begin(), levelSpectrum.begin() + tableSize, table);
+        table[tableSize] = table[0];
+    }
+}
+
+} // namespace cw::synth
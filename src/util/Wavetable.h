@@ -0,0 +1,73 @@
+/**
+ * Additive Synth - Experimental Synthesizer with some features to explore.
+ *
+ * Copyright (C) 2023 Christoph Wellm <christoph.wellm@creaflect.de>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the 
+ * GNU General Public License version 3 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+ * General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with this program.  
+ * If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+namespace cw::synth {
+
+/**
+ * A wavetable of one or more frames, each frame being one period of a waveform. On construction, every frame is
+ * resampled to tableSize samples and stored in band-limited versions, one per octave: level k contains the harmonics
+ * up to tableSize / 2^(k+1) only. All of this is computed up front, so that playing the table is a matter of indexed
+ * reads and blends. Immutable, and shared like SoundTable.
+ */
+class Wavetable {
+    public:
+        static constexpr int tableOrder = 11;
+        static constexpr int tableSize = 1 << tableOrder;
+        static constexpr int numLevels = tableOrder;
+        static constexpr int maxFrames = 256;
+
+        /*
+        * Splits the samples into frames of frameSize samples each; a remainder shorter than a frame is dropped. If 
+        * there are fewer samples than frameSize, all samples form a single frame. Takes a while; not for the audio
+        * thread.
+        */
+        Wavetable(const std::vector<float>& samples, int frameSize);
+
+        /*
+        * Loads the first channel of an audio file and splits it into frames as above. Returns null if the file cannot
+        * be read.
+        */
+        static std::shared_ptr<const Wavetable> loadFromFile(const juce::File& file, int frameSize);
+
+        int getNumFrames() const { return numFrames; }
+
+        // The table of the given frame and level, with tableSize + 1 samples: the last sample repeats the first one.
+        const float* getTable(int frame, int level) const {
+            return tables.data() + ((size_t)frame * numLevels + level) * (tableSize + 1);
+        }
+
+        /*
+        * The fractional level for playing the table at the given number of periods per sample. The two levels around
+        * it are both free of aliasing, so that blending them is, too.
+        */
+        static float getLevelPosition(double periodsPerSample);
+
+    private:
+        int numFrames;
+        std::vector<float> tables;
+
+        void addFrame(int frame, const float* samples, int numSamples);
+};
+
+} // namespace cw::synth